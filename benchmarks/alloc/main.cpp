@@ -0,0 +1,185 @@
+#include <string_view>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <print>
+#include <new>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "http_server.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::uint64_t;
+using std::println;
+using std::string;
+
+// Every global operator new in the process is counted; the client below
+// works out of fixed buffers so whatever moves between two snapshots was
+// allocated by the server.
+std::atomic<uint64_t> allocations;
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *data = std::malloc(size ? size : 1)) {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *data) noexcept {
+    std::free(data);
+}
+
+void operator delete(void *data, std::size_t) noexcept {
+    std::free(data);
+}
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Reads one response into buffer and returns its status, or 0 on failure.
+int request(int fd, string_view text, char *buffer, std::size_t capacity) {
+    if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+        return 0;
+    }
+
+    std::size_t have = 0;
+    while (true) {
+        string_view seen(buffer, have);
+        std::size_t end = seen.find("\r\n\r\n");
+        if (end != string_view::npos) {
+            std::size_t length = 0;
+            std::size_t field = seen.find("Content-Length: ");
+            if (field != string_view::npos && field < end) {
+                length = std::strtoul(buffer + field + 16, nullptr, 10);
+            }
+
+            if (have >= end + 4 + length) {
+                return std::atoi(buffer + 9);
+            }
+        }
+
+        if (have == capacity) {
+            return 0;
+        }
+
+        ssize_t bytes = read(fd, buffer + have, capacity - have);
+        if (bytes <= 0) {
+            return 0;
+        }
+        have += bytes;
+    }
+}
+
+void bench(string_view name, string_view path, int port) {
+    constexpr int warmup = 1000;
+    constexpr int requests = 20000;
+
+    char text[256];
+    auto written = std::format_to_n(text, sizeof(text), "GET {} HTTP/1.1\r\nHost: bench\r\n\r\n", path);
+    string_view line(text, written.out);
+
+    static char buffer[1 << 16];
+    int fd = connectTo(port);
+    int status = 0;
+
+    for (int i = 0; i < warmup; ++i) {
+        status = request(fd, line, buffer, sizeof(buffer));
+    }
+
+    uint64_t before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < requests; ++i) {
+        status = request(fd, line, buffer, sizeof(buffer));
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    uint64_t after = allocations.load();
+    close(fd);
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    println(
+        "{:<18} {:>3} {:>9.0f} req/s {:>6.2f} allocations/req",
+        name,
+        status,
+        requests / seconds,
+        (after - before) / double(requests)
+    );
+}
+
+int main() {
+    constexpr int port = 3311;
+
+    fs::path root = fs::temp_directory_path() / "http-alloc-bench";
+    fs::create_directories(root);
+    std::ofstream(root / "index.html") << "<!doctype html><p>cached</p>\n";
+
+    HttpServer server("127.0.0.1", port, 128, false, false);
+    server.setKeepAlive(30, 1 << 30);
+    server.route("/string", Method::Get, [](string) {
+        return string("a body past the small string size");
+    }, ContentType::Plain);
+    server.route("/params/:name", Method::Get, [](string_view, const http::RouteParams &params) {
+        return std::format("{{\"name\": \"{}\"}}", params.get("name"));
+    }, ContentType::Json);
+    server.route("/arena/:name", Method::Get, [](http::RequestView &request) {
+        return request.format("{{\"name\": \"{}\"}}", request.param("name"));
+    }, ContentType::Json);
+    server.serveDir(root.string());
+
+    std::thread([&server] {
+        server.acceptClientWithLoop();
+    }).detach();
+
+    // wait for the listening socket
+    while (true) {
+        int fd = connectTo(port);
+        if (fd >= 0) {
+            close(fd);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    println("global heap allocations per request over one keep-alive connection");
+
+    bench("string handler", "/string", port);
+    bench("param handler", "/params/someone-with-a-long-name", port);
+    bench("arena handler", "/arena/someone-with-a-long-name", port);
+    bench("static file", "/index.html", port);
+    bench("not found", "/missing", port);
+
+    // the server thread never returns, so leave without running destructors
+    fs::remove_all(root);
+    std::fflush(stdout);
+    _exit(0);
+}
@@ -0,0 +1,124 @@
+#include <string_view>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <cstddef>
+#include <chrono>
+#include <format>
+#include <string>
+#include <thread>
+#include <vector>
+#include <print>
+#include <ctime>
+
+#include "logger.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::println;
+using std::string;
+using std::vector;
+
+// The per-line path Logger took before the async writer: format the time
+// through an ostringstream, then open, append and close the log file.
+void legacyLog(const string &message) {
+    auto now = std::chrono::system_clock::now();
+    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+    std::tm local_time;
+    localtime_r(&now_c, &local_time);
+
+    std::ostringstream time_out;
+    time_out << std::put_time(&local_time, "%m/%d/%Y %H:%M:%S");
+
+    std::ostringstream out;
+    out << "[" << time_out.str() << " INF] " << message;
+
+    fs::path log_dir = "logs";
+    if (!fs::exists(log_dir)) {
+        fs::create_directory(log_dir);
+    }
+
+    std::ofstream file(log_dir / "legacy_log.txt", std::ios::app);
+    file << out.str() << "\n";
+}
+
+template <typename F>
+void bench(string_view name, int threads, int lines, F &&log) {
+    auto start = std::chrono::steady_clock::now();
+
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (int i = 0; i < lines; ++i) {
+                log(t, i);
+            }
+        });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    println(
+        "{:<14} {} thread(s) {:>9.1f} ns/line on the caller",
+        name,
+        threads,
+        ns / (double(threads) * lines)
+    );
+}
+
+int main() {
+    constexpr int lines = 100000;
+
+    for (int threads : {1, 4}) {
+        bench("legacy", threads, lines / 10, [](int t, int i) {
+            legacyLog(std::format("Received request from client {}: GET /api/{} HTTP/1.1", t, i));
+        });
+
+        {
+            Logger log(false, true);
+            bench("sync", threads, lines, [&](int t, int i) {
+                log.info("Received request from client {}: GET /api/{} HTTP/1.1", t, i);
+            });
+        }
+
+        {
+            Logger log(false, true, LogMode::Async, LogOverflow::Block);
+            bench("async block", threads, lines, [&](int t, int i) {
+                log.info("Received request from client {}: GET /api/{} HTTP/1.1", t, i);
+            });
+        }
+
+        {
+            Logger log(false, true, LogMode::Async, LogOverflow::Drop);
+            bench("async drop", threads, lines, [&](int t, int i) {
+                log.info("Received request from client {}: GET /api/{} HTTP/1.1", t, i);
+            });
+        }
+
+        {
+            Logger log(false, true, LogMode::Async, LogOverflow::Drop);
+            bench("below level", threads, lines, [&](int t, int i) {
+                log.debug("Received request from client {}: GET /api/{} HTTP/1.1", t, i);
+            });
+        }
+
+        {
+            Logger log(false, false);
+            bench("no sinks", threads, lines, [&](int t, int i) {
+                log.info("Received request from client {}: GET /api/{} HTTP/1.1", t, i);
+            });
+        }
+    }
+
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size("logs/tcp_log.txt", ec);
+    println("tcp_log.txt holds {} bytes", ec ? 0 : size);
+
+    return 0;
+}
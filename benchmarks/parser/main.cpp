@@ -0,0 +1,128 @@
+#include <string_view>
+#include <sstream>
+#include <cstddef>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <print>
+#include <new>
+#include <map>
+
+#include "http_parser.hpp"
+
+using std::string_view;
+using std::println;
+using std::string;
+using std::map;
+
+static std::size_t allocations = 0;
+
+void *operator new(std::size_t size) {
+    ++allocations;
+    if (void *ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+// The getline based parser HttpServer used before RequestParser.
+map<string, string> parseHttpHeader(const string &request) {
+    map<string, string> header;
+    std::istringstream iss(request);
+    string line;
+
+    string method = "Method";
+    std::getline(iss, line);
+    header[method] = line;
+
+    while (std::getline(iss, line) && !line.empty() && line != "\r") {
+        size_t colon_pos = line.find(':');
+        if (colon_pos != string::npos) {
+            string key = line.substr(0, colon_pos);
+            string value = line.substr(colon_pos + 1);
+
+            key.erase(0, key.find_first_not_of(" \t\r\n"));
+            key.erase(key.find_last_not_of(" \t\r\n") + 1);
+            value.erase(0, value.find_first_not_of(" \t\r\n"));
+            value.erase(value.find_last_not_of(" \t\r\n") + 1);
+            header[key] = value;
+        }
+    }
+
+    return header;
+}
+
+constexpr string_view request =
+    "GET /css/app.css HTTP/1.1\r\n"
+    "Host: 127.0.0.1:3000\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://127.0.0.1:3000/\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "\r\n";
+
+template <typename F>
+void bench(string_view name, int iterations, F &&f) {
+    std::size_t start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    std::size_t sink = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        sink += f();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    println(
+        "{:<16} {:>8.1f} ns/request {:>6.1f} allocations/request (sink {})",
+        name,
+        ns / iterations,
+        double(allocations - start_allocations) / iterations,
+        sink
+    );
+}
+
+int main() {
+    constexpr int iterations = 1000000;
+    string owned(request);
+
+    bench("getline parser", iterations, [&] {
+        auto header = parseHttpHeader(owned);
+        return header.size();
+    });
+
+    http::RequestParser parser;
+    http::RequestHead head;
+    bench("RequestParser", iterations, [&] {
+        parser.parse(request, head);
+        return head.header_count;
+    });
+
+    // Feed the same request a few bytes at a time, as it would arrive
+    // across several reads.
+    bench("RequestParser/7B", iterations / 10, [&] {
+        http::RequestParser split_parser;
+        std::size_t fed = 0;
+        http::ParseStatus status = http::ParseStatus::Incomplete;
+        while (status == http::ParseStatus::Incomplete) {
+            fed = std::min(fed + 7, request.size());
+            status = split_parser.parse(request.substr(0, fed), head);
+        }
+        return head.header_count;
+    });
+
+    return 0;
+}
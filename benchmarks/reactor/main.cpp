@@ -0,0 +1,331 @@
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <cstdarg>
+#include <cstring>
+#include <format>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <print>
+#include <array>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "http_server.hpp"
+
+using std::string_view;
+using std::uint64_t;
+using std::println;
+using std::string;
+using std::vector;
+
+// Every syscall the server code makes goes through one of these; the
+// Makefile links with --wrap so each call is counted before it is passed
+// on. io_uring_enter goes through syscall(2).
+enum Call {
+    Read,
+    Write,
+    Sendmsg,
+    Sendfile,
+    Accept,
+    EpollWait,
+    EpollCtl,
+    Fcntl,
+    Close,
+    Syscall,
+    CallCount,
+};
+
+constexpr std::array<string_view, CallCount> call_names = {
+    "read", "write", "sendmsg", "sendfile", "accept",
+    "epoll_wait", "epoll_ctl", "fcntl", "close", "syscall",
+};
+
+std::array<std::atomic<uint64_t>, CallCount> calls;
+
+extern "C" {
+    ssize_t __real_read(int fd, void *buf, size_t count);
+    ssize_t __real_write(int fd, const void *buf, size_t count);
+    ssize_t __real_sendmsg(int fd, const msghdr *message, int flags);
+    ssize_t __real_sendfile(int out, int in, off_t *offset, size_t count);
+    int __real_accept(int fd, sockaddr *addr, socklen_t *len);
+    int __real_epoll_wait(int fd, void *events, int max, int timeout);
+    int __real_epoll_ctl(int fd, int op, int target, void *event);
+    int __real_fcntl(int fd, int cmd, long arg);
+    int __real_close(int fd);
+    long __real_syscall(long number, long a, long b, long c, long d, long e, long f);
+
+    ssize_t __wrap_read(int fd, void *buf, size_t count) {
+        calls[Read]++;
+        return __real_read(fd, buf, count);
+    }
+
+    ssize_t __wrap_write(int fd, const void *buf, size_t count) {
+        calls[Write]++;
+        return __real_write(fd, buf, count);
+    }
+
+    ssize_t __wrap_sendmsg(int fd, const msghdr *message, int flags) {
+        calls[Sendmsg]++;
+        return __real_sendmsg(fd, message, flags);
+    }
+
+    ssize_t __wrap_sendfile(int out, int in, off_t *offset, size_t count) {
+        calls[Sendfile]++;
+        return __real_sendfile(out, in, offset, count);
+    }
+
+    int __wrap_accept(int fd, sockaddr *addr, socklen_t *len) {
+        calls[Accept]++;
+        return __real_accept(fd, addr, len);
+    }
+
+    int __wrap_epoll_wait(int fd, void *events, int max, int timeout) {
+        calls[EpollWait]++;
+        return __real_epoll_wait(fd, events, max, timeout);
+    }
+
+    int __wrap_epoll_ctl(int fd, int op, int target, void *event) {
+        calls[EpollCtl]++;
+        return __real_epoll_ctl(fd, op, target, event);
+    }
+
+    int __wrap_fcntl(int fd, int cmd, ...) {
+        va_list args;
+        va_start(args, cmd);
+        long arg = va_arg(args, long);
+        va_end(args);
+
+        calls[Fcntl]++;
+        return __real_fcntl(fd, cmd, arg);
+    }
+
+    int __wrap_close(int fd) {
+        calls[Close]++;
+        return __real_close(fd);
+    }
+
+    long __wrap_syscall(long number, ...) {
+        va_list args;
+        va_start(args, number);
+        long a = va_arg(args, long);
+        long b = va_arg(args, long);
+        long c = va_arg(args, long);
+        long d = va_arg(args, long);
+        long e = va_arg(args, long);
+        long f = va_arg(args, long);
+        va_end(args);
+
+        calls[Syscall]++;
+        return __real_syscall(number, a, b, c, d, e, f);
+    }
+}
+
+using Counts = std::array<uint64_t, CallCount>;
+
+Counts snapshot() {
+    Counts counts;
+    for (int i = 0; i < CallCount; ++i) {
+        counts[i] = calls[i].load();
+    }
+    return counts;
+}
+
+constexpr string_view keep_alive_request = "GET /ping HTTP/1.1\r\nHost: bench\r\n\r\n";
+constexpr string_view close_request =
+    "GET /ping HTTP/1.1\r\nHost: bench\r\nConnection: close\r\n\r\n";
+constexpr string_view body = "pong";
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        __real_close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Reads one response; the body is fixed, so it ends at "pong".
+bool readResponse(int fd, string &buffer) {
+    buffer.clear();
+    char chunk[4096];
+
+    while (true) {
+        size_t end = buffer.find("\r\n\r\n");
+        if (end != string::npos && buffer.size() >= end + 4 + body.size()) {
+            return true;
+        }
+
+        ssize_t bytes = __real_read(fd, chunk, sizeof(chunk));
+        if (bytes <= 0) {
+            return false;
+        }
+        buffer.append(chunk, bytes);
+    }
+}
+
+bool request(int fd, string_view text, string &buffer) {
+    return __real_write(fd, text.data(), text.size()) == (ssize_t)text.size()
+        && readResponse(fd, buffer);
+}
+
+[[noreturn]] void serve(http::Backend backend, int port, int control, int results) {
+    HttpServer server("127.0.0.1", port, 1024, false, false);
+    server.setBackend(backend);
+    server.setKeepAlive(30, 1 << 30);
+    server.route("/ping", Method::Get, [](string) {
+        return string(body);
+    }, ContentType::Plain);
+
+    std::thread([&server] {
+        server.acceptClientWithLoop();
+    }).detach();
+
+    char signal;
+    __real_read(control, &signal, 1);
+    Counts before = snapshot();
+    __real_read(control, &signal, 1);
+    Counts after = snapshot();
+
+    for (int i = 0; i < CallCount; ++i) {
+        after[i] -= before[i];
+    }
+    __real_write(results, after.data(), sizeof(after));
+    _exit(0);
+}
+
+void bench(
+    string_view name,
+    http::Backend backend,
+    int port,
+    bool keep_alive,
+    int connections,
+    int requests
+) {
+    int control[2];
+    int results[2];
+    pipe(control);
+    pipe(results);
+
+    pid_t child = fork();
+    if (child == 0) {
+        serve(backend, port, control[0], results[1]);
+    }
+
+    // wait for the listening socket before starting the clock
+    while (true) {
+        int fd = connectTo(port);
+        if (fd >= 0) {
+            __real_close(fd);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    __real_write(control[1], "s", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::atomic<int> failed = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    vector<std::thread> clients;
+    for (int c = 0; c < connections; ++c) {
+        clients.emplace_back([&] {
+            string buffer;
+            int per_client = requests / connections;
+
+            if (keep_alive) {
+                int fd = connectTo(port);
+                for (int i = 0; i < per_client; ++i) {
+                    if (!request(fd, keep_alive_request, buffer)) {
+                        failed++;
+                        break;
+                    }
+                }
+                __real_close(fd);
+                return;
+            }
+
+            for (int i = 0; i < per_client; ++i) {
+                int fd = connectTo(port);
+                if (fd < 0 || !request(fd, close_request, buffer)) {
+                    failed++;
+                }
+                __real_close(fd);
+            }
+        });
+    }
+
+    for (auto &client : clients) {
+        client.join();
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    // the server takes a moment to see the last closes
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    __real_write(control[1], "e", 1);
+
+    Counts counts {};
+    __real_read(results[0], counts.data(), sizeof(counts));
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+
+    for (int fd : {control[0], control[1], results[0], results[1]}) {
+        __real_close(fd);
+    }
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double total = 0;
+    for (uint64_t count : counts) {
+        total += count;
+    }
+
+    string breakdown;
+    for (int i = 0; i < CallCount; ++i) {
+        if (counts[i] * 100 >= static_cast<uint64_t>(requests)) {
+            breakdown += std::format(" {} {:.2f}", call_names[i], counts[i] / double(requests));
+        }
+    }
+
+    println(
+        "{:<22} {:>9.0f} req/s {:>6.2f} syscalls/req  ({}){}",
+        name,
+        requests / seconds,
+        total / requests,
+        breakdown.empty() ? " -" : breakdown.substr(1),
+        failed ? std::format("  {} failed", failed.load()) : ""
+    );
+}
+
+int main() {
+    constexpr int connections = 32;
+    constexpr int keep_alive_requests = 200000;
+    constexpr int close_requests = 20000;
+
+    println("server-side syscalls counted per request; a backend that fell");
+    println("back to epoll shows epoll_wait instead of syscall (io_uring_enter)");
+
+    bench("epoll keep-alive", http::Backend::Epoll, 3301, true, connections, keep_alive_requests);
+    bench("io_uring keep-alive", http::Backend::IoUring, 3302, true, connections, keep_alive_requests);
+    bench("epoll close", http::Backend::Epoll, 3303, false, connections, close_requests);
+    bench("io_uring close", http::Backend::IoUring, 3304, false, connections, close_requests);
+
+    return 0;
+}
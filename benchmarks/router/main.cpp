@@ -0,0 +1,114 @@
+#include <string_view>
+#include <functional>
+#include <cstddef>
+#include <chrono>
+#include <format>
+#include <string>
+#include <vector>
+#include <print>
+#include <map>
+
+#include "router.hpp"
+
+using std::string_view;
+using std::println;
+using std::string;
+using std::vector;
+using std::map;
+
+// The per-route map list HttpServer searched before http::Router.
+struct Endpoint {
+    int method;
+    std::function<string(string endpoint)> handler;
+};
+
+vector<string> makeRoutes(std::size_t count) {
+    const vector<string> resources = {
+        "users", "orders", "products", "invoices", "teams",
+        "projects", "reports", "files", "events", "settings",
+    };
+
+    vector<string> routes;
+    for (std::size_t i = 0; routes.size() < count; ++i) {
+        const string &resource = resources[i % resources.size()];
+        string base = std::format("/api/v{}/{}{}", i % 3 + 1, resource, i / 30);
+        routes.push_back(base);
+        routes.push_back(base + "/:id");
+        routes.push_back(base + "/:id/history");
+    }
+    routes.resize(count);
+
+    return routes;
+}
+
+template <typename F>
+void bench(string_view name, int iterations, F &&f) {
+    std::size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i) {
+        sink += f(i);
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    println("{:<18} {:>10.1f} ns/lookup (sink {})", name, ns / iterations, sink);
+}
+
+int main() {
+    constexpr std::size_t route_count = 1200;
+    constexpr int iterations = 200000;
+    vector<string> routes = makeRoutes(route_count);
+
+    // Requests for static routes spread across the table, the way the
+    // old list could serve them.
+    vector<string> paths;
+    for (std::size_t i = 0; i < routes.size(); i += 3) {
+        paths.push_back(routes[i]);
+    }
+
+    vector<map<string, Endpoint>> endpoints;
+    for (const string &route : routes) {
+        map<string, Endpoint> current_map;
+        current_map[route] = Endpoint { 0, [](string endpoint) { return endpoint; } };
+        endpoints.push_back(current_map);
+    }
+
+    http::Router router;
+    for (std::size_t i = 0; i < routes.size(); ++i) {
+        auto res = router.add(0, routes[i], i);
+        if (!res) {
+            println("add failed: {}", res.error());
+            return 1;
+        }
+    }
+
+    println("{} routes, {} distinct request paths", routes.size(), paths.size());
+
+    bench("vector<map> scan", iterations / 100, [&](int i) {
+        const string &endpoint = paths[i % paths.size()];
+        for (auto endp : endpoints) {
+            if (endp.count(endpoint) > 0 && endp[endpoint].method == 0) {
+                return std::size_t(1);
+            }
+        }
+        return std::size_t(0);
+    });
+
+    http::RouteParams params;
+    bench("Router static", iterations, [&](int i) {
+        return router.match(0, paths[i % paths.size()], params);
+    });
+
+    vector<string> param_paths;
+    for (const string &path : paths) {
+        param_paths.push_back(path + "/42/history");
+    }
+
+    bench("Router :id/history", iterations, [&](int i) {
+        std::size_t id = router.match(0, param_paths[i % param_paths.size()], params);
+        return id + params.get("id").size();
+    });
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <print>
+
+#include <x86intrin.h>
+
+#include "scan.hpp"
+
+using std::string_view;
+using std::println;
+using std::string;
+
+namespace scan = http::scan;
+
+// A header block with no delimiter hits, so every kernel scans the
+// whole buffer.
+string makeBuffer(std::size_t size) {
+    const string_view alphabet = "abcdefghijklmnopqrstuvwxyz-ABCDEFGHIJ0123456789";
+    string buffer;
+    buffer.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        buffer.push_back(alphabet[(i * 7) % alphabet.size()]);
+    }
+    return buffer;
+}
+
+template <typename F>
+double bytesPerCycle(const string &buffer, int iterations, F &&f) {
+    std::size_t sink = 0;
+    uint64_t start = __rdtsc();
+
+    for (int i = 0; i < iterations; ++i) {
+        sink += f(buffer.data(), buffer.size());
+        asm volatile("" : : "r"(sink) : "memory");
+    }
+
+    uint64_t cycles = __rdtsc() - start;
+    return double(buffer.size()) * iterations / double(cycles);
+}
+
+bool verify(const scan::Kernels &k) {
+    const scan::Kernels &ref = scan::kernelsFor(scan::Isa::Scalar);
+    string request =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "X-Bad\x01Value: \x7f\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+
+    for (std::size_t n = 0; n <= request.size(); ++n) {
+        const char *p = request.data();
+        if (k.findHeaderEnd(p, n) != ref.findHeaderEnd(p, n)
+            || k.findChar(p, n, ':') != ref.findChar(p, n, ':')
+            || k.findNonToken(p, n) != ref.findNonToken(p, n)
+            || k.findControl(p + 42, n > 42 ? n - 42 : 0)
+                != ref.findControl(p + 42, n > 42 ? n - 42 : 0)) {
+            return false;
+        }
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        string block(64, 'a');
+        block[37] = static_cast<char>(c);
+        if (k.findNonToken(block.data(), block.size())
+                != ref.findNonToken(block.data(), block.size())
+            || k.findControl(block.data(), block.size())
+                != ref.findControl(block.data(), block.size())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    constexpr int iterations = 200000;
+    string buffer = makeBuffer(4096);
+
+    println("{:<8} {:>10} {:>10} {:>10} {:>10}  (bytes/cycle, 4 KB buffer)",
+        "isa", "headerEnd", "char", "nonToken", "control");
+
+    for (scan::Isa isa : { scan::Isa::Scalar, scan::Isa::Sse42, scan::Isa::Avx2 }) {
+        if (!scan::supported(isa)) {
+            println("{:<8} unsupported on this cpu", scan::isaName(isa));
+            continue;
+        }
+
+        const scan::Kernels &k = scan::kernelsFor(isa);
+        if (!verify(k)) {
+            println("{:<8} MISMATCH against scalar kernels", scan::isaName(isa));
+            return 1;
+        }
+
+        println("{:<8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}",
+            scan::isaName(isa),
+            bytesPerCycle(buffer, iterations, k.findHeaderEnd),
+            bytesPerCycle(buffer, iterations, [&](const char *p, std::size_t n) {
+                return k.findChar(p, n, ':');
+            }),
+            bytesPerCycle(buffer, iterations, k.findNonToken),
+            bytesPerCycle(buffer, iterations, k.findControl)
+        );
+    }
+
+    println("active: {}", scan::isaName(scan::kernels().isa));
+
+    return 0;
+}
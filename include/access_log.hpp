@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string_view>
+#include <filesystem>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <mutex>
+
+namespace http {
+    enum class AccessMethod : std::uint8_t {
+        Get,
+        Post,
+        Put,
+        Delete,
+        Head,
+        Options,
+        Patch,
+        Other,
+    };
+
+    constexpr std::uint32_t no_route = 0xFFFFFFFF;
+
+    // One fixed-layout record per request. A zero timestamp marks a slot
+    // that has not been written yet; it is stored last.
+    struct AccessRecord {
+        std::uint64_t timestamp_ns;
+        std::uint64_t latency_ns;
+        std::uint64_t bytes;
+        std::uint32_t route_id;
+        std::int32_t fd;
+        std::uint16_t status;
+        AccessMethod method;
+        std::uint8_t reserved[5];
+    };
+
+    static_assert(sizeof(AccessRecord) == 40);
+
+    struct AccessLogHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t record_size;
+        std::uint64_t capacity;
+        std::uint64_t first_sequence;
+        std::uint8_t reserved[32];
+    };
+
+    static_assert(sizeof(AccessLogHeader) == 64);
+
+    constexpr std::string_view access_log_magic = "HTTPACL1";
+
+    struct ResponseInfo {
+        std::uint16_t status = 0;
+        std::uint32_t route_id = no_route;
+    };
+
+    class AccessLog {
+        public:
+            AccessLog();
+            AccessLog(const AccessLog&) = delete;
+            AccessLog& operator=(const AccessLog&) = delete;
+            ~AccessLog();
+            std::expected<void, std::string> open(
+                const std::string &directory,
+                std::size_t records_per_file,
+                int max_files
+            );
+            bool enabled() const;
+            void record(const AccessRecord &record);
+
+        private:
+            // The mapping fields only change while live is clear and no
+            // writer holds the segment; a writer counts itself in before
+            // it looks at live, and a rotation clears live before it
+            // waits for the count to drain.
+            struct Segment {
+                void *map = nullptr;
+                std::size_t map_size = 0;
+                AccessRecord *records = nullptr;
+                std::uint64_t base = 0;
+                std::uint64_t capacity = 0;
+                std::atomic<bool> live = false;
+                std::atomic<int> writers = 0;
+            };
+
+            // Writers that reserved a slot just before a rotation may
+            // still be storing into the previous file, so the last few
+            // stay mapped.
+            constexpr static int mapped_segments_ = 3;
+            std::filesystem::path directory_;
+            std::size_t records_per_file_;
+            int max_files_;
+            std::uint64_t file_number_;
+            std::atomic<std::uint64_t> next_;
+            std::atomic<Segment *> current_;
+            Segment segments_[mapped_segments_];
+            int segment_index_;
+            std::mutex rotate_mutex_;
+
+        private:
+            Segment *pin(std::uint64_t sequence);
+            Segment *segmentFor(std::uint64_t sequence);
+            bool rotate();
+            bool mapSegment(Segment &segment, std::uint64_t base);
+            void unmapSegment(Segment &segment);
+            std::filesystem::path fileFor(std::uint64_t number) const;
+    };
+
+    AccessMethod accessMethod(std::string_view method);
+    std::string_view accessMethodName(AccessMethod method);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory_resource>
+#include <string_view>
+#include <functional>
+#include <cstddef>
+#include <iterator>
+#include <format>
+#include <string>
+
+#include "http_parser.hpp"
+#include "router.hpp"
+
+namespace http {
+    // Scratch memory for one request. Allocations bump through an inline
+    // block and then through blocks lent by a pool; reset() rewinds all of
+    // it at once and the pool keeps its blocks for the next request.
+    class Arena {
+        public:
+            Arena();
+            Arena(const Arena&) = delete;
+            Arena& operator=(const Arena&) = delete;
+            std::pmr::memory_resource *resource();
+            void reset();
+
+        private:
+            constexpr static std::size_t inline_size_ = 1 << 14;
+            constexpr static std::size_t largest_block_ = 1 << 20;
+            alignas(std::max_align_t) std::byte inline_[inline_size_];
+            std::pmr::unsynchronized_pool_resource upstream_;
+            std::pmr::monotonic_buffer_resource resource_;
+    };
+
+    // The request as an arena handler sees it: views into the connection's
+    // input, valid until the handler returns, and the arena to build the
+    // response in. The view a handler returns is copied out before the
+    // arena is reset.
+    class RequestView {
+        public:
+            RequestView(
+                const RequestHead &head,
+                std::string_view path,
+                const RouteParams &params,
+                Arena &arena
+            );
+            std::string_view method() const;
+            std::string_view target() const;
+            std::string_view path() const;
+            std::string_view param(std::string_view name) const;
+            std::string_view header(std::string_view name) const;
+            std::string_view body() const;
+            std::pmr::memory_resource *resource() const;
+
+            template <typename... Args>
+            std::string_view format(std::format_string<Args...> fmt, const Args &...args) const {
+                std::pmr::polymorphic_allocator<> allocator(arena_.resource());
+                auto *text = allocator.new_object<std::pmr::string>();
+                std::vformat_to(
+                    std::back_inserter(*text),
+                    fmt.get(),
+                    std::make_format_args(args...)
+                );
+                return *text;
+            }
+
+        private:
+            const RequestHead &head_;
+            std::string_view path_;
+            const RouteParams &params_;
+            Arena &arena_;
+    };
+
+    using ArenaHandler = std::function<std::string_view(RequestView &request)>;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string_view>
+#include <filesystem>
+#include <functional>
+#include <coroutine>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "http_parser.hpp"
+#include "timer_wheel.hpp"
+#include "access_log.hpp"
+#include "router.hpp"
+#include "task.hpp"
+
+namespace http {
+    class Reactor;
+    class Context;
+
+    struct Request {
+        std::string method;
+        std::string target;
+        std::string path;
+        std::string version;
+        RouteParams params;
+        std::vector<std::pair<std::string, std::string>> headers;
+
+        std::string_view header(std::string_view name) const;
+    };
+
+    struct Response {
+        std::uint16_t status = 200;
+        std::string content_type = "text/plain";
+        std::string body;
+    };
+
+    using AsyncHandler = std::function<Task<Response>(Context &context)>;
+
+    enum class WaitKind {
+        Done,
+        Failed,
+        Timer,
+        Readable,
+        Writable,
+        Drain,
+        Yield,
+        Body,
+    };
+
+    // What a coroutine handler co_awaits; it resumes on the reactor thread
+    // that owns the request. Resuming yields false when the wait could not
+    // be set up or the connection can no longer be written to.
+    class Wait {
+        public:
+            Wait(Context &context, WaitKind kind);
+            Wait(Context &context, WaitKind kind, int fd);
+            Wait(Context &context, std::chrono::steady_clock::time_point deadline);
+            bool await_ready() const noexcept;
+            bool await_suspend(std::coroutine_handle<> handle);
+            bool await_resume() const noexcept;
+
+        private:
+            Context &context_;
+            WaitKind kind_;
+            int fd_;
+            std::chrono::steady_clock::time_point deadline_;
+    };
+
+    class Context {
+        public:
+            Context(
+                Reactor &reactor,
+                int fd,
+                std::uint64_t connection_id,
+                bool keep_alive,
+                std::shared_ptr<const Request> request
+            );
+            Context(const Context&) = delete;
+            Context& operator=(const Context&) = delete;
+            ~Context();
+            const Request &request() const;
+            Wait sleep(std::chrono::milliseconds duration);
+            Wait readable(int fd);
+            Wait writable(int fd);
+            Wait yield();
+            Wait readBody();
+            std::string_view body() const;
+            bool stream(
+                std::uint16_t status,
+                std::string_view content_type,
+                std::size_t content_length
+            );
+            bool stream(std::uint16_t status, std::string_view content_type);
+            Wait write(std::string data);
+            Task<std::expected<std::string, std::string>> readFile(
+                std::filesystem::path path
+            );
+
+        private:
+            friend class Reactor;
+            friend class Wait;
+
+            Reactor &reactor_;
+            int fd_;
+            std::uint64_t connection_id_;
+            bool keep_alive_;
+            std::shared_ptr<const Request> request_;
+            std::coroutine_handle<> suspended_;
+            std::uint64_t wait_id_;
+            int wait_fd_;
+            bool wait_result_;
+            bool draining_;
+            bool streaming_;
+            bool chunked_;
+            bool bodiless_;
+            std::uint16_t status_;
+            std::size_t streamed_;
+            std::size_t content_length_;
+            std::size_t sent_;
+            std::string body_;
+            Timer timer_;
+            constexpr static std::size_t file_chunk_size_ = 1 << 16;
+            constexpr static std::size_t unknown_length_ = SIZE_MAX;
+
+        private:
+            bool suspend(
+                std::coroutine_handle<> handle,
+                WaitKind kind,
+                int fd,
+                std::chrono::steady_clock::time_point deadline
+            );
+            void resume(bool result);
+    };
+
+    // One coroutine request in flight on a connection.
+    struct AsyncRequest {
+        Context context;
+        Task<Response> task;
+        ResponseInfo info;
+        AccessMethod method = AccessMethod::Other;
+        std::chrono::steady_clock::time_point start;
+        bool compress = false;
+
+        AsyncRequest(
+            Reactor &reactor,
+            int fd,
+            std::uint64_t connection_id,
+            bool keep_alive,
+            const AsyncHandler &handler,
+            std::shared_ptr<const Request> request
+        );
+    };
+
+    std::shared_ptr<Request> makeRequest(
+        const RequestHead &head,
+        std::string_view path,
+        const RouteParams &params
+    );
+    // A HEAD response keeps the headers a GET would get; 204 and 304
+    // responses have no body either way.
+    bool sendsBody(std::string_view method, std::uint16_t status);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+
+#include "metrics.hpp"
+
+namespace http {
+    // Size-classed free lists, one pool per thread so lending and
+    // returning never take a lock. Sizes past the largest class are
+    // allocated exactly and freed on release.
+    class BufferPool {
+        public:
+            BufferPool();
+            BufferPool(const BufferPool&) = delete;
+            BufferPool& operator=(const BufferPool&) = delete;
+            ~BufferPool();
+            static BufferPool &local();
+            static PoolStats total();
+            static std::uint64_t pooledBytes();
+            char *acquire(std::size_t &capacity);
+            void release(char *data, std::size_t capacity);
+
+        private:
+            constexpr static std::size_t class_count_ = 5;
+            constexpr static std::array<std::size_t, class_count_> class_sizes_ = {
+                4096, 16384, 65536, 262144, 1 << 21,
+            };
+            constexpr static std::array<std::size_t, class_count_> class_limits_ = {
+                1024, 256, 64, 16, 4,
+            };
+            std::array<std::vector<char *>, class_count_> free_;
+            Counter hits_;
+            Counter misses_;
+            Counter pooled_bytes_;
+
+        private:
+            static int classFor(std::size_t size);
+    };
+
+    // A byte buffer borrowed from the calling thread's pool; it holds no
+    // memory until something is written to it and gives it back when
+    // emptied.
+    class Buffer {
+        public:
+            Buffer() = default;
+            Buffer(Buffer &&other) noexcept;
+            Buffer &operator=(Buffer &&other) noexcept;
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+            ~Buffer();
+            char *data();
+            const char *data() const;
+            std::size_t size() const;
+            bool empty() const;
+            char *tail();
+            std::size_t room() const;
+            void reserve(std::size_t room);
+            void commit(std::size_t bytes);
+            void append(const char *data, std::size_t bytes);
+            void consume(std::size_t bytes);
+            void erase(std::size_t offset, std::size_t bytes);
+            void reset();
+
+        private:
+            char *data_ = nullptr;
+            std::size_t size_ = 0;
+            std::size_t capacity_ = 0;
+    };
+}
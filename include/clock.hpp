@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <ctime>
+
+namespace http {
+    class Clock {
+        public:
+            static Clock &get();
+            Clock(const Clock&) = delete;
+            Clock& operator=(const Clock&) = delete;
+            ~Clock();
+            std::string_view date() const;
+            std::string_view dateHeader() const;
+            std::string_view logTime() const;
+            std::int64_t seconds() const;
+            std::int64_t wallTime(std::chrono::steady_clock::time_point at) const;
+
+        private:
+            // wall_ns and steady are read together at each tick, so a
+            // steady instant maps to wall time without another clock read
+            struct Snapshot {
+                std::int64_t seconds = 0;
+                std::int64_t wall_ns = 0;
+                std::chrono::steady_clock::time_point steady;
+                char date_header[64];
+                std::size_t date_header_length = 0;
+                char log_time[32];
+                std::size_t log_time_length = 0;
+            };
+
+            // Readers may still hold a view into a snapshot after the
+            // ticker moves on; with one tick per second a slot is only
+            // rewritten after slot_count_ seconds.
+            constexpr static int slot_count_ = 16;
+            Snapshot slots_[slot_count_];
+            std::atomic<const Snapshot *> current_;
+            int next_slot_;
+            bool running_;
+            std::mutex mutex_;
+            std::condition_variable stop_;
+            std::thread ticker_;
+
+        private:
+            Clock();
+            void update(std::time_t now);
+            void run();
+    };
+
+    std::string httpDate(std::time_t time);
+}
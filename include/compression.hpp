@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <zlib.h>
+
+#include "metrics.hpp"
+
+namespace http {
+    enum class Encoding : std::uint8_t {
+        Identity,
+        Gzip,
+        Brotli,
+    };
+
+    // Fast is for responses compressed as they go out, Best for static
+    // files that are compressed once and cached.
+    enum class CompressionLevel {
+        Fast,
+        Best,
+    };
+
+    // Responses smaller than min_size go out as they are; the framing
+    // would eat most of the saving.
+    struct CompressionConfig {
+        bool enabled = true;
+        std::size_t min_size = 1024;
+    };
+
+    // One per thread, so the deflate state is set up once and reset
+    // between responses rather than allocated for each of them.
+    class Compressor {
+        public:
+            Compressor();
+            Compressor(const Compressor&) = delete;
+            Compressor& operator=(const Compressor&) = delete;
+            ~Compressor();
+            static Compressor &local();
+            static CompressionStats total();
+            bool compress(
+                Encoding encoding,
+                std::string_view input,
+                CompressionLevel level,
+                std::string &output
+            );
+
+        private:
+            z_stream zlib_;
+            bool zlib_ready_;
+            int zlib_level_;
+            Counter responses_;
+            Counter bytes_in_;
+            Counter bytes_out_;
+            Counter cpu_ns_;
+
+        private:
+            bool gzip(std::string_view input, CompressionLevel level, std::string &output);
+            bool brotli(std::string_view input, CompressionLevel level, std::string &output);
+    };
+
+    Encoding compressBody(
+        const CompressionConfig &config,
+        std::string_view accept_encoding,
+        std::string_view body,
+        std::string &encoded
+    );
+    Encoding negotiateEncoding(std::string_view accept_encoding, bool gzip, bool brotli);
+    std::string_view encodingName(Encoding encoding);
+    bool isCompressible(std::string_view content_type);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "http_parser.hpp"
+#include "buffer_pool.hpp"
+#include "timer_wheel.hpp"
+#include "websocket.hpp"
+#include "output.hpp"
+#include "async.hpp"
+
+namespace http {
+    enum class ConnectionState {
+        Reading,
+        Writing,
+        Closing,
+    };
+
+    // What a connection's timer is waiting on.
+    enum class Timeout {
+        None,
+        Header,
+        Body,
+        Idle,
+        Write,
+    };
+
+    // The sendmsg arguments handed to io_uring; they have to stay put until
+    // the kernel completes the send.
+    struct SendState {
+        msghdr message {};
+        iovec iov[64];
+    };
+
+    struct Connection {
+        int fd = -1;
+        std::uint64_t id = 0;
+        ConnectionState state = ConnectionState::Reading;
+        Buffer in;
+        std::size_t in_offset = 0;
+        RequestParser parser;
+        OutputQueue out;
+        std::unique_ptr<WebSocket> websocket;
+        std::unique_ptr<AsyncRequest> async;
+        int requests_served = 0;
+        bool close_after_write = false;
+        bool read_paused = false;
+        bool in_flight = false;
+        std::unique_ptr<SendState> send;
+        bool recv_armed = false;
+        bool peer_closed = false;
+        bool sending = false;
+        bool close_queued = false;
+        bool close_submitted = false;
+        Timer timer;
+        Timeout timeout = Timeout::None;
+        Timeout reading = Timeout::None;
+        BodyReader body;
+        std::size_t body_raw = 0;
+        bool body_buffering = false;
+        bool body_streaming = false;
+        bool body_waiting = false;
+    };
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "connection.hpp"
+#include "metrics.hpp"
+
+namespace http {
+    // Connections carved out of fixed chunks and indexed by descriptor.
+    // A closed connection's slot goes on a free list for the next accept,
+    // so steady traffic allocates nothing per connection. The counts may
+    // be read from any thread.
+    class ConnectionSlab {
+        public:
+            ConnectionSlab() = default;
+            ConnectionSlab(const ConnectionSlab&) = delete;
+            ConnectionSlab& operator=(const ConnectionSlab&) = delete;
+            Connection &acquire(int fd);
+            Connection *find(int fd);
+            void release(int fd);
+            bool contains(int fd) const;
+            bool empty() const;
+            std::size_t size() const;
+            void clear();
+            const std::vector<int> &live() const;
+            std::uint64_t openCount() const;
+            PoolStats stats() const;
+
+        private:
+            constexpr static std::size_t chunk_size_ = 256;
+            std::vector<std::unique_ptr<Connection[]>> chunks_;
+            std::size_t fresh_ = 0;
+            std::vector<Connection *> free_;
+            std::vector<Connection *> by_fd_;
+            std::vector<std::uint32_t> positions_;
+            std::vector<int> live_;
+            Counter open_;
+            Counter hits_;
+            Counter misses_;
+
+        private:
+            static void reset(Connection &conn);
+    };
+}
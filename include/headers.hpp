@@ -0,0 +1,175 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <array>
+
+#include "output.hpp"
+
+namespace http {
+    // RFC 9110 section 15, plus 429 and 431 from RFC 6585.
+    enum class Status : std::uint16_t {
+        Continue = 100,
+        SwitchingProtocols = 101,
+        Ok = 200,
+        Created = 201,
+        Accepted = 202,
+        NonAuthoritativeInformation = 203,
+        NoContent = 204,
+        ResetContent = 205,
+        PartialContent = 206,
+        MultipleChoices = 300,
+        MovedPermanently = 301,
+        Found = 302,
+        SeeOther = 303,
+        NotModified = 304,
+        UseProxy = 305,
+        TemporaryRedirect = 307,
+        PermanentRedirect = 308,
+        BadRequest = 400,
+        Unauthorized = 401,
+        PaymentRequired = 402,
+        Forbidden = 403,
+        NotFound = 404,
+        MethodNotAllowed = 405,
+        NotAcceptable = 406,
+        ProxyAuthenticationRequired = 407,
+        RequestTimeout = 408,
+        Conflict = 409,
+        Gone = 410,
+        LengthRequired = 411,
+        PreconditionFailed = 412,
+        ContentTooLarge = 413,
+        UriTooLong = 414,
+        UnsupportedMediaType = 415,
+        RangeNotSatisfiable = 416,
+        ExpectationFailed = 417,
+        MisdirectedRequest = 421,
+        UnprocessableContent = 422,
+        UpgradeRequired = 426,
+        TooManyRequests = 429,
+        RequestHeaderFieldsTooLarge = 431,
+        InternalServerError = 500,
+        NotImplemented = 501,
+        BadGateway = 502,
+        ServiceUnavailable = 503,
+        GatewayTimeout = 504,
+        HttpVersionNotSupported = 505,
+    };
+
+    struct StatusLine {
+        std::uint16_t code;
+        std::string_view line;
+    };
+
+    constexpr StatusLine status_lines[] = {
+        { 100, "HTTP/1.1 100 Continue\r\n" },
+        { 101, "HTTP/1.1 101 Switching Protocols\r\n" },
+        { 200, "HTTP/1.1 200 OK\r\n" },
+        { 201, "HTTP/1.1 201 Created\r\n" },
+        { 202, "HTTP/1.1 202 Accepted\r\n" },
+        { 203, "HTTP/1.1 203 Non-Authoritative Information\r\n" },
+        { 204, "HTTP/1.1 204 No Content\r\n" },
+        { 205, "HTTP/1.1 205 Reset Content\r\n" },
+        { 206, "HTTP/1.1 206 Partial Content\r\n" },
+        { 300, "HTTP/1.1 300 Multiple Choices\r\n" },
+        { 301, "HTTP/1.1 301 Moved Permanently\r\n" },
+        { 302, "HTTP/1.1 302 Found\r\n" },
+        { 303, "HTTP/1.1 303 See Other\r\n" },
+        { 304, "HTTP/1.1 304 Not Modified\r\n" },
+        { 305, "HTTP/1.1 305 Use Proxy\r\n" },
+        { 307, "HTTP/1.1 307 Temporary Redirect\r\n" },
+        { 308, "HTTP/1.1 308 Permanent Redirect\r\n" },
+        { 400, "HTTP/1.1 400 Bad Request\r\n" },
+        { 401, "HTTP/1.1 401 Unauthorized\r\n" },
+        { 402, "HTTP/1.1 402 Payment Required\r\n" },
+        { 403, "HTTP/1.1 403 Forbidden\r\n" },
+        { 404, "HTTP/1.1 404 Not Found\r\n" },
+        { 405, "HTTP/1.1 405 Method Not Allowed\r\n" },
+        { 406, "HTTP/1.1 406 Not Acceptable\r\n" },
+        { 407, "HTTP/1.1 407 Proxy Authentication Required\r\n" },
+        { 408, "HTTP/1.1 408 Request Timeout\r\n" },
+        { 409, "HTTP/1.1 409 Conflict\r\n" },
+        { 410, "HTTP/1.1 410 Gone\r\n" },
+        { 411, "HTTP/1.1 411 Length Required\r\n" },
+        { 412, "HTTP/1.1 412 Precondition Failed\r\n" },
+        { 413, "HTTP/1.1 413 Content Too Large\r\n" },
+        { 414, "HTTP/1.1 414 URI Too Long\r\n" },
+        { 415, "HTTP/1.1 415 Unsupported Media Type\r\n" },
+        { 416, "HTTP/1.1 416 Range Not Satisfiable\r\n" },
+        { 417, "HTTP/1.1 417 Expectation Failed\r\n" },
+        { 421, "HTTP/1.1 421 Misdirected Request\r\n" },
+        { 422, "HTTP/1.1 422 Unprocessable Content\r\n" },
+        { 426, "HTTP/1.1 426 Upgrade Required\r\n" },
+        { 429, "HTTP/1.1 429 Too Many Requests\r\n" },
+        { 431, "HTTP/1.1 431 Request Header Fields Too Large\r\n" },
+        { 500, "HTTP/1.1 500 Internal Server Error\r\n" },
+        { 501, "HTTP/1.1 501 Not Implemented\r\n" },
+        { 502, "HTTP/1.1 502 Bad Gateway\r\n" },
+        { 503, "HTTP/1.1 503 Service Unavailable\r\n" },
+        { 504, "HTTP/1.1 504 Gateway Timeout\r\n" },
+        { 505, "HTTP/1.1 505 HTTP Version Not Supported\r\n" },
+    };
+
+    // code -> position in status_lines plus one, zero for codes not listed
+    constexpr auto status_index = [] {
+        std::array<std::uint8_t, 600> index {};
+        for (std::size_t i = 0; i < std::size(status_lines); ++i) {
+            index[status_lines[i].code] = static_cast<std::uint8_t>(i + 1);
+        }
+        return index;
+    }();
+
+    constexpr std::string_view statusLine(std::uint16_t status) {
+        if (status >= status_index.size() || status_index[status] == 0) {
+            return {};
+        }
+
+        return status_lines[status_index[status] - 1].line;
+    }
+
+    constexpr std::string_view statusReason(std::uint16_t status) {
+        std::string_view line = statusLine(status);
+        if (line.empty()) {
+            return "Unknown";
+        }
+
+        // "HTTP/1.1 NNN " in front, "\r\n" behind
+        return line.substr(13, line.size() - 15);
+    }
+
+    static_assert(statusReason(404) == "Not Found");
+    static_assert(statusReason(599) == "Unknown");
+
+    constexpr std::string_view keep_alive_header = "Connection: keep-alive\r\n";
+    constexpr std::string_view close_header = "Connection: close\r\n";
+
+    std::string_view mimeType(std::string_view extension);
+
+    // Builds a response head piece by piece, either straight into an
+    // output queue, where the pieces coalesce into one pooled segment, or
+    // onto a string. Nothing goes through a format string.
+    class HeadWriter {
+        public:
+            HeadWriter(OutputQueue &out, std::uint16_t status);
+            HeadWriter(std::string &text, std::uint16_t status);
+            HeadWriter(OutputQueue &out, std::string_view prefix);
+            HeadWriter &header(std::string_view fragment);
+            HeadWriter &header(std::string_view name, std::string_view value);
+            HeadWriter &contentType(std::string_view type);
+            HeadWriter &contentLength(std::size_t length);
+            HeadWriter &connection(bool keep_alive);
+            HeadWriter &date();
+            void end();
+
+        private:
+            OutputQueue *out_;
+            std::string *text_;
+
+        private:
+            void status(std::uint16_t status);
+            void put(std::string_view text);
+    };
+}
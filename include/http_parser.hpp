@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+namespace http {
+    enum class ParseStatus {
+        Complete,
+        Incomplete,
+        Error,
+        TooLarge,
+        // a well-formed HTTP/x.y other than 1.0 and 1.1
+        UnsupportedVersion,
+    };
+
+    struct Header {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    struct RequestHead {
+        constexpr static std::size_t max_headers = 64;
+
+        std::string_view method;
+        std::string_view target;
+        std::string_view version;
+        Header headers[max_headers];
+        std::size_t header_count = 0;
+        std::size_t content_length = 0;
+        std::size_t length = 0;
+        bool chunked = false;
+        // Set by whoever reads the body: false while it is still to come,
+        // and then the whole decoded body if it was buffered.
+        bool body_ready = true;
+        std::string_view body;
+
+        std::string_view header(std::string_view name) const;
+    };
+
+    class RequestParser {
+        public:
+            RequestParser();
+            explicit RequestParser(std::size_t max_header_size);
+            ParseStatus parse(std::string_view buffer, RequestHead &head);
+            void reset();
+
+        private:
+            std::size_t max_header_size_;
+            std::size_t scanned_;
+
+        private:
+            ParseStatus parseRequestLine(
+                std::string_view line,
+                RequestHead &head
+            );
+            ParseStatus parseHeaderLine(
+                std::string_view line,
+                RequestHead &head
+            );
+    };
+
+    // Reads a request body framed by Content-Length or chunked transfer
+    // coding, a piece at a time. Pieces are views into the input; chunk
+    // sizes, extensions and trailers are consumed and dropped.
+    class BodyReader {
+        public:
+            BodyReader();
+            ParseStatus start(const RequestHead &head, std::size_t max_size);
+            ParseStatus read(
+                std::string_view input,
+                std::size_t &consumed,
+                std::string_view &data
+            );
+            std::size_t size() const;
+
+        private:
+            enum class State : std::uint8_t {
+                Length,
+                Size,
+                Extension,
+                SizeEnd,
+                Data,
+                DataEnd,
+                DataEndLine,
+                Trailer,
+                TrailerLine,
+                TrailerEnd,
+                Done,
+            };
+
+            State state_;
+            std::size_t max_size_;
+            std::size_t size_;
+            std::size_t left_;
+            std::size_t digits_;
+    };
+
+    bool equalsIgnoreCase(std::string_view a, std::string_view b);
+}
@@ -1,10 +1,28 @@
 #pragma once
 
+#include <string_view>
 #include <functional>
+#include <cstddef>
+#include <chrono>
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
-#include <map>
+#include <mutex>
 
+#include "http_parser.hpp"
+#include "static_files.hpp"
+#include "access_log.hpp"
+#include "compression.hpp"
+#include "headers.hpp"
+#include "arena.hpp"
+#include "thread_pool.hpp"
+#include "websocket.hpp"
+#include "reactor.hpp"
+#include "metrics.hpp"
+#include "async.hpp"
+#include "router.hpp"
+#include "output.hpp"
 #include "logger.hpp"
 
 enum class Method {
@@ -32,16 +50,31 @@ enum class ContentType {
     Icon,
 };
 
-enum class Status {
-    Ok,
-    NotFound,
-    BadRequest,
+// Pool routes run on the handler thread pool instead of the event loop
+// that parsed the request; use it for handlers that block or burn CPU.
+enum class Execution {
+    Inline,
+    Pool,
 };
 
+using Status = http::Status;
+
 struct Endpoint {
     Method method;
     std::function<std::string(std::string endpoint)> handler;
+    std::function<std::string(
+        std::string_view path,
+        const http::RouteParams &params
+    )> param_handler;
+    http::ArenaHandler arena_handler;
+    http::AsyncHandler async_handler;
+    std::shared_ptr<const http::WebSocketHandler> websocket;
     ContentType content_type;
+    Execution execution = Execution::Inline;
+    // status line and Content-Type, serialized when the route is added
+    std::string head;
+    std::string pattern;
+    bool compress = true;
 };
 
 class HttpServer {
@@ -64,6 +97,14 @@ public:
         bool log_to_console,
         bool log_to_file
     );
+    HttpServer(
+        std::string address,
+        int port,
+        int queue_size,
+        int workers,
+        bool log_to_console,
+        bool log_to_file
+    );
 
     ~HttpServer();
 
@@ -74,23 +115,155 @@ public:
         std::function<std::string(std::string endpoint)> handler,
         ContentType content_type
     );
+    void route(
+        std::string endpoint,
+        Method method,
+        std::function<std::string(std::string endpoint)> handler,
+        ContentType content_type,
+        Execution execution
+    );
+    void route(
+        std::string endpoint,
+        Method method,
+        std::function<std::string(
+            std::string_view path,
+            const http::RouteParams &params
+        )> handler,
+        ContentType content_type
+    );
+    void route(
+        std::string endpoint,
+        Method method,
+        std::function<std::string(
+            std::string_view path,
+            const http::RouteParams &params
+        )> handler,
+        ContentType content_type,
+        Execution execution
+    );
+    void route(
+        std::string endpoint,
+        Method method,
+        http::ArenaHandler handler,
+        ContentType content_type
+    );
+    void route(std::string endpoint, Method method, http::AsyncHandler handler);
+    void websocket(std::string endpoint, http::WebSocketHandler handler);
+    void broadcast(std::string_view endpoint, std::string_view message);
+    http::Metrics metrics();
+    void setLogLevel(LogLevel level);
+    void setAccessLog(std::string directory);
+    void setAccessLog(
+        std::string directory,
+        std::size_t records_per_file,
+        int max_files
+    );
+    void setThreadPool(std::size_t threads);
+    void setBackend(http::Backend backend);
+    void setKeepAlive(int timeout_seconds, int max_requests);
+    void setTimeouts(int header_seconds, int body_seconds, int write_seconds);
+    void setMaxBodySize(std::size_t max_body_size);
+    void setCompression(bool enabled, std::size_t min_size);
+    void setRouteCompression(std::string_view endpoint, Method method, bool enabled);
+    void setStaticCache(std::size_t cache_budget, std::size_t max_file_size);
     void serveDir(std::string directory);
+    void serveDir(std::string directory, bool hot_reload);
     void acceptClient();
+    void acceptClientWithLoop();
 
 private:
     std::string address;
     int port;
     int queue_size;
+    int workers;
     Logger log;
     int server_socket;
-    std::vector<std::map<std::string, Endpoint>> endpoints;
+    // pool jobs hold on to their endpoint, so adding one never moves another
+    std::deque<Endpoint> endpoints;
+    http::Router router;
+    http::StaticFilesConfig static_config;
+    http::StaticFiles static_files {log};
+    http::ReactorConfig reactor_config;
+    http::AccessLog access_log;
+    std::unique_ptr<http::ThreadPool> thread_pool;
+    bool hot_reload = false;
+    std::vector<http::Reactor *> reactors;
+    std::mutex reactors_mutex;
 
 private:
     void prepareSocket();
+    int createListenSocket();
+    void runReactor(int listen_socket);
+    void pinToCore(int worker);
+    void broadcastReload();
+    const http::WebSocketHandler *findWebSocket(std::string_view path);
     void handleClientRequest(int client_socket);
-    std::map<std::string, std::string> parseHttpHeader(
-        const std::string &request
+    http::ParseStatus receiveBody(
+        int client_socket,
+        const http::RequestHead &head,
+        std::string_view received,
+        std::string &body
+    );
+    std::chrono::steady_clock::time_point deadlineAfter(int seconds);
+    bool waitForSocket(
+        int socket,
+        short events,
+        std::chrono::steady_clock::time_point deadline
+    );
+    http::Reactor::Deferred buildResponse(
+        const http::RequestHead &head,
+        bool &keep_alive,
+        http::OutputQueue &out,
+        http::ResponseInfo &info,
+        http::Arena &arena
+    );
+    http::Reactor::Deferred deferResponse(
+        const Endpoint &end,
+        const http::RequestHead &head,
+        std::string_view path,
+        const http::RouteParams &params,
+        bool head_only
+    );
+    void handlerFailed(
+        std::string_view target,
+        bool &keep_alive,
+        http::OutputQueue &out,
+        http::ResponseInfo &info,
+        bool head_only
+    );
+    void writeResponse(
+        const Endpoint &end,
+        std::string_view accept_encoding,
+        std::string response,
+        bool keep_alive,
+        bool head_only,
+        http::OutputQueue &out,
+        http::ResponseInfo &info
+    );
+    void writeHead(
+        const Endpoint &end,
+        std::size_t content_length,
+        http::Encoding encoding,
+        bool keep_alive,
+        http::OutputQueue &out,
+        http::ResponseInfo &info
+    );
+    bool compresses(const Endpoint &end);
+    http::Encoding encodeBody(
+        const Endpoint &end,
+        std::string_view accept_encoding,
+        std::string_view body,
+        std::string &encoded
+    );
+    void writeError(
+        Status status,
+        bool keep_alive,
+        http::OutputQueue &out,
+        http::ResponseInfo &info,
+        bool head_only = false
     );
-    std::string getContentTypeString(ContentType content_type);
+    bool wantsKeepAlive(const http::RequestHead &head);
+    std::string_view getContentTypeString(ContentType content_type);
+    void addRoute(std::string_view endpoint, Endpoint end);
     void closeSocket(int socket);
 };
@@ -1,19 +1,128 @@
 #pragma once
 
+#include <condition_variable>
+#include <string_view>
+#include <cstdint>
+#include <format>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+enum class LogLevel {
+    Trace,
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+// Levels below LOG_MIN_LEVEL (0 = trace ... 5 = off) compile to nothing.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+constexpr LogLevel min_log_level = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+enum class LogMode {
+    Sync,
+    Async,
+};
+
+enum class LogOverflow {
+    Drop,
+    Block,
+};
 
 class Logger {
 public:
     Logger(bool to_console, bool to_file);
-    void info(std::string message);
-    void error(std::string message);
+    Logger(bool to_console, bool to_file, LogMode mode, LogOverflow overflow);
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+    ~Logger();
+    void setLevel(LogLevel level);
+    bool enabled(LogLevel level) const;
+    void flush();
+
+    template <typename... Args>
+    void trace(std::format_string<Args...> fmt, Args &&...args) {
+        if constexpr (LogLevel::Trace >= min_log_level) {
+            if (enabled(LogLevel::Trace)) {
+                write(LogLevel::Trace, fmt.get(), std::make_format_args(args...));
+            }
+        }
+    }
+
+    template <typename... Args>
+    void debug(std::format_string<Args...> fmt, Args &&...args) {
+        if constexpr (LogLevel::Debug >= min_log_level) {
+            if (enabled(LogLevel::Debug)) {
+                write(LogLevel::Debug, fmt.get(), std::make_format_args(args...));
+            }
+        }
+    }
+
+    template <typename... Args>
+    void info(std::format_string<Args...> fmt, Args &&...args) {
+        if constexpr (LogLevel::Info >= min_log_level) {
+            if (enabled(LogLevel::Info)) {
+                write(LogLevel::Info, fmt.get(), std::make_format_args(args...));
+            }
+        }
+    }
+
+    template <typename... Args>
+    void warn(std::format_string<Args...> fmt, Args &&...args) {
+        if constexpr (LogLevel::Warn >= min_log_level) {
+            if (enabled(LogLevel::Warn)) {
+                write(LogLevel::Warn, fmt.get(), std::make_format_args(args...));
+            }
+        }
+    }
+
+    template <typename... Args>
+    void error(std::format_string<Args...> fmt, Args &&...args) {
+        if constexpr (LogLevel::Error >= min_log_level) {
+            if (enabled(LogLevel::Error)) {
+                write(LogLevel::Error, fmt.get(), std::make_format_args(args...));
+            }
+        }
+    }
 
 private:
+    struct Ring;
+
     bool to_console;
     bool to_file;
+    std::atomic<LogLevel> level;
+    LogMode mode;
+    LogOverflow overflow;
+    int file_fd;
+    std::uint64_t id;
+    std::mutex write_mutex;
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::atomic<bool> running;
+    std::atomic<std::uint64_t> dropped;
+    std::atomic<std::uint64_t> flush_requests;
+    std::atomic<std::uint64_t> flushes_done;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::condition_variable space;
+    std::atomic<int> blocked;
+    std::thread writer;
 
 private:
-    std::string getDateTimeNow();
-    void appendFile(std::string filePath, std::string message);
-    void handleMessage(std::string message, std::string log_type);
+    void openFile();
+    std::string formatTime(std::int64_t time_ns);
+    void writeAll(int fd, std::string_view data);
+    void write(LogLevel level, std::string_view fmt, std::format_args args);
+    Ring &localRing();
+    void push(std::string_view log_type, std::string_view fmt, std::format_args args);
+    bool drain(std::string &batch);
+    void run();
 };
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+
+namespace http {
+    // Written by the one thread that owns it and read by anyone; a plain
+    // load and store keeps locked instructions off the hot path.
+    class Counter {
+        public:
+            void add(std::uint64_t n = 1) {
+                value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+
+            void sub(std::uint64_t n = 1) {
+                value_.store(value_.load(std::memory_order_relaxed) - n, std::memory_order_relaxed);
+            }
+
+            std::uint64_t get() const {
+                return value_.load(std::memory_order_relaxed);
+            }
+
+        private:
+            std::atomic<std::uint64_t> value_ {0};
+    };
+
+    struct PoolStats {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+
+        double hitRate() const;
+    };
+
+    // cpu_ns is thread CPU time spent compressing, including failed tries.
+    struct CompressionStats {
+        std::uint64_t responses = 0;
+        std::uint64_t bytes_in = 0;
+        std::uint64_t bytes_out = 0;
+        std::uint64_t cpu_ns = 0;
+    };
+
+    struct Metrics {
+        std::uint64_t connections = 0;
+        PoolStats connection_slots;
+        PoolStats buffers;
+        std::uint64_t pooled_buffer_bytes = 0;
+        CompressionStats compression;
+    };
+
+    std::string formatMetrics(const Metrics &metrics);
+}
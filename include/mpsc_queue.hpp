@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+
+namespace http {
+    // Intrusive lock-free queue for many producers and one consumer. Nodes
+    // need a `T *next` member; producers push onto a stack and the
+    // consumer takes the whole stack at once and reverses it.
+    template <typename T>
+    class MpscQueue {
+        public:
+            // Returns true when the queue was empty, so only the first
+            // producer after a drain has to wake the consumer.
+            bool push(T *node) {
+                T *head = head_.load(std::memory_order_relaxed);
+                do {
+                    node->next = head;
+                } while (!head_.compare_exchange_weak(
+                    head,
+                    node,
+                    std::memory_order_release,
+                    std::memory_order_relaxed
+                ));
+
+                return head == nullptr;
+            }
+
+            // Everything pushed so far, oldest first.
+            T *popAll() {
+                T *node = head_.exchange(nullptr, std::memory_order_acquire);
+                T *ordered = nullptr;
+
+                while (node) {
+                    T *next = node->next;
+                    node->next = ordered;
+                    ordered = node;
+                    node = next;
+                }
+
+                return ordered;
+            }
+
+        private:
+            std::atomic<T *> head_ {nullptr};
+    };
+}
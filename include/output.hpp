@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string_view>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "buffer_pool.hpp"
+
+namespace http {
+    enum class FlushStatus {
+        Done,
+        Blocked,
+        Error,
+    };
+
+    class FileHandle {
+        public:
+            explicit FileHandle(int fd);
+            FileHandle(const FileHandle&) = delete;
+            FileHandle& operator=(const FileHandle&) = delete;
+            ~FileHandle();
+            int get() const;
+
+        private:
+            int fd_;
+    };
+
+    struct SplicePipe;
+
+    class OutputQueue {
+        public:
+            void append(std::string data);
+            void append(
+                std::shared_ptr<const std::string> owner,
+                std::string_view data
+            );
+            void appendStatic(std::string_view data);
+            void appendCopy(std::string_view data);
+            void appendFile(
+                std::shared_ptr<FileHandle> file,
+                std::size_t offset,
+                std::size_t size
+            );
+            void append(OutputQueue &&other);
+            bool empty() const;
+            std::size_t pending() const;
+            FlushStatus flush(int fd);
+            int gather(iovec *iov, int max, int &flags);
+            void complete(std::size_t bytes);
+            bool frontIsFile() const;
+            void clear();
+
+        private:
+            enum class SegmentKind {
+                Owned,
+                Copied,
+                Borrowed,
+                File,
+            };
+
+            // Owned strings are always past the small-string size, so a
+            // segment can move without moving the bytes being sent.
+            struct Segment {
+                SegmentKind kind;
+                std::string owned;
+                Buffer copied;
+                std::shared_ptr<const std::string> owner;
+                std::string_view borrowed;
+                std::shared_ptr<FileHandle> file;
+                std::shared_ptr<SplicePipe> pipe;
+                std::size_t file_offset = 0;
+                std::size_t in_pipe = 0;
+                std::size_t size = 0;
+                std::size_t sent = 0;
+
+                const char *data() const;
+            };
+
+            constexpr static int max_iovecs_ = 64;
+            constexpr static std::size_t sendfile_chunk_size_ = 1 << 30;
+            constexpr static std::size_t splice_chunk_size_ = 65536;
+            constexpr static std::size_t coalesce_limit_ = 1024;
+            // consumed from head_ and only cleared once empty, so a queue
+            // that keeps draining keeps its storage
+            std::vector<Segment> segments_;
+            std::size_t head_ = 0;
+            std::size_t pending_ = 0;
+            std::size_t gathered_ = 0;
+
+        private:
+            FlushStatus flushFile(int fd, Segment &segment);
+            FlushStatus spliceFile(int fd, Segment &segment);
+            void consume(std::size_t bytes);
+            void push(Segment segment);
+            void popFront();
+    };
+}
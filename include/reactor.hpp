@@ -0,0 +1,241 @@
+#pragma once
+
+#include <unordered_map>
+#include <string_view>
+#include <functional>
+#include <expected>
+#include <cstdint>
+#include <utility>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <sys/epoll.h>
+
+#include "http_parser.hpp"
+#include "access_log.hpp"
+#include "arena.hpp"
+#include "thread_pool.hpp"
+#include "connection_slab.hpp"
+#include "connection.hpp"
+#include "compression.hpp"
+#include "timer_wheel.hpp"
+#include "mpsc_queue.hpp"
+#include "websocket.hpp"
+#include "output.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
+#include "async.hpp"
+#include "uring.hpp"
+
+namespace http {
+    // IoUring falls back to Epoll when the kernel cannot provide it.
+    enum class Backend {
+        Epoll,
+        IoUring,
+    };
+
+    // Timeouts are in seconds; zero or less turns one off.
+    struct ReactorConfig {
+        int keep_alive_timeout = 5;
+        int header_timeout = 10;
+        int body_timeout = 30;
+        int write_timeout = 30;
+        int max_keep_alive_requests = 100;
+        std::size_t max_header_size = 16384;
+        std::size_t max_message_size = 1 << 20;
+        std::size_t max_body_size = 1 << 20;
+        CompressionConfig compression;
+        AccessLog *access_log = nullptr;
+        ThreadPool *pool = nullptr;
+        Backend backend = Backend::Epoll;
+    };
+
+    class Reactor {
+        public:
+            // A handler may return a job instead of writing the response;
+            // with a pool configured it runs there and the response is
+            // queued back to this reactor. A coroutine runs on this
+            // reactor and suspends on its timers and descriptors. A
+            // handler that needs the whole body and does not have it yet
+            // is called again once it has arrived.
+            using Job = std::function<void(
+                OutputQueue &out,
+                ResponseInfo &info,
+                bool &keep_alive
+            )>;
+
+            struct Deferred {
+                Job job;
+                AsyncHandler coroutine;
+                std::shared_ptr<const Request> request;
+                bool needs_body = false;
+                bool compress = false;
+            };
+
+            using RequestHandler = std::function<Deferred(
+                const RequestHead &head,
+                bool &keep_alive,
+                OutputQueue &out,
+                ResponseInfo &info,
+                Arena &arena
+            )>;
+            using UpgradeHandler = std::function<const WebSocketHandler *(
+                const RequestHead &head
+            )>;
+
+            Reactor(
+                Logger &log,
+                ReactorConfig config,
+                RequestHandler on_request,
+                UpgradeHandler on_upgrade
+            );
+            Reactor(const Reactor&) = delete;
+            Reactor& operator=(const Reactor&) = delete;
+            ~Reactor();
+            std::expected<void, std::string> open(int server_socket);
+            std::expected<void, std::string> watch(
+                int fd,
+                std::function<void()> on_readable
+            );
+            std::expected<void, std::string> run();
+            void broadcast(
+                const WebSocketHandler *target,
+                std::shared_ptr<const std::string> frame
+            );
+            bool wait(
+                Context &context,
+                WaitKind kind,
+                int fd,
+                std::chrono::steady_clock::time_point deadline
+            );
+            void cancel(Context &context);
+            WaitKind send(Context &context, std::string data, bool chunk);
+            std::size_t connectionCount() const;
+            PoolStats connectionSlots() const;
+
+        private:
+            struct Completion {
+                Completion *next = nullptr;
+                int fd = -1;
+                std::uint64_t connection_id = 0;
+                bool keep_alive = false;
+                AccessMethod method = AccessMethod::Other;
+                std::chrono::steady_clock::time_point start;
+                OutputQueue out;
+                ResponseInfo info;
+            };
+
+            struct Wake {
+                int fd;
+                std::uint64_t connection_id;
+                std::uint64_t wait_id;
+            };
+
+            Logger &log_;
+            ReactorConfig config_;
+            RequestHandler on_request_;
+            UpgradeHandler on_upgrade_;
+            int server_socket_;
+            int epoll_fd_;
+            int wake_fd_;
+            constexpr static int max_events_ = 1024;
+            constexpr static int buffer_size_ = 4096;
+            constexpr static std::size_t min_read_room_ = 512;
+            constexpr static std::size_t max_pending_output_ = 1 << 20;
+            constexpr static std::size_t stream_watermark_ = 1 << 16;
+            constexpr static std::size_t body_window_ = 1 << 16;
+            constexpr static unsigned ring_entries_ = 1024;
+            constexpr static unsigned ring_buffers_ = 1024;
+            constexpr static std::uint16_t buffer_group_ = 0;
+            constexpr static int max_send_iovecs_ = 64;
+            epoll_event events_[max_events_];
+            std::unique_ptr<Uring> uring_;
+            io_uring_cqe cqes_[max_events_];
+            TimerWheel timers_;
+            ConnectionSlab connections_;
+            std::unordered_map<int, std::function<void()>> watchers_;
+            RequestHead head_;
+            Arena arena_;
+            std::chrono::steady_clock::time_point epoch_;
+            std::chrono::steady_clock::time_point now_;
+            std::vector<std::pair<
+                const WebSocketHandler *,
+                std::shared_ptr<const std::string>
+            >> broadcasts_;
+            std::mutex broadcast_mutex_;
+            MpscQueue<Completion> completions_;
+            std::uint64_t next_connection_id_;
+            std::unordered_map<int, Wake> fd_waiters_;
+            std::vector<Wake> ready_;
+            std::vector<Wake> woken_;
+            std::vector<std::pair<int, std::uint64_t>> unread_;
+
+        private:
+            std::expected<void, std::string> openUring();
+            std::expected<void, std::string> runUring();
+            void acceptConnections();
+            Connection &addConnection(int fd);
+            void handleReadable(Connection &conn);
+            void handleWritable(Connection &conn);
+            void processRequests(Connection &conn);
+            ParseStatus collectBody(Connection &conn);
+            void feedBody(Connection &conn);
+            bool abandonBody(Connection &conn);
+            void reject(Connection &conn, ParseStatus status, AccessMethod method);
+            void reject(
+                Connection &conn,
+                std::string_view response,
+                std::uint16_t status,
+                AccessMethod method
+            );
+            void upgradeConnection(Connection &conn, const WebSocketHandler &handler);
+            void processFrames(Connection &conn);
+            void startAsync(
+                Connection &conn,
+                Deferred &deferred,
+                bool keep_alive,
+                const ResponseInfo &info,
+                std::chrono::steady_clock::time_point start
+            );
+            void resumeAsync(Connection &conn, bool result);
+            void completeAsync(Connection &conn);
+            void wakeWaiter(const Wake &wake, bool result);
+            void runTimers();
+            void setTimeout(Connection &conn, Timeout timeout);
+            void timeOut(Connection &conn);
+            std::uint64_t tick(std::chrono::steady_clock::time_point time) const;
+            void runReady();
+            void runUnread();
+            int nextTimeout() const;
+            void dispatch(
+                Connection &conn,
+                Job job,
+                bool keep_alive,
+                std::chrono::steady_clock::time_point start
+            );
+            void recordAccess(
+                int fd,
+                AccessMethod method,
+                const ResponseInfo &info,
+                std::size_t bytes,
+                std::chrono::steady_clock::time_point start
+            );
+            void handleWake();
+            void drainBroadcasts();
+            void drainCompletions();
+            void closeConnection(int fd);
+            int setNonBlocking(int socket);
+            void handleCompletion(const io_uring_cqe &cqe);
+            void handleReceived(const io_uring_cqe &cqe);
+            FlushStatus submitSend(Connection &conn);
+            void submitClose(Connection &conn);
+            void armAccept();
+            void armReceive(Connection &conn);
+            void armPoll(int fd, std::uint32_t events, std::uint64_t user_data);
+            void cancelRequest(std::uint64_t user_data);
+            void cancelAll(int fd);
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string_view>
+#include <expected>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace http {
+    struct RouteParam {
+        std::string_view name;
+        std::string_view value;
+    };
+
+    struct RouteParams {
+        constexpr static std::size_t max_params = 8;
+
+        RouteParam params[max_params];
+        std::size_t count = 0;
+
+        std::string_view get(std::string_view name) const;
+    };
+
+    class Router {
+        public:
+            constexpr static std::size_t npos = static_cast<std::size_t>(-1);
+            constexpr static std::size_t max_methods = 8;
+
+            Router();
+            Router(const Router&) = delete;
+            Router& operator=(const Router&) = delete;
+            ~Router();
+            std::expected<void, std::string> add(
+                std::size_t method,
+                std::string_view pattern,
+                std::size_t id
+            );
+            std::size_t match(
+                std::size_t method,
+                std::string_view path,
+                RouteParams &params
+            ) const;
+
+        private:
+            struct Node {
+                std::string prefix;
+                std::string indices;
+                std::vector<std::unique_ptr<Node>> children;
+                std::unique_ptr<Node> param_child;
+                std::string param_name;
+                std::unique_ptr<Node> wildcard_child;
+                std::string wildcard_name;
+                std::size_t handlers[max_methods];
+
+                Node();
+            };
+
+            std::unique_ptr<Node> root_;
+
+        private:
+            bool matchNode(
+                const Node *node,
+                std::string_view path,
+                std::size_t method,
+                RouteParams &params,
+                std::size_t &id
+            ) const;
+    };
+}
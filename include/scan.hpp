@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+namespace http::scan {
+    constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    enum class Isa {
+        Scalar,
+        Sse42,
+        Avx2,
+    };
+
+    struct Kernels {
+        Isa isa;
+        // Offset of the first "\r\n\r\n", or npos.
+        std::size_t (*findHeaderEnd)(const char *data, std::size_t size);
+        // Offset of the first byte equal to c, or npos.
+        std::size_t (*findChar)(const char *data, std::size_t size, char c);
+        // Offset of the first byte that is not an RFC 9110 tchar, or size.
+        std::size_t (*findNonToken)(const char *data, std::size_t size);
+        // Offset of the first control byte other than HTAB, or size.
+        std::size_t (*findControl)(const char *data, std::size_t size);
+    };
+
+    const Kernels &kernels();
+    const Kernels &kernelsFor(Isa isa);
+    bool supported(Isa isa);
+    const char *isaName(Isa isa);
+
+    inline std::size_t findHeaderEnd(const char *data, std::size_t size) {
+        return kernels().findHeaderEnd(data, size);
+    }
+
+    inline std::size_t findChar(const char *data, std::size_t size, char c) {
+        return kernels().findChar(data, size, c);
+    }
+
+    inline std::size_t findNonToken(const char *data, std::size_t size) {
+        return kernels().findNonToken(data, size);
+    }
+
+    inline std::size_t findControl(const char *data, std::size_t size) {
+        return kernels().findControl(data, size);
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <unordered_map>
+#include <shared_mutex>
+#include <string_view>
+#include <filesystem>
+#include <array>
+#include <functional>
+#include <expected>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <list>
+
+#include "http_parser.hpp"
+#include "compression.hpp"
+#include "thread_pool.hpp"
+#include "output.hpp"
+#include "logger.hpp"
+
+namespace http {
+    struct StaticFilesConfig {
+        std::size_t cache_budget = 64 * 1024 * 1024;
+        std::size_t max_cached_file_size = 4 * 1024 * 1024;
+        bool compress = true;
+    };
+
+    class StaticFiles {
+        public:
+            StaticFiles(Logger &log);
+            StaticFiles(const StaticFiles&) = delete;
+            StaticFiles& operator=(const StaticFiles&) = delete;
+            ~StaticFiles();
+            std::expected<void, std::string> load(
+                const std::string &directory,
+                StaticFilesConfig config
+            );
+            int serve(
+                std::string_view path,
+                const RequestHead &head,
+                std::string_view connection,
+                OutputQueue &out
+            );
+            bool empty() const;
+            std::expected<void, std::string> watch();
+            int watchFd() const;
+            std::size_t handleWatchEvents(ThreadPool *pool);
+
+        private:
+            // One encoding of a file. An encoded one comes from a .gz or
+            // .br sibling on disk when there is one, and is otherwise
+            // compressed when the file is cached and kept if it is smaller:
+            // at the best level when the directory is loaded, at the fast
+            // level when a request brings it back after an eviction or a
+            // change on disk brings it in, until the pool has recompressed
+            // it at the best level.
+            struct Variant {
+                std::filesystem::path file;
+                std::size_t size = 0;
+                std::string etag;
+                std::shared_ptr<const std::string> header;
+                std::shared_ptr<const std::string> not_modified;
+                std::shared_ptr<const std::string> body;
+            };
+
+            // Hits only set referenced, under the shared lock; eviction
+            // gives an entry set since it last came round another pass.
+            struct Entry {
+                std::array<Variant, 3> variants;
+                std::string content_type;
+                std::string last_modified;
+                bool compressible = false;
+                bool retired = false;
+                std::size_t cached = 0;
+                std::list<Entry *>::iterator lru;
+                std::atomic<bool> referenced = false;
+                std::atomic<bool> warming = false;
+            };
+
+            using Bodies = std::array<std::shared_ptr<const std::string>, 3>;
+
+            struct PathHash {
+                using is_transparent = void;
+                std::size_t operator()(std::string_view path) const {
+                    return std::hash<std::string_view>{}(path);
+                }
+            };
+
+            Logger &log_;
+            StaticFilesConfig config_;
+            std::filesystem::path root_;
+            std::unordered_map<
+                std::string,
+                std::shared_ptr<Entry>,
+                PathHash,
+                std::equal_to<>
+            > entries_;
+            std::list<Entry *> lru_;
+            std::size_t cached_bytes_;
+            int inotify_fd_;
+            std::unordered_map<int, std::filesystem::path> watch_dirs_;
+            std::vector<std::shared_ptr<Entry>> recompress_;
+            // guards entries_, lru_ and what is cached; file reads and
+            // compression happen outside it, and watch_dirs_ and
+            // recompress_ are only used by the loop handling the watch
+            // events
+            std::shared_mutex mutex_;
+
+        private:
+            bool addFile(const std::filesystem::path &file, CompressionLevel level);
+            void refreshOriginal(const std::filesystem::path &file, CompressionLevel level);
+            void recompress(const std::shared_ptr<Entry> &entry);
+            std::size_t removeFile(const std::filesystem::path &file);
+            std::size_t removeDirectory(const std::filesystem::path &dir);
+            std::size_t addWatch(const std::filesystem::path &dir);
+            std::string urlFor(const std::filesystem::path &file) const;
+            void describe(Entry &entry, Encoding encoding, CompressionLevel level);
+            bool offers(const Entry &entry, Encoding encoding) const;
+            bool cacheable(const Entry &entry) const;
+            Bodies readBodies(const Entry &entry, CompressionLevel level);
+            void cacheBodies(Entry &entry, Bodies bodies, CompressionLevel level);
+            void dropBody(Entry &entry);
+            void retire(Entry &entry);
+            bool readFile(const std::filesystem::path &file, std::string &data);
+            void evict(std::size_t incoming);
+    };
+}
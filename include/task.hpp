@@ -0,0 +1,155 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace http {
+    template <typename T>
+    class Task;
+
+    namespace detail {
+        // Lazily started; when a task finishes it transfers straight to
+        // whoever awaited it, so chains of awaits never grow the stack.
+        struct TaskPromiseBase {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+
+            struct FinalAwaiter {
+                bool await_ready() const noexcept {
+                    return false;
+                }
+
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(
+                    std::coroutine_handle<Promise> handle
+                ) noexcept {
+                    std::coroutine_handle<> next = handle.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() const noexcept {
+                return {};
+            }
+
+            // kept for whoever takes the result, so it reaches the awaiter
+            void unhandled_exception() noexcept {
+                exception = std::current_exception();
+            }
+
+            void rethrow() const {
+                if (exception) {
+                    std::rethrow_exception(exception);
+                }
+            }
+        };
+
+        template <typename T>
+        struct TaskPromise : TaskPromiseBase {
+            std::optional<T> value;
+
+            Task<T> get_return_object();
+
+            void return_value(T result) {
+                value = std::move(result);
+            }
+
+            T take() {
+                rethrow();
+                return std::move(*value);
+            }
+        };
+
+        template <>
+        struct TaskPromise<void> : TaskPromiseBase {
+            Task<void> get_return_object();
+
+            void return_void() const noexcept {}
+
+            void take() const {
+                rethrow();
+            }
+        };
+    }
+
+    template <typename T = void>
+    class Task {
+        public:
+            using promise_type = detail::TaskPromise<T>;
+            using Handle = std::coroutine_handle<promise_type>;
+
+            explicit Task(Handle handle) : handle_(handle) {}
+
+            Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+
+            Task &operator=(Task &&other) noexcept {
+                if (this != &other) {
+                    if (handle_) {
+                        handle_.destroy();
+                    }
+
+                    handle_ = std::exchange(other.handle_, {});
+                }
+
+                return *this;
+            }
+
+            Task(const Task&) = delete;
+            Task& operator=(const Task&) = delete;
+
+            ~Task() {
+                if (handle_) {
+                    handle_.destroy();
+                }
+            }
+
+            bool await_ready() const noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<> continuation
+            ) noexcept {
+                handle_.promise().continuation = continuation;
+                return handle_;
+            }
+
+            T await_resume() {
+                return handle_.promise().take();
+            }
+
+            std::coroutine_handle<> handle() const {
+                return handle_;
+            }
+
+            bool done() const {
+                return handle_.done();
+            }
+
+            T result() {
+                return handle_.promise().take();
+            }
+
+        private:
+            Handle handle_;
+    };
+
+    namespace detail {
+        template <typename T>
+        Task<T> TaskPromise<T>::get_return_object() {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace http {
+    class ThreadPool {
+        public:
+            using Task = std::function<void()>;
+
+            explicit ThreadPool(std::size_t threads);
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+            ~ThreadPool();
+            void submit(Task task);
+            std::size_t size() const;
+
+        private:
+            // Tasks a worker submits itself go on its local deque and are
+            // popped from the back; tasks from outside the pool queue up in
+            // injected and run oldest first, so a steady stream of new
+            // requests cannot starve the earlier ones. A worker that runs
+            // dry steals from the front of the others.
+            struct Worker {
+                std::mutex mutex;
+                std::deque<Task> local;
+                std::deque<Task> injected;
+            };
+
+            std::vector<std::unique_ptr<Worker>> workers_;
+            std::vector<std::thread> threads_;
+            std::atomic<std::size_t> next_worker_;
+            std::atomic<std::size_t> queued_;
+            std::atomic<std::size_t> sleepers_;
+            bool running_;
+            std::mutex sleep_mutex_;
+            std::condition_variable wake_;
+
+        private:
+            bool pop(std::size_t index, Task &task);
+            bool steal(std::size_t index, Task &task);
+            void run(std::size_t index);
+    };
+}
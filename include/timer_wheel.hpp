@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+namespace http {
+    class TimerWheel;
+
+    // A timer its owner embeds in itself, so arming and cancelling never
+    // allocate. Copies start out disarmed, and a timer unlinks itself when
+    // it is cancelled, assigned to or destroyed.
+    class Timer {
+        public:
+            Timer() = default;
+            Timer(const Timer &other);
+            Timer &operator=(const Timer &other);
+            ~Timer();
+            bool armed() const;
+            void cancel();
+            int fd() const;
+
+        private:
+            friend class TimerWheel;
+
+            Timer *prev_ = nullptr;
+            Timer *next_ = nullptr;
+            std::uint64_t expires_ = 0;
+            int fd_ = -1;
+    };
+
+    // A hierarchical timing wheel with millisecond ticks: four levels of
+    // 64 slots, each level spanning 64 times the one below. A timer goes
+    // in the level whose span covers its delay and drops a level each
+    // time its slot comes round, so arming, cancelling and expiring are
+    // all O(1). Delays past the top level, about 4.6 hours, are clamped.
+    class TimerWheel {
+        public:
+            TimerWheel();
+            TimerWheel(const TimerWheel&) = delete;
+            TimerWheel& operator=(const TimerWheel&) = delete;
+            ~TimerWheel();
+            void arm(Timer &timer, std::uint64_t expires, int fd);
+            Timer *expire(std::uint64_t now);
+            std::uint64_t next() const;
+
+        private:
+            constexpr static unsigned level_bits_ = 6;
+            constexpr static unsigned levels_ = 4;
+            constexpr static std::uint64_t slots_ = 1 << level_bits_;
+            constexpr static std::uint64_t mask_ = slots_ - 1;
+            Timer heads_[levels_][slots_];
+            std::uint64_t occupied_[levels_];
+            std::uint64_t current_;
+
+        private:
+            void place(Timer &timer);
+            void cascade(unsigned level);
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <linux/io_uring.h>
+
+namespace http {
+    // A minimal io_uring: the submission and completion rings mapped from
+    // the kernel plus one group of provided buffers for receives, kept in a
+    // buffer ring where the kernel honours it. Submissions are collected in
+    // the ring and handed over in one io_uring_enter per loop turn. sqe()
+    // returns nullptr only when the kernel will take no more submissions.
+    class Uring {
+        public:
+            Uring();
+            Uring(const Uring&) = delete;
+            Uring& operator=(const Uring&) = delete;
+            ~Uring();
+            std::expected<void, std::string> open(unsigned entries);
+            std::expected<void, std::string> provideBuffers(
+                unsigned count,
+                unsigned size,
+                std::uint16_t group
+            );
+            io_uring_sqe *sqe();
+            int submitAndWait(int timeout_ms);
+            unsigned completions(io_uring_cqe *out, unsigned max);
+            char *buffer(std::uint16_t id) const;
+            void recycle(std::uint16_t id);
+
+        private:
+            int ring_fd_;
+            void *sq_ring_;
+            void *cq_ring_;
+            std::size_t sq_ring_size_;
+            std::size_t cq_ring_size_;
+            io_uring_sqe *sqes_;
+            std::size_t sqes_size_;
+            unsigned *sq_head_;
+            unsigned *sq_tail_;
+            unsigned *sq_flags_;
+            unsigned sq_mask_;
+            unsigned sq_entries_;
+            unsigned *cq_head_;
+            unsigned *cq_tail_;
+            unsigned cq_mask_;
+            io_uring_cqe *cqes_;
+            unsigned local_tail_;
+            unsigned to_submit_;
+            io_uring_buf_ring *buf_ring_;
+            std::size_t buf_ring_size_;
+            char *buffers_;
+            std::size_t buffers_size_;
+            unsigned buf_count_;
+            unsigned buf_size_;
+            std::uint16_t buf_tail_;
+            std::uint16_t buf_group_;
+            bool legacy_buffers_;
+            std::vector<std::uint16_t> returned_;
+            std::vector<io_uring_cqe> reaped_;
+
+        private:
+            std::expected<void, std::string> checkSupport();
+            bool bufferRingWorks();
+            void provideReturned();
+            int enter(unsigned to_submit, unsigned min_complete, int timeout_ms);
+            bool flush();
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string_view>
+#include <functional>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "http_parser.hpp"
+#include "output.hpp"
+
+namespace http {
+    enum class Opcode : std::uint8_t {
+        Continuation = 0x0,
+        Text = 0x1,
+        Binary = 0x2,
+        Close = 0x8,
+        Ping = 0x9,
+        Pong = 0xA,
+    };
+
+    enum class CloseCode : std::uint16_t {
+        Normal = 1000,
+        GoingAway = 1001,
+        ProtocolError = 1002,
+        UnsupportedData = 1003,
+        NoStatus = 1005,
+        Abnormal = 1006,
+        InvalidPayload = 1007,
+        PolicyViolation = 1008,
+        TooBig = 1009,
+        InternalError = 1011,
+    };
+
+    struct Frame {
+        bool fin = false;
+        Opcode opcode = Opcode::Continuation;
+        std::string_view payload;
+        std::size_t length = 0;
+        CloseCode error = CloseCode::ProtocolError;
+    };
+
+    class WebSocket;
+
+    struct WebSocketHandler {
+        std::function<void(WebSocket &socket)> on_open;
+        std::function<void(
+            WebSocket &socket,
+            std::string_view message,
+            bool binary
+        )> on_message;
+        std::function<void(WebSocket &socket, CloseCode code)> on_close;
+    };
+
+    class WebSocket {
+        public:
+            WebSocket(
+                const WebSocketHandler &handler,
+                OutputQueue &out,
+                std::size_t max_pending,
+                std::size_t max_message_size
+            );
+            WebSocket(const WebSocket&) = delete;
+            WebSocket& operator=(const WebSocket&) = delete;
+            bool send(std::string_view text);
+            bool sendBinary(std::string_view data);
+            bool sendFrame(std::shared_ptr<const std::string> frame);
+            void close(CloseCode code, std::string_view reason = {});
+            std::size_t buffered() const;
+            bool closing() const;
+            const WebSocketHandler &handler() const;
+            void open();
+            std::size_t receive(char *data, std::size_t size);
+            void finish();
+
+        private:
+            const WebSocketHandler &handler_;
+            OutputQueue &out_;
+            std::size_t max_pending_;
+            std::size_t max_message_size_;
+            std::string message_;
+            Opcode message_opcode_;
+            CloseCode close_code_;
+            bool close_sent_;
+            bool close_received_;
+            bool finished_;
+
+        private:
+            bool handleFrame(const Frame &frame);
+            bool handleClose(std::string_view payload);
+            void deliver(std::string_view message, Opcode opcode);
+            void fail(CloseCode code);
+    };
+
+    bool isWebSocketUpgrade(const RequestHead &head);
+    std::expected<std::string, std::string> acceptHandshake(const RequestHead &head);
+    std::string acceptKey(std::string_view key);
+    ParseStatus parseFrame(
+        char *data,
+        std::size_t size,
+        std::size_t max_payload,
+        Frame &frame
+    );
+    std::string encodeFrame(Opcode opcode, std::string_view payload);
+    void unmask(char *data, std::size_t size, const unsigned char key[4]);
+    bool validUtf8(std::string_view text);
+}
@@ -0,0 +1,285 @@
+#include <string_view>
+#include <filesystem>
+#include <algorithm>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <cerrno>
+#include <format>
+#include <string>
+#include <thread>
+#include <mutex>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "access_log.hpp"
+
+using std::string_view;
+using std::uint64_t;
+using std::expected;
+using std::size_t;
+using std::string;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    AccessLog::AccessLog() {
+        records_per_file_ = 0;
+        max_files_ = 0;
+        file_number_ = 0;
+        next_ = 0;
+        current_ = nullptr;
+        segment_index_ = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    AccessLog::~AccessLog() {
+        current_.store(nullptr, std::memory_order_release);
+
+        for (Segment &segment : segments_) {
+            unmapSegment(segment);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> AccessLog::open(
+        const string &directory,
+        size_t records_per_file,
+        int max_files
+    ) {
+        std::lock_guard lock(rotate_mutex_);
+
+        if (current_.load(std::memory_order_relaxed)) {
+            return std::unexpected("access log is already open");
+        }
+
+        if (records_per_file == 0 || max_files < 1) {
+            return std::unexpected("access log needs at least one record and one file");
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            return std::unexpected(std::format(
+                "failed to create {}: {}", directory, error.message()
+            ));
+        }
+
+        directory_ = directory;
+        records_per_file_ = records_per_file;
+        max_files_ = max_files;
+
+        // continue numbering after whatever a previous run left behind
+        for (const auto &entry : std::filesystem::directory_iterator(directory_, error)) {
+            string name = entry.path().filename().string();
+            if (name.starts_with("access-") && name.ends_with(".bin")) {
+                uint64_t number = std::strtoull(name.c_str() + 7, nullptr, 10);
+                file_number_ = std::max(file_number_, number + 1);
+            }
+        }
+
+        Segment &segment = segments_[segment_index_];
+        if (!mapSegment(segment, 0)) {
+            return std::unexpected(std::format(
+                "failed to map {}: {}", fileFor(file_number_).string(), std::strerror(errno)
+            ));
+        }
+
+        current_.store(&segment, std::memory_order_release);
+        return {};
+    }
+
+    bool AccessLog::enabled() const {
+        return current_.load(std::memory_order_relaxed) != nullptr;
+    }
+
+    void AccessLog::record(const AccessRecord &record) {
+        uint64_t sequence = next_.fetch_add(1, std::memory_order_relaxed);
+        if (!current_.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        Segment *segment = pin(sequence);
+        if (!segment) {
+            segment = segmentFor(sequence);
+            if (!segment) {
+                return;
+            }
+        }
+
+        AccessRecord &slot = segment->records[sequence - segment->base];
+        slot.latency_ns = record.latency_ns;
+        slot.bytes = record.bytes;
+        slot.route_id = record.route_id;
+        slot.fd = record.fd;
+        slot.status = record.status;
+        slot.method = record.method;
+        std::atomic_ref(slot.timestamp_ns).store(
+            record.timestamp_ns, std::memory_order_release
+        );
+
+        segment->writers.fetch_sub(1, std::memory_order_release);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    AccessLog::Segment *AccessLog::pin(uint64_t sequence) {
+        Segment *current = current_.load(std::memory_order_acquire);
+        if (!current) {
+            return nullptr;
+        }
+
+        // newest first, since nearly every slot is in the current file
+        int index = static_cast<int>(current - segments_);
+        for (int i = 0; i < mapped_segments_; ++i) {
+            Segment &segment = segments_[(index - i + mapped_segments_) % mapped_segments_];
+            segment.writers.fetch_add(1, std::memory_order_seq_cst);
+            if (segment.live.load(std::memory_order_seq_cst)
+                && sequence - segment.base < segment.capacity) {
+                return &segment;
+            }
+            segment.writers.fetch_sub(1, std::memory_order_release);
+        }
+
+        return nullptr;
+    }
+
+    AccessLog::Segment *AccessLog::segmentFor(uint64_t sequence) {
+        std::lock_guard lock(rotate_mutex_);
+
+        while (true) {
+            if (Segment *segment = pin(sequence)) {
+                return segment;
+            }
+
+            // a slot older than every mapped file is dropped rather than
+            // keeping an unbounded number of files mapped
+            Segment *current = current_.load(std::memory_order_relaxed);
+            if (!current || sequence < current->base || !rotate()) {
+                return nullptr;
+            }
+        }
+    }
+
+    bool AccessLog::rotate() {
+        Segment *current = current_.load(std::memory_order_relaxed);
+        uint64_t base = current->base + current->capacity;
+
+        int index = (segment_index_ + 1) % mapped_segments_;
+        Segment &segment = segments_[index];
+        unmapSegment(segment);
+
+        file_number_++;
+        if (!mapSegment(segment, base)) {
+            return false;
+        }
+
+        segment_index_ = index;
+        current_.store(&segment, std::memory_order_release);
+
+        if (file_number_ >= static_cast<uint64_t>(max_files_)) {
+            std::error_code error;
+            std::filesystem::remove(fileFor(file_number_ - max_files_), error);
+        }
+
+        return true;
+    }
+
+    bool AccessLog::mapSegment(Segment &segment, uint64_t base) {
+        string path = fileFor(file_number_).string();
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+
+        size_t size = sizeof(AccessLogHeader) + records_per_file_ * sizeof(AccessRecord);
+        if (ftruncate(fd, size) < 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+
+        AccessLogHeader *header = static_cast<AccessLogHeader *>(map);
+        std::memcpy(header->magic, access_log_magic.data(), sizeof(header->magic));
+        header->version = 1;
+        header->record_size = sizeof(AccessRecord);
+        header->capacity = records_per_file_;
+        header->first_sequence = base;
+
+        segment.map = map;
+        segment.map_size = size;
+        segment.records = reinterpret_cast<AccessRecord *>(header + 1);
+        segment.base = base;
+        segment.capacity = records_per_file_;
+        segment.live.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void AccessLog::unmapSegment(Segment &segment) {
+        // a writer that pinned the segment before live went clear is
+        // still storing into it
+        segment.live.store(false, std::memory_order_seq_cst);
+        while (segment.writers.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+
+        if (segment.map) {
+            munmap(segment.map, segment.map_size);
+        }
+
+        segment.map = nullptr;
+        segment.map_size = 0;
+        segment.records = nullptr;
+        segment.base = 0;
+        segment.capacity = 0;
+    }
+
+    std::filesystem::path AccessLog::fileFor(uint64_t number) const {
+        return directory_ / std::format("access-{:06}.bin", number);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    AccessMethod accessMethod(string_view method) {
+        if (method == "GET") return AccessMethod::Get;
+        if (method == "POST") return AccessMethod::Post;
+        if (method == "PUT") return AccessMethod::Put;
+        if (method == "DELETE") return AccessMethod::Delete;
+        if (method == "HEAD") return AccessMethod::Head;
+        if (method == "OPTIONS") return AccessMethod::Options;
+        if (method == "PATCH") return AccessMethod::Patch;
+        return AccessMethod::Other;
+    }
+
+    string_view accessMethodName(AccessMethod method) {
+        switch (method) {
+            case AccessMethod::Get: return "GET";
+            case AccessMethod::Post: return "POST";
+            case AccessMethod::Put: return "PUT";
+            case AccessMethod::Delete: return "DELETE";
+            case AccessMethod::Head: return "HEAD";
+            case AccessMethod::Options: return "OPTIONS";
+            case AccessMethod::Patch: return "PATCH";
+            case AccessMethod::Other: return "OTHER";
+        }
+
+        return "OTHER";
+    }
+}
@@ -0,0 +1,68 @@
+#include <memory_resource>
+#include <string_view>
+
+#include "http_parser.hpp"
+#include "router.hpp"
+#include "arena.hpp"
+
+using std::string_view;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // arena
+    ///////////////////////////////////////////////////////////////////////////
+    Arena::Arena()
+        : upstream_(std::pmr::pool_options {0, largest_block_}),
+          resource_(inline_, inline_size_, &upstream_) {
+    }
+
+    std::pmr::memory_resource *Arena::resource() {
+        return &resource_;
+    }
+
+    void Arena::reset() {
+        resource_.release();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // request view
+    ///////////////////////////////////////////////////////////////////////////
+    RequestView::RequestView(
+        const RequestHead &head,
+        string_view path,
+        const RouteParams &params,
+        Arena &arena
+    ) : head_(head),
+        path_(path),
+        params_(params),
+        arena_(arena) {
+    }
+
+    string_view RequestView::method() const {
+        return head_.method;
+    }
+
+    string_view RequestView::target() const {
+        return head_.target;
+    }
+
+    string_view RequestView::path() const {
+        return path_;
+    }
+
+    string_view RequestView::param(string_view name) const {
+        return params_.get(name);
+    }
+
+    string_view RequestView::header(string_view name) const {
+        return head_.header(name);
+    }
+
+    string_view RequestView::body() const {
+        return head_.body;
+    }
+
+    std::pmr::memory_resource *RequestView::resource() const {
+        return arena_.resource();
+    }
+}
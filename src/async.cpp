@@ -0,0 +1,333 @@
+#include <string_view>
+#include <filesystem>
+#include <coroutine>
+#include <expected>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <string>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "http_parser.hpp"
+#include "reactor.hpp"
+#include "headers.hpp"
+#include "output.hpp"
+#include "async.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::shared_ptr;
+using std::unexpected;
+using std::expected;
+using std::uint16_t;
+using std::uint64_t;
+using std::size_t;
+using std::string;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // request
+    ///////////////////////////////////////////////////////////////////////////
+    string_view Request::header(string_view name) const {
+        for (const auto &[key, value] : headers) {
+            if (equalsIgnoreCase(key, name)) {
+                return value;
+            }
+        }
+
+        return {};
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // wait
+    ///////////////////////////////////////////////////////////////////////////
+    Wait::Wait(Context &context, WaitKind kind) : context_(context) {
+        kind_ = kind;
+        fd_ = -1;
+    }
+
+    Wait::Wait(Context &context, WaitKind kind, int fd) : context_(context) {
+        kind_ = kind;
+        fd_ = fd;
+    }
+
+    Wait::Wait(
+        Context &context,
+        std::chrono::steady_clock::time_point deadline
+    ) : context_(context) {
+        kind_ = WaitKind::Timer;
+        fd_ = -1;
+        deadline_ = deadline;
+    }
+
+    bool Wait::await_ready() const noexcept {
+        if (kind_ == WaitKind::Done || kind_ == WaitKind::Failed) {
+            context_.wait_result_ = kind_ == WaitKind::Done;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Wait::await_suspend(std::coroutine_handle<> handle) {
+        return context_.suspend(handle, kind_, fd_, deadline_);
+    }
+
+    bool Wait::await_resume() const noexcept {
+        return context_.wait_result_;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // context
+    ///////////////////////////////////////////////////////////////////////////
+    Context::Context(
+        Reactor &reactor,
+        int fd,
+        uint64_t connection_id,
+        bool keep_alive,
+        shared_ptr<const Request> request
+    ) : reactor_(reactor),
+        request_(std::move(request)) {
+        fd_ = fd;
+        connection_id_ = connection_id;
+        keep_alive_ = keep_alive;
+        wait_id_ = 0;
+        wait_fd_ = -1;
+        wait_result_ = true;
+        draining_ = false;
+        streaming_ = false;
+        chunked_ = false;
+        bodiless_ = false;
+        status_ = 0;
+        streamed_ = 0;
+        content_length_ = 0;
+        sent_ = 0;
+    }
+
+    Context::~Context() {
+        reactor_.cancel(*this);
+    }
+
+    const Request &Context::request() const {
+        return *request_;
+    }
+
+    Wait Context::sleep(std::chrono::milliseconds duration) {
+        return Wait(*this, std::chrono::steady_clock::now() + duration);
+    }
+
+    Wait Context::readable(int fd) {
+        return Wait(*this, WaitKind::Readable, fd);
+    }
+
+    Wait Context::writable(int fd) {
+        return Wait(*this, WaitKind::Writable, fd);
+    }
+
+    Wait Context::yield() {
+        return Wait(*this, WaitKind::Yield);
+    }
+
+    Wait Context::readBody() {
+        body_.clear();
+        return Wait(*this, WaitKind::Body);
+    }
+
+    std::string_view Context::body() const {
+        return body_;
+    }
+
+    bool Context::stream(
+        uint16_t status,
+        string_view content_type,
+        size_t content_length
+    ) {
+        if (streaming_) {
+            return false;
+        }
+
+        streaming_ = true;
+        status_ = status;
+        content_length_ = content_length;
+        bodiless_ = !sendsBody(request_->method, status);
+
+        string head;
+        HeadWriter writer(head, status);
+        writer.contentType(content_type);
+        if (status != 204) {
+            writer.contentLength(content_length);
+        }
+        writer.connection(keep_alive_).date().end();
+        return reactor_.send(*this, std::move(head), false) != WaitKind::Failed;
+    }
+
+    bool Context::stream(uint16_t status, string_view content_type) {
+        if (streaming_) {
+            return false;
+        }
+
+        streaming_ = true;
+        status_ = status;
+        content_length_ = unknown_length_;
+        bodiless_ = !sendsBody(request_->method, status);
+
+        // HTTP/1.0 has no chunked coding, so there the close ends the body;
+        // a response that has none needs neither
+        chunked_ = !bodiless_ && request_->version != "HTTP/1.0";
+        if (!chunked_ && !bodiless_) {
+            keep_alive_ = false;
+        }
+
+        string head;
+        HeadWriter writer(head, status);
+        writer.contentType(content_type);
+        if (chunked_) {
+            writer.header("Transfer-Encoding: chunked\r\n");
+        }
+        writer.connection(keep_alive_).date().end();
+        return reactor_.send(*this, std::move(head), false) != WaitKind::Failed;
+    }
+
+    Wait Context::write(string data) {
+        if (!streaming_ || streamed_ + data.size() > content_length_) {
+            return Wait(*this, WaitKind::Failed);
+        }
+
+        // an empty chunk would end the body early, and nothing at all
+        // follows the head of a HEAD, 204 or 304 response
+        if (data.empty() || bodiless_) {
+            return Wait(*this, WaitKind::Done);
+        }
+
+        streamed_ += data.size();
+        return Wait(*this, reactor_.send(*this, std::move(data), chunked_));
+    }
+
+    Task<expected<string, string>> Context::readFile(fs::path path) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            co_return unexpected(std::format(
+                "Could not open {}: {}", path.string(), strerror(errno)
+            ));
+        }
+
+        FileHandle file(fd);
+        string data;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0) {
+            data.reserve(info.st_size);
+        }
+
+        // Regular files are always ready as far as epoll is concerned, so
+        // the loop gets a turn between chunks instead.
+        while (true) {
+            size_t offset = data.size();
+            data.resize(offset + file_chunk_size_);
+
+            ssize_t bytes = pread(fd, data.data() + offset, file_chunk_size_, offset);
+            if (bytes < 0) {
+                data.resize(offset);
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                co_return unexpected(std::format(
+                    "Could not read {}: {}", path.string(), strerror(errno)
+                ));
+            }
+
+            data.resize(offset + bytes);
+            if (bytes == 0) {
+                break;
+            }
+
+            co_await yield();
+        }
+
+        co_return data;
+    }
+
+    bool Context::suspend(
+        std::coroutine_handle<> handle,
+        WaitKind kind,
+        int fd,
+        std::chrono::steady_clock::time_point deadline
+    ) {
+        suspended_ = handle;
+        wait_id_++;
+
+        if (!reactor_.wait(*this, kind, fd, deadline)) {
+            wait_result_ = false;
+            return false;
+        }
+
+        return true;
+    }
+
+    void Context::resume(bool result) {
+        wait_result_ = result;
+        wait_fd_ = -1;
+        draining_ = false;
+        suspended_.resume();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // async request
+    ///////////////////////////////////////////////////////////////////////////
+    AsyncRequest::AsyncRequest(
+        Reactor &reactor,
+        int fd,
+        uint64_t connection_id,
+        bool keep_alive,
+        const AsyncHandler &handler,
+        shared_ptr<const Request> request
+    ) : context(reactor, fd, connection_id, keep_alive, std::move(request)),
+        task(handler(context)) {
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    shared_ptr<Request> makeRequest(
+        const RequestHead &head,
+        string_view path,
+        const RouteParams &params
+    ) {
+        auto request = std::make_shared<Request>();
+        request->method = head.method;
+        request->target = head.target;
+        request->path = path;
+        request->version = head.version;
+        request->params = params;
+
+        // the params point into the request buffer; move them onto the copy
+        for (size_t i = 0; i < params.count; i++) {
+            string_view value = params.params[i].value;
+            request->params.params[i].value = string_view(
+                request->path.data() + (value.data() - path.data()),
+                value.size()
+            );
+        }
+
+        request->headers.reserve(head.header_count);
+        for (size_t i = 0; i < head.header_count; i++) {
+            request->headers.emplace_back(head.headers[i].name, head.headers[i].value);
+        }
+
+        return request;
+    }
+
+    bool sendsBody(string_view method, uint16_t status) {
+        return method != "HEAD" && status != 204 && status != 304;
+    }
+}
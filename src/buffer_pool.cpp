@@ -0,0 +1,242 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <new>
+
+#include "buffer_pool.hpp"
+#include "metrics.hpp"
+
+using std::uint64_t;
+using std::size_t;
+
+namespace http {
+    namespace {
+        struct Registry {
+            std::mutex mutex;
+            std::vector<const BufferPool *> pools;
+            PoolStats retired;
+        };
+
+        Registry &registry() {
+            static Registry registry;
+            return registry;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    BufferPool::BufferPool() {
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+        all.pools.push_back(this);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    BufferPool::~BufferPool() {
+        for (size_t i = 0; i < class_count_; ++i) {
+            for (char *data : free_[i]) {
+                ::operator delete(data);
+            }
+        }
+
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+        std::erase(all.pools, this);
+        all.retired.hits += hits_.get();
+        all.retired.misses += misses_.get();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    BufferPool &BufferPool::local() {
+        thread_local BufferPool pool;
+        return pool;
+    }
+
+    PoolStats BufferPool::total() {
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+
+        PoolStats stats = all.retired;
+        for (const BufferPool *pool : all.pools) {
+            stats.hits += pool->hits_.get();
+            stats.misses += pool->misses_.get();
+        }
+
+        return stats;
+    }
+
+    uint64_t BufferPool::pooledBytes() {
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+
+        uint64_t bytes = 0;
+        for (const BufferPool *pool : all.pools) {
+            bytes += pool->pooled_bytes_.get();
+        }
+
+        return bytes;
+    }
+
+    char *BufferPool::acquire(size_t &capacity) {
+        int size_class = classFor(capacity);
+        if (size_class < 0) {
+            misses_.add();
+            return static_cast<char *>(::operator new(capacity));
+        }
+
+        capacity = class_sizes_[size_class];
+        std::vector<char *> &list = free_[size_class];
+        if (list.empty()) {
+            misses_.add();
+            return static_cast<char *>(::operator new(capacity));
+        }
+
+        hits_.add();
+        pooled_bytes_.sub(capacity);
+        char *data = list.back();
+        list.pop_back();
+        return data;
+    }
+
+    void BufferPool::release(char *data, size_t capacity) {
+        int size_class = classFor(capacity);
+        if (size_class < 0
+            || class_sizes_[size_class] != capacity
+            || free_[size_class].size() >= class_limits_[size_class]) {
+            ::operator delete(data);
+            return;
+        }
+
+        pooled_bytes_.add(capacity);
+        free_[size_class].push_back(data);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    int BufferPool::classFor(size_t size) {
+        for (size_t i = 0; i < class_count_; ++i) {
+            if (size <= class_sizes_[i]) {
+                return static_cast<int>(i);
+            }
+        }
+
+        return -1;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // buffer
+    ///////////////////////////////////////////////////////////////////////////
+    Buffer::Buffer(Buffer &&other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    Buffer &Buffer::operator=(Buffer &&other) noexcept {
+        if (this != &other) {
+            reset();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+        }
+
+        return *this;
+    }
+
+    Buffer::~Buffer() {
+        reset();
+    }
+
+    char *Buffer::data() {
+        return data_;
+    }
+
+    const char *Buffer::data() const {
+        return data_;
+    }
+
+    size_t Buffer::size() const {
+        return size_;
+    }
+
+    bool Buffer::empty() const {
+        return size_ == 0;
+    }
+
+    char *Buffer::tail() {
+        return data_ + size_;
+    }
+
+    size_t Buffer::room() const {
+        return capacity_ - size_;
+    }
+
+    void Buffer::reserve(size_t room) {
+        if (capacity_ - size_ >= room) {
+            return;
+        }
+
+        size_t capacity = std::max(size_ + room, capacity_ * 2);
+        char *data = BufferPool::local().acquire(capacity);
+        if (size_ > 0) {
+            std::memcpy(data, data_, size_);
+        }
+
+        if (data_) {
+            BufferPool::local().release(data_, capacity_);
+        }
+
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    void Buffer::commit(size_t bytes) {
+        size_ += bytes;
+    }
+
+    void Buffer::append(const char *data, size_t bytes) {
+        reserve(bytes);
+        std::memcpy(data_ + size_, data, bytes);
+        size_ += bytes;
+    }
+
+    void Buffer::consume(size_t bytes) {
+        if (bytes >= size_) {
+            reset();
+            return;
+        }
+
+        std::memmove(data_, data_ + bytes, size_ - bytes);
+        size_ -= bytes;
+    }
+
+    void Buffer::erase(size_t offset, size_t bytes) {
+        if (offset >= size_) {
+            return;
+        }
+
+        bytes = std::min(bytes, size_ - offset);
+        std::memmove(data_ + offset, data_ + offset + bytes, size_ - offset - bytes);
+        size_ -= bytes;
+    }
+
+    void Buffer::reset() {
+        if (data_) {
+            BufferPool::local().release(data_, capacity_);
+        }
+
+        data_ = nullptr;
+        size_ = 0;
+        capacity_ = 0;
+    }
+}
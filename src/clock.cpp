@@ -0,0 +1,144 @@
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <ctime>
+
+#include "clock.hpp"
+
+using std::string_view;
+using std::int64_t;
+using std::string;
+using std::size_t;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    Clock::Clock() {
+        next_slot_ = 0;
+        running_ = true;
+        update(std::time(nullptr));
+
+        ticker_ = std::thread([this] {
+            run();
+        });
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    Clock::~Clock() {
+        {
+            std::lock_guard lock(mutex_);
+            running_ = false;
+        }
+
+        stop_.notify_all();
+        ticker_.join();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    Clock &Clock::get() {
+        static Clock clock;
+        return clock;
+    }
+
+    string_view Clock::date() const {
+        string_view header = dateHeader();
+        return header.substr(6, header.size() - 8);
+    }
+
+    string_view Clock::dateHeader() const {
+        const Snapshot *snapshot = current_.load(std::memory_order_acquire);
+        return string_view(snapshot->date_header, snapshot->date_header_length);
+    }
+
+    string_view Clock::logTime() const {
+        const Snapshot *snapshot = current_.load(std::memory_order_acquire);
+        return string_view(snapshot->log_time, snapshot->log_time_length);
+    }
+
+    int64_t Clock::seconds() const {
+        return current_.load(std::memory_order_acquire)->seconds;
+    }
+
+    // nanoseconds since the epoch at a steady instant, e.g. a loop's now
+    int64_t Clock::wallTime(std::chrono::steady_clock::time_point at) const {
+        const Snapshot *snapshot = current_.load(std::memory_order_acquire);
+        return snapshot->wall_ns
+            + std::chrono::duration_cast<std::chrono::nanoseconds>(at - snapshot->steady).count();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void Clock::update(std::time_t now) {
+        Snapshot &snapshot = slots_[next_slot_];
+        next_slot_ = (next_slot_ + 1) % slot_count_;
+
+        std::tm utc;
+        gmtime_r(&now, &utc);
+        snapshot.date_header_length = std::strftime(
+            snapshot.date_header,
+            sizeof(snapshot.date_header),
+            "Date: %a, %d %b %Y %H:%M:%S GMT\r\n",
+            &utc
+        );
+
+        std::tm local_time;
+        localtime_r(&now, &local_time);
+        snapshot.log_time_length = std::strftime(
+            snapshot.log_time,
+            sizeof(snapshot.log_time),
+            "%m/%d/%Y %H:%M:%S",
+            &local_time
+        );
+
+        snapshot.seconds = now;
+        snapshot.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+        snapshot.steady = std::chrono::steady_clock::now();
+        current_.store(&snapshot, std::memory_order_release);
+    }
+
+    void Clock::run() {
+        std::unique_lock lock(mutex_);
+
+        while (running_) {
+            auto next_second = std::chrono::time_point_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now()
+            ) + std::chrono::seconds(1);
+
+            if (stop_.wait_until(lock, next_second, [this] { return !running_; })) {
+                break;
+            }
+
+            update(std::chrono::system_clock::to_time_t(next_second));
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    string httpDate(std::time_t time) {
+        std::tm utc;
+        gmtime_r(&time, &utc);
+
+        char buffer[64];
+        size_t length = std::strftime(
+            buffer,
+            sizeof(buffer),
+            "%a, %d %b %Y %H:%M:%S GMT",
+            &utc
+        );
+
+        return string(buffer, length);
+    }
+}
@@ -0,0 +1,320 @@
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <brotli/encode.h>
+#include <zlib.h>
+#include <time.h>
+
+#include "compression.hpp"
+#include "http_parser.hpp"
+#include "metrics.hpp"
+
+using std::string_view;
+using std::uint64_t;
+using std::string;
+using std::size_t;
+
+namespace http {
+    namespace {
+        struct Registry {
+            std::mutex mutex;
+            std::vector<const Compressor *> compressors;
+            CompressionStats retired;
+        };
+
+        Registry &registry() {
+            static Registry registry;
+            return registry;
+        }
+
+        uint64_t threadCpuNs() {
+            timespec now;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+            return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+        }
+
+        string_view trim(string_view text) {
+            size_t first = text.find_first_not_of(" \t");
+            if (first == string_view::npos) {
+                return {};
+            }
+
+            size_t last = text.find_last_not_of(" \t");
+            return text.substr(first, last - first + 1);
+        }
+
+        // the q value of one Accept-Encoding entry, 1 when it has none
+        double quality(string_view parameters) {
+            while (!parameters.empty()) {
+                size_t semicolon = parameters.find(';');
+                string_view parameter = trim(parameters.substr(0, semicolon));
+                parameters = semicolon == string_view::npos
+                    ? string_view()
+                    : parameters.substr(semicolon + 1);
+
+                if (parameter.size() < 2 || (parameter[0] | 0x20) != 'q' || parameter[1] != '=') {
+                    continue;
+                }
+
+                string_view value = trim(parameter.substr(2));
+                double q = 0;
+                auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), q);
+                if (ec != std::errc() || ptr != value.data() + value.size()) {
+                    return 0;
+                }
+
+                return std::clamp(q, 0.0, 1.0);
+            }
+
+            return 1;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    Compressor::Compressor() {
+        zlib_ = {};
+        zlib_ready_ = false;
+        zlib_level_ = Z_DEFAULT_COMPRESSION;
+
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+        all.compressors.push_back(this);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    Compressor::~Compressor() {
+        if (zlib_ready_) {
+            deflateEnd(&zlib_);
+        }
+
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+        std::erase(all.compressors, this);
+        all.retired.responses += responses_.get();
+        all.retired.bytes_in += bytes_in_.get();
+        all.retired.bytes_out += bytes_out_.get();
+        all.retired.cpu_ns += cpu_ns_.get();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    Compressor &Compressor::local() {
+        thread_local Compressor compressor;
+        return compressor;
+    }
+
+    CompressionStats Compressor::total() {
+        Registry &all = registry();
+        std::lock_guard lock(all.mutex);
+
+        CompressionStats stats = all.retired;
+        for (const Compressor *compressor : all.compressors) {
+            stats.responses += compressor->responses_.get();
+            stats.bytes_in += compressor->bytes_in_.get();
+            stats.bytes_out += compressor->bytes_out_.get();
+            stats.cpu_ns += compressor->cpu_ns_.get();
+        }
+
+        return stats;
+    }
+
+    bool Compressor::compress(
+        Encoding encoding,
+        string_view input,
+        CompressionLevel level,
+        string &output
+    ) {
+        uint64_t start = threadCpuNs();
+
+        bool compressed = false;
+        if (encoding == Encoding::Gzip) {
+            compressed = gzip(input, level, output);
+        } else if (encoding == Encoding::Brotli) {
+            compressed = brotli(input, level, output);
+        }
+
+        cpu_ns_.add(threadCpuNs() - start);
+        if (!compressed) {
+            return false;
+        }
+
+        responses_.add();
+        bytes_in_.add(input.size());
+        bytes_out_.add(output.size());
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool Compressor::gzip(string_view input, CompressionLevel level, string &output) {
+        if (input.size() > UINT_MAX) {
+            return false;
+        }
+
+        int zlib_level = level == CompressionLevel::Best ? 9 : 5;
+
+        // window bits past 15 ask zlib for the gzip wrapper
+        if (!zlib_ready_) {
+            int res = deflateInit2(&zlib_, zlib_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            if (res != Z_OK) {
+                return false;
+            }
+
+            zlib_ready_ = true;
+            zlib_level_ = zlib_level;
+        } else {
+            deflateReset(&zlib_);
+            if (zlib_level != zlib_level_) {
+                deflateParams(&zlib_, zlib_level, Z_DEFAULT_STRATEGY);
+                zlib_level_ = zlib_level;
+            }
+        }
+
+        output.resize(deflateBound(&zlib_, input.size()));
+        zlib_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+        zlib_.avail_in = static_cast<uInt>(input.size());
+        zlib_.next_out = reinterpret_cast<Bytef *>(output.data());
+        zlib_.avail_out = static_cast<uInt>(output.size());
+
+        int res = deflate(&zlib_, Z_FINISH);
+        if (res != Z_STREAM_END) {
+            output.clear();
+            return false;
+        }
+
+        output.resize(zlib_.total_out);
+        return true;
+    }
+
+    bool Compressor::brotli(string_view input, CompressionLevel level, string &output) {
+        size_t size = BrotliEncoderMaxCompressedSize(input.size());
+        if (size == 0) {
+            return false;
+        }
+
+        // quality 11 is several times slower again for a few percent
+        int quality = level == CompressionLevel::Best ? 9 : 4;
+
+        output.resize(size);
+        BROTLI_BOOL res = BrotliEncoderCompress(
+            quality,
+            BROTLI_DEFAULT_WINDOW,
+            BROTLI_MODE_TEXT,
+            input.size(),
+            reinterpret_cast<const uint8_t *>(input.data()),
+            &size,
+            reinterpret_cast<uint8_t *>(output.data())
+        );
+        if (!res) {
+            output.clear();
+            return false;
+        }
+
+        output.resize(size);
+        return true;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    Encoding compressBody(
+        const CompressionConfig &config,
+        string_view accept_encoding,
+        string_view body,
+        string &encoded
+    ) {
+        if (!config.enabled || body.size() < config.min_size) {
+            return Encoding::Identity;
+        }
+
+        Encoding encoding = negotiateEncoding(accept_encoding, true, true);
+        if (encoding == Encoding::Identity) {
+            return encoding;
+        }
+
+        // a body that does not shrink goes out as it is
+        Compressor &compressor = Compressor::local();
+        bool compressed = compressor.compress(encoding, body, CompressionLevel::Fast, encoded);
+        if (!compressed || encoded.size() >= body.size()) {
+            return Encoding::Identity;
+        }
+
+        return encoding;
+    }
+
+    Encoding negotiateEncoding(string_view accept_encoding, bool gzip, bool brotli) {
+        double gzip_q = -1;
+        double brotli_q = -1;
+        double any_q = -1;
+
+        while (!accept_encoding.empty()) {
+            size_t comma = accept_encoding.find(',');
+            string_view item = accept_encoding.substr(0, comma);
+            accept_encoding = comma == string_view::npos
+                ? string_view()
+                : accept_encoding.substr(comma + 1);
+
+            size_t semicolon = item.find(';');
+            string_view coding = trim(item.substr(0, semicolon));
+            double q = semicolon == string_view::npos ? 1 : quality(item.substr(semicolon + 1));
+
+            if (equalsIgnoreCase(coding, "gzip") || equalsIgnoreCase(coding, "x-gzip")) {
+                gzip_q = q;
+            } else if (equalsIgnoreCase(coding, "br")) {
+                brotli_q = q;
+            } else if (coding == "*") {
+                any_q = q;
+            }
+        }
+
+        // a wildcard covers whichever codings were not named
+        gzip_q = !gzip ? 0 : gzip_q < 0 ? any_q : gzip_q;
+        brotli_q = !brotli ? 0 : brotli_q < 0 ? any_q : brotli_q;
+
+        if (brotli_q > 0 && brotli_q >= gzip_q) {
+            return Encoding::Brotli;
+        }
+
+        if (gzip_q > 0) {
+            return Encoding::Gzip;
+        }
+
+        return Encoding::Identity;
+    }
+
+    string_view encodingName(Encoding encoding) {
+        switch (encoding) {
+            case Encoding::Gzip:
+                return "gzip";
+            case Encoding::Brotli:
+                return "br";
+            case Encoding::Identity:
+                break;
+        }
+
+        return "identity";
+    }
+
+    bool isCompressible(string_view content_type) {
+        string_view type = content_type.substr(0, content_type.find(';'));
+        return type.starts_with("text/")
+            || type.ends_with("/json")
+            || type.ends_with("+json")
+            || type.ends_with("/javascript")
+            || type.ends_with("/xml")
+            || type.ends_with("+xml");
+    }
+}
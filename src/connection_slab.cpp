@@ -0,0 +1,122 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "connection_slab.hpp"
+#include "connection.hpp"
+#include "metrics.hpp"
+
+using std::uint32_t;
+using std::uint64_t;
+using std::size_t;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    Connection &ConnectionSlab::acquire(int fd) {
+        size_t index = static_cast<size_t>(fd);
+        if (index >= by_fd_.size()) {
+            by_fd_.resize(index + 1, nullptr);
+            positions_.resize(index + 1, 0);
+        }
+
+        if (by_fd_[index]) {
+            reset(*by_fd_[index]);
+            return *by_fd_[index];
+        }
+
+        Connection *conn;
+        if (!free_.empty()) {
+            hits_.add();
+            conn = free_.back();
+            free_.pop_back();
+        } else {
+            misses_.add();
+            if (chunks_.empty() || fresh_ == chunk_size_) {
+                chunks_.push_back(std::make_unique<Connection[]>(chunk_size_));
+                fresh_ = 0;
+            }
+
+            conn = &chunks_.back()[fresh_++];
+        }
+
+        open_.add();
+        by_fd_[index] = conn;
+        positions_[index] = static_cast<uint32_t>(live_.size());
+        live_.push_back(fd);
+        return *conn;
+    }
+
+    Connection *ConnectionSlab::find(int fd) {
+        size_t index = static_cast<size_t>(fd);
+        if (fd < 0 || index >= by_fd_.size()) {
+            return nullptr;
+        }
+
+        return by_fd_[index];
+    }
+
+    void ConnectionSlab::release(int fd) {
+        Connection *conn = find(fd);
+        if (!conn) {
+            return;
+        }
+
+        reset(*conn);
+        open_.sub();
+        by_fd_[fd] = nullptr;
+        free_.push_back(conn);
+
+        uint32_t position = positions_[fd];
+        int moved = live_.back();
+        live_[position] = moved;
+        positions_[moved] = position;
+        live_.pop_back();
+    }
+
+    bool ConnectionSlab::contains(int fd) const {
+        return fd >= 0
+            && static_cast<size_t>(fd) < by_fd_.size()
+            && by_fd_[fd] != nullptr;
+    }
+
+    bool ConnectionSlab::empty() const {
+        return live_.empty();
+    }
+
+    size_t ConnectionSlab::size() const {
+        return live_.size();
+    }
+
+    void ConnectionSlab::clear() {
+        while (!live_.empty()) {
+            release(live_.back());
+        }
+    }
+
+    const std::vector<int> &ConnectionSlab::live() const {
+        return live_;
+    }
+
+    uint64_t ConnectionSlab::openCount() const {
+        return open_.get();
+    }
+
+    PoolStats ConnectionSlab::stats() const {
+        return PoolStats {hits_.get(), misses_.get()};
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void ConnectionSlab::reset(Connection &conn) {
+        // Drops the buffers and any suspended coroutine; the send state
+        // has nothing to release and stays with the slot.
+        std::unique_ptr<SendState> send = std::move(conn.send);
+        conn = Connection();
+        conn.send = std::move(send);
+    }
+}
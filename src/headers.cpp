@@ -0,0 +1,152 @@
+#include <string_view>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "http_parser.hpp"
+#include "headers.hpp"
+#include "output.hpp"
+#include "clock.hpp"
+
+using std::string_view;
+using std::uint16_t;
+using std::size_t;
+using std::string;
+
+namespace http {
+    namespace {
+        struct Mime {
+            string_view extension;
+            string_view type;
+        };
+
+        constexpr Mime mime_types[] = {
+            { ".html", "text/html" },
+            { ".htm", "text/html" },
+            { ".css", "text/css" },
+            { ".js", "application/javascript" },
+            { ".mjs", "application/javascript" },
+            { ".json", "application/json" },
+            { ".map", "application/json" },
+            { ".xml", "application/xml" },
+            { ".txt", "text/plain" },
+            { ".png", "image/png" },
+            { ".jpg", "image/jpeg" },
+            { ".jpeg", "image/jpeg" },
+            { ".gif", "image/gif" },
+            { ".svg", "image/svg+xml" },
+            { ".webp", "image/webp" },
+            { ".ico", "image/x-icon" },
+            { ".pdf", "application/pdf" },
+            { ".wasm", "application/wasm" },
+            { ".woff", "font/woff" },
+            { ".woff2", "font/woff2" },
+        };
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    HeadWriter::HeadWriter(OutputQueue &out, uint16_t status) {
+        out_ = &out;
+        text_ = nullptr;
+        this->status(status);
+    }
+
+    HeadWriter::HeadWriter(string &text, uint16_t status) {
+        out_ = nullptr;
+        text_ = &text;
+        text_->reserve(160);
+        this->status(status);
+    }
+
+    HeadWriter::HeadWriter(OutputQueue &out, string_view prefix) {
+        out_ = &out;
+        text_ = nullptr;
+        put(prefix);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    HeadWriter &HeadWriter::header(string_view fragment) {
+        put(fragment);
+        return *this;
+    }
+
+    HeadWriter &HeadWriter::header(string_view name, string_view value) {
+        put(name);
+        put(": ");
+        put(value);
+        put("\r\n");
+        return *this;
+    }
+
+    HeadWriter &HeadWriter::contentType(string_view type) {
+        return header("Content-Type", type);
+    }
+
+    HeadWriter &HeadWriter::contentLength(size_t length) {
+        char digits[24];
+        char *end = std::to_chars(digits, digits + sizeof(digits), length).ptr;
+
+        put("Content-Length: ");
+        put(string_view(digits, end));
+        put("\r\n");
+        return *this;
+    }
+
+    HeadWriter &HeadWriter::connection(bool keep_alive) {
+        put(keep_alive ? keep_alive_header : close_header);
+        return *this;
+    }
+
+    HeadWriter &HeadWriter::date() {
+        put(Clock::get().dateHeader());
+        return *this;
+    }
+
+    void HeadWriter::end() {
+        put("\r\n");
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void HeadWriter::status(uint16_t status) {
+        string_view line = statusLine(status);
+        if (!line.empty()) {
+            put(line);
+            return;
+        }
+
+        char digits[8];
+        char *end = std::to_chars(digits, digits + sizeof(digits), status).ptr;
+
+        put("HTTP/1.1 ");
+        put(string_view(digits, end));
+        put(" Unknown\r\n");
+    }
+
+    void HeadWriter::put(string_view text) {
+        if (out_) {
+            out_->appendCopy(text);
+        } else {
+            text_->append(text);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    string_view mimeType(string_view extension) {
+        for (const Mime &mime : mime_types) {
+            if (equalsIgnoreCase(mime.extension, extension)) {
+                return mime.type;
+            }
+        }
+
+        return "application/octet-stream";
+    }
+}
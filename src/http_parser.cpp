@@ -0,0 +1,410 @@
+#include <string_view>
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+
+#include "http_parser.hpp"
+#include "scan.hpp"
+
+using std::string_view;
+using std::size_t;
+
+namespace http {
+    namespace {
+        bool isDigit(char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        int hexValue(char c) {
+            if (c >= '0' && c <= '9') {
+                return c - '0';
+            }
+
+            char lower = char(c | 0x20);
+            if (lower >= 'a' && lower <= 'f') {
+                return lower - 'a' + 10;
+            }
+
+            return -1;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // request head
+    ///////////////////////////////////////////////////////////////////////////
+    string_view RequestHead::header(string_view name) const {
+        for (size_t i = 0; i < header_count; ++i) {
+            if (equalsIgnoreCase(headers[i].name, name)) {
+                return headers[i].value;
+            }
+        }
+
+        return {};
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    RequestParser::RequestParser() {
+        max_header_size_ = 16384;
+        scanned_ = 0;
+    }
+
+    RequestParser::RequestParser(size_t max_header_size) {
+        max_header_size_ = max_header_size;
+        scanned_ = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    ParseStatus RequestParser::parse(string_view buffer, RequestHead &head) {
+        size_t start = scanned_ > 3 ? scanned_ - 3 : 0;
+        size_t end = scan::findHeaderEnd(
+            buffer.data() + start,
+            buffer.size() - start
+        );
+        if (end == scan::npos) {
+            scanned_ = buffer.size();
+            if (buffer.size() > max_header_size_) {
+                return ParseStatus::TooLarge;
+            }
+
+            return ParseStatus::Incomplete;
+        }
+        end += start;
+
+        if (end + 4 > max_header_size_) {
+            return ParseStatus::TooLarge;
+        }
+
+        head.header_count = 0;
+        head.content_length = 0;
+        head.length = end + 4;
+        head.chunked = false;
+        head.body = {};
+
+        size_t pos = 0;
+        bool request_line = true;
+        while (pos < end + 2) {
+            size_t line_end = pos + scan::findChar(
+                buffer.data() + pos,
+                end + 2 - pos,
+                '\r'
+            );
+            if (buffer[line_end + 1] != '\n') {
+                return ParseStatus::Error;
+            }
+
+            string_view line = buffer.substr(pos, line_end - pos);
+            ParseStatus status = request_line
+                ? parseRequestLine(line, head)
+                : parseHeaderLine(line, head);
+            if (status != ParseStatus::Complete) {
+                return status;
+            }
+
+            request_line = false;
+            pos = line_end + 2;
+        }
+
+        // both framings at once is how requests get smuggled past proxies
+        if (head.chunked && !head.header("Content-Length").empty()) {
+            return ParseStatus::Error;
+        }
+
+        head.body_ready = !head.chunked && head.content_length == 0;
+        scanned_ = 0;
+        return ParseStatus::Complete;
+    }
+
+    void RequestParser::reset() {
+        scanned_ = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    ParseStatus RequestParser::parseRequestLine(
+        string_view line,
+        RequestHead &head
+    ) {
+        size_t first_space = scan::findChar(line.data(), line.size(), ' ');
+        if (first_space == scan::npos || first_space == 0) {
+            return ParseStatus::Error;
+        }
+
+        string_view rest = line.substr(first_space + 1);
+        size_t second_space = scan::findChar(rest.data(), rest.size(), ' ');
+        if (second_space == scan::npos || second_space == 0) {
+            return ParseStatus::Error;
+        }
+
+        head.method = line.substr(0, first_space);
+        head.target = rest.substr(0, second_space);
+        head.version = rest.substr(second_space + 1);
+
+        if (scan::findNonToken(head.method.data(), head.method.size())
+            != head.method.size()) {
+            return ParseStatus::Error;
+        }
+
+        if (scan::findControl(head.target.data(), head.target.size())
+            != head.target.size()) {
+            return ParseStatus::Error;
+        }
+
+        // Lines are split on CR alone, so a bare LF here would hide a
+        // header inside the version.
+        if (scan::findControl(head.version.data(), head.version.size())
+            != head.version.size()) {
+            return ParseStatus::Error;
+        }
+
+        string_view version = head.version;
+        if (version.size() != 8 || !version.starts_with("HTTP/")
+            || !isDigit(version[5]) || version[6] != '.' || !isDigit(version[7])) {
+            return ParseStatus::Error;
+        }
+
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+            return ParseStatus::UnsupportedVersion;
+        }
+
+        return ParseStatus::Complete;
+    }
+
+    ParseStatus RequestParser::parseHeaderLine(
+        string_view line,
+        RequestHead &head
+    ) {
+        size_t colon_pos = scan::findChar(line.data(), line.size(), ':');
+        if (colon_pos == scan::npos || colon_pos == 0) {
+            return ParseStatus::Error;
+        }
+
+        string_view name = line.substr(0, colon_pos);
+        if (scan::findNonToken(name.data(), name.size()) != name.size()) {
+            return ParseStatus::Error;
+        }
+
+        string_view value = line.substr(colon_pos + 1);
+        if (scan::findControl(value.data(), value.size()) != value.size()) {
+            return ParseStatus::Error;
+        }
+
+        size_t first = value.find_first_not_of(" \t");
+        if (first == string_view::npos) {
+            value = {};
+        } else {
+            value = value.substr(first, value.find_last_not_of(" \t") - first + 1);
+        }
+
+        if (head.header_count == RequestHead::max_headers) {
+            return ParseStatus::Error;
+        }
+
+        if (equalsIgnoreCase(name, "Content-Length")) {
+            size_t length = 0;
+            auto [ptr, ec] = std::from_chars(
+                value.data(),
+                value.data() + value.size(),
+                length
+            );
+            if (ec != std::errc() || ptr != value.data() + value.size()) {
+                return ParseStatus::Error;
+            }
+
+            bool repeated = !head.header("Content-Length").empty();
+            if (repeated && length != head.content_length) {
+                return ParseStatus::Error;
+            }
+            head.content_length = length;
+        }
+
+        // chunked is the only coding a request body may arrive in here
+        if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+            if (!equalsIgnoreCase(value, "chunked") || head.chunked) {
+                return ParseStatus::Error;
+            }
+            head.chunked = true;
+        }
+
+        head.headers[head.header_count++] = Header { name, value };
+
+        return ParseStatus::Complete;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // body reader
+    ///////////////////////////////////////////////////////////////////////////
+    BodyReader::BodyReader() {
+        state_ = State::Done;
+        max_size_ = 0;
+        size_ = 0;
+        left_ = 0;
+        digits_ = 0;
+    }
+
+    ParseStatus BodyReader::start(const RequestHead &head, size_t max_size) {
+        max_size_ = max_size;
+        size_ = 0;
+        left_ = 0;
+        digits_ = 0;
+
+        if (head.chunked) {
+            state_ = State::Size;
+            return ParseStatus::Incomplete;
+        }
+
+        if (head.content_length > max_size) {
+            state_ = State::Done;
+            return ParseStatus::TooLarge;
+        }
+
+        left_ = head.content_length;
+        state_ = left_ > 0 ? State::Length : State::Done;
+        return left_ > 0 ? ParseStatus::Incomplete : ParseStatus::Complete;
+    }
+
+    ParseStatus BodyReader::read(
+        string_view input,
+        size_t &consumed,
+        string_view &data
+    ) {
+        consumed = 0;
+        data = {};
+
+        // Stops after each piece of data so the caller can move it out
+        // before asking for the next.
+        while (consumed < input.size() || state_ == State::Done) {
+            if (state_ == State::Done) {
+                return ParseStatus::Complete;
+            }
+
+            char c = input[consumed];
+            switch (state_) {
+                case State::Length:
+                case State::Data: {
+                    size_t take = std::min(left_, input.size() - consumed);
+                    data = input.substr(consumed, take);
+                    consumed += take;
+                    left_ -= take;
+                    size_ += take;
+
+                    if (left_ == 0) {
+                        state_ = state_ == State::Length ? State::Done : State::DataEnd;
+                    }
+
+                    if (state_ == State::Done) {
+                        return ParseStatus::Complete;
+                    }
+                    return ParseStatus::Incomplete;
+                }
+                case State::Size: {
+                    // Only hex digits up to the extension or the line end,
+                    // no whitespace either side; a proxy in front may read
+                    // a lenient size differently and smuggle a request.
+                    int digit = hexValue(c);
+                    if (digit < 0) {
+                        if (digits_ == 0) {
+                            return ParseStatus::Error;
+                        }
+
+                        if (c == ';') {
+                            state_ = State::Extension;
+                        } else if (c == '\r') {
+                            state_ = State::SizeEnd;
+                        } else {
+                            return ParseStatus::Error;
+                        }
+                        break;
+                    }
+
+                    // the limit also keeps the size from overflowing
+                    size_t room = max_size_ - size_;
+                    if (left_ > room / 16 || left_ * 16 + digit > room) {
+                        return ParseStatus::TooLarge;
+                    }
+                    left_ = left_ * 16 + digit;
+                    digits_++;
+                    break;
+                }
+                case State::Extension:
+                    if (c == '\n') {
+                        return ParseStatus::Error;
+                    }
+
+                    if (c == '\r') {
+                        state_ = State::SizeEnd;
+                    }
+                    break;
+                case State::SizeEnd:
+                    if (c != '\n') {
+                        return ParseStatus::Error;
+                    }
+
+                    digits_ = 0;
+                    state_ = left_ > 0 ? State::Data : State::Trailer;
+                    break;
+                case State::DataEnd:
+                    if (c != '\r') {
+                        return ParseStatus::Error;
+                    }
+                    state_ = State::DataEndLine;
+                    break;
+                case State::DataEndLine:
+                    if (c != '\n') {
+                        return ParseStatus::Error;
+                    }
+                    state_ = State::Size;
+                    break;
+                case State::Trailer:
+                    state_ = c == '\r' ? State::TrailerEnd : State::TrailerLine;
+                    break;
+                case State::TrailerLine:
+                    if (c == '\n') {
+                        state_ = State::Trailer;
+                    }
+                    break;
+                case State::TrailerEnd:
+                    if (c != '\n') {
+                        return ParseStatus::Error;
+                    }
+                    state_ = State::Done;
+                    break;
+                case State::Done:
+                    break;
+            }
+
+            consumed++;
+        }
+
+        return ParseStatus::Incomplete;
+    }
+
+    size_t BodyReader::size() const {
+        return size_;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // helpers
+    ///////////////////////////////////////////////////////////////////////////
+    bool equalsIgnoreCase(string_view a, string_view b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+
+        auto lower = [](char c) {
+            return (c >= 'A' && c <= 'Z') ? char(c | 0x20) : c;
+        };
+
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (lower(a[i]) != lower(b[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
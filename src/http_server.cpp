@@ -1,24 +1,49 @@
 #include <functional>
 #include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
 #include <cstring>
-#include <fstream>
-#include <sstream>
+#include <climits>
 #include <format>
+#include <string_view>
+#include <chrono>
+#include <memory>
 #include <string>
-#include <map>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <csignal>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <pthread.h>
 #include <unistd.h>
+#include <poll.h>
+#include <sched.h>
 
 #include "http_server.hpp"
+#include "http_parser.hpp"
+#include "static_files.hpp"
+#include "access_log.hpp"
+#include "compression.hpp"
+#include "arena.hpp"
+#include "buffer_pool.hpp"
+#include "thread_pool.hpp"
+#include "websocket.hpp"
+#include "reactor.hpp"
+#include "metrics.hpp"
+#include "async.hpp"
+#include "output.hpp"
 #include "logger.hpp"
+#include "clock.hpp"
 
+using std::string_view;
 using std::function;
+using std::shared_ptr;
 using std::format;
 using std::string;
-using std::map;
 
 ///////////////////////////////////////////////////////////////////////////////
 // constructors
@@ -27,16 +52,18 @@ HttpServer::HttpServer() : log(false, false) {
     address = "127.0.0.1";
     port = 3000;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
 }
 
 HttpServer::HttpServer(bool log_to_console, bool log_to_file)
-    : log(log_to_console, log_to_file) {
+    : log(log_to_console, log_to_file, LogMode::Async, LogOverflow::Drop) {
     address = "127.0.0.1";
     port = 3000;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
@@ -50,13 +77,14 @@ HttpServer::HttpServer(string address) : log(false, false) {
     }
     port = 3000;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
 }
 
 HttpServer::HttpServer(string address, bool log_to_console, bool log_to_file)
-    : log(log_to_console, log_to_file) {
+    : log(log_to_console, log_to_file, LogMode::Async, LogOverflow::Drop) {
     if (address == "localhost") {
         this->address = "127.0.0.1";
     } else {
@@ -64,6 +92,7 @@ HttpServer::HttpServer(string address, bool log_to_console, bool log_to_file)
     }
     port = 3000;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
@@ -77,6 +106,7 @@ HttpServer::HttpServer(string address, int port) : log(false, false) {
     }
     this->port = port;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
@@ -87,7 +117,7 @@ HttpServer::HttpServer(
     int port,
     bool log_to_console,
     bool log_to_file
-) : log(log_to_console, log_to_file) {
+) : log(log_to_console, log_to_file, LogMode::Async, LogOverflow::Drop) {
     if (address == "localhost") {
         this->address = "127.0.0.1";
     } else {
@@ -95,6 +125,7 @@ HttpServer::HttpServer(
     }
     this->port = port;
     queue_size = 10;
+    workers = 1;
     server_socket = -1;
 
     prepareSocket();
@@ -106,7 +137,7 @@ HttpServer::HttpServer(
     int queue_size,
     bool log_to_console,
     bool log_to_file
-) : log(log_to_console, log_to_file) {
+) : log(log_to_console, log_to_file, LogMode::Async, LogOverflow::Drop) {
     if (address == "localhost") {
         this->address = "127.0.0.1";
     } else {
@@ -114,6 +145,32 @@ HttpServer::HttpServer(
     }
     this->port = port;
     this->queue_size = queue_size;
+    workers = 1;
+    server_socket = -1;
+
+    prepareSocket();
+}
+
+HttpServer::HttpServer(
+    string address,
+    int port,
+    int queue_size,
+    int workers,
+    bool log_to_console,
+    bool log_to_file
+) : log(log_to_console, log_to_file, LogMode::Async, LogOverflow::Drop) {
+    if (address == "localhost") {
+        this->address = "127.0.0.1";
+    } else {
+        this->address = address;
+    }
+    this->port = port;
+    this->queue_size = queue_size;
+    if (workers > 0) {
+        this->workers = workers;
+    } else {
+        this->workers = std::max(1u, std::thread::hardware_concurrency());
+    }
     server_socket = -1;
 
     prepareSocket();
@@ -140,41 +197,229 @@ void HttpServer::route(
     Method method,
     function<string(string endpoint)> handler,
     ContentType content_type
+) {
+    route(std::move(endpoint), method, std::move(handler), content_type, Execution::Inline);
+}
+
+void HttpServer::route(
+    string endpoint,
+    Method method,
+    function<string(string endpoint)> handler,
+    ContentType content_type,
+    Execution execution
 ) {
     Endpoint end;
     end.method = method;
     end.handler = handler;
     end.content_type = content_type;
+    end.execution = execution;
+
+    addRoute(endpoint, std::move(end));
+}
+
+void HttpServer::route(
+    string endpoint,
+    Method method,
+    function<string(string_view path, const http::RouteParams &params)> handler,
+    ContentType content_type
+) {
+    route(std::move(endpoint), method, std::move(handler), content_type, Execution::Inline);
+}
+
+void HttpServer::route(
+    string endpoint,
+    Method method,
+    function<string(string_view path, const http::RouteParams &params)> handler,
+    ContentType content_type,
+    Execution execution
+) {
+    Endpoint end;
+    end.method = method;
+    end.param_handler = handler;
+    end.content_type = content_type;
+    end.execution = execution;
+
+    addRoute(endpoint, std::move(end));
+}
+
+void HttpServer::route(
+    string endpoint,
+    Method method,
+    http::ArenaHandler handler,
+    ContentType content_type
+) {
+    Endpoint end;
+    end.method = method;
+    end.arena_handler = std::move(handler);
+    end.content_type = content_type;
+
+    addRoute(endpoint, std::move(end));
+}
+void HttpServer::route(string endpoint, Method method, http::AsyncHandler handler) {
+    Endpoint end;
+    end.method = method;
+    end.async_handler = std::move(handler);
+    end.content_type = ContentType::Plain;
+
+    addRoute(endpoint, std::move(end));
+}
+
+void HttpServer::websocket(string endpoint, http::WebSocketHandler handler) {
+    Endpoint end;
+    end.method = Method::Get;
+    end.websocket = std::make_shared<const http::WebSocketHandler>(
+        std::move(handler)
+    );
+    end.content_type = ContentType::Plain;
+
+    addRoute(endpoint, std::move(end));
+}
+
+void HttpServer::broadcast(string_view endpoint, string_view message) {
+    const http::WebSocketHandler *target = findWebSocket(endpoint);
+    if (!target) {
+        log.error("No WebSocket route for broadcast to {}", endpoint);
+        return;
+    }
+
+    auto frame = std::make_shared<const string>(
+        http::encodeFrame(http::Opcode::Text, message)
+    );
+
+    std::lock_guard lock(reactors_mutex);
+    for (http::Reactor *reactor : reactors) {
+        reactor->broadcast(target, frame);
+    }
+}
+
+http::Metrics HttpServer::metrics() {
+    http::Metrics metrics;
+    metrics.buffers = http::BufferPool::total();
+    metrics.pooled_buffer_bytes = http::BufferPool::pooledBytes();
+    metrics.compression = http::Compressor::total();
+
+    std::lock_guard lock(reactors_mutex);
+    for (http::Reactor *reactor : reactors) {
+        http::PoolStats slots = reactor->connectionSlots();
+        metrics.connections += reactor->connectionCount();
+        metrics.connection_slots.hits += slots.hits;
+        metrics.connection_slots.misses += slots.misses;
+    }
+
+    return metrics;
+}
+
+void HttpServer::setLogLevel(LogLevel level) {
+    log.setLevel(level);
+}
+
+void HttpServer::setAccessLog(string directory) {
+    setAccessLog(std::move(directory), 1 << 20, 8);
+}
+
+void HttpServer::setAccessLog(
+    string directory,
+    size_t records_per_file,
+    int max_files
+) {
+    auto open_res = access_log.open(directory, records_per_file, max_files);
+    if (!open_res) {
+        log.error("Access log disabled: {}", open_res.error());
+        return;
+    }
+
+    reactor_config.access_log = &access_log;
+    log.info("Writing binary access log to {}", directory);
+}
+
+void HttpServer::setThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    thread_pool = std::make_unique<http::ThreadPool>(threads);
+    reactor_config.pool = thread_pool.get();
+}
 
-    map<string, Endpoint> current_map;
-    current_map[endpoint] = end;
-    endpoints.push_back(current_map);
+void HttpServer::setBackend(http::Backend backend) {
+    reactor_config.backend = backend;
+}
+
+void HttpServer::setKeepAlive(int timeout_seconds, int max_requests) {
+    reactor_config.keep_alive_timeout = timeout_seconds;
+    reactor_config.max_keep_alive_requests = max_requests;
+}
+
+void HttpServer::setTimeouts(int header_seconds, int body_seconds, int write_seconds) {
+    reactor_config.header_timeout = header_seconds;
+    reactor_config.body_timeout = body_seconds;
+    reactor_config.write_timeout = write_seconds;
+}
+
+void HttpServer::setMaxBodySize(size_t max_body_size) {
+    reactor_config.max_body_size = max_body_size;
+}
+
+void HttpServer::setCompression(bool enabled, size_t min_size) {
+    reactor_config.compression.enabled = enabled;
+    reactor_config.compression.min_size = min_size;
+    static_config.compress = enabled;
+}
+
+void HttpServer::setRouteCompression(string_view endpoint, Method method, bool enabled) {
+    for (Endpoint &end : endpoints) {
+        if (end.pattern == endpoint && end.method == method) {
+            end.compress = enabled;
+            return;
+        }
+    }
+
+    log.error("No route {} to set compression on", endpoint);
+}
+
+void HttpServer::setStaticCache(size_t cache_budget, size_t max_file_size) {
+    static_config.cache_budget = cache_budget;
+    static_config.max_cached_file_size = max_file_size;
 }
 
 void HttpServer::serveDir(string directory) {
-    string html;
-    std::ifstream file("./public/index.html");
-    if (file.is_open()) {
-        std::stringstream ss;
-        ss << file.rdbuf();
-        html = ss.str();
-        file.close();
-    } else {
-        return "";
+    serveDir(std::move(directory), false);
+}
+
+void HttpServer::serveDir(string directory, bool hot_reload) {
+    auto res = static_files.load(directory, static_config);
+    if (!res) {
+        log.error("serveDir failed: {}", res.error());
+        return;
+    }
+
+    if (hot_reload) {
+        auto watch_res = static_files.watch();
+        if (!watch_res) {
+            log.error("Hot reload disabled: {}", watch_res.error());
+            return;
+        }
+
+        // public/js/websocket.js listens on /ws for the reload message.
+        if (!findWebSocket("/ws")) {
+            websocket("/ws", http::WebSocketHandler {});
+        }
     }
+
+    this->hot_reload = hot_reload;
 }
 
 void HttpServer::acceptClient() {
-    log.info(format("Server listening on {}:{}...", address, port));
+    log.info("Server listening on {}:{}...", address, port);
 
     struct sockaddr_in addr;
     socklen_t addrlen = sizeof(addr);
     int res = getsockname(server_socket, (struct sockaddr *)&addr, &addrlen);
     if (res != 0) {
-        log.error(format(
+        log.error(
             "Error retrieving server address with getsockname(): {}",
             strerror(errno)
-        ));
+        );
         return;
     }
 
@@ -190,239 +435,782 @@ void HttpServer::acceptClient() {
             continue;
         }
 
-        log.info(format("Client socket created: {}", client_socket));
+        log.debug("Client socket created: {}", client_socket);
 
         char client_ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &(addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        log.info(format(
+        log.debug(
             "Connection accepted from {}:{}",
             client_ip,
             ntohs(addr.sin_port)
-        ));
+        );
 
         handleClientRequest(client_socket);
     }
 }
 
+void HttpServer::acceptClientWithLoop() {
+    bool wants_pool = std::any_of(endpoints.begin(), endpoints.end(), [](const Endpoint &end) {
+        return end.execution == Execution::Pool;
+    });
+    // hot reload recompresses changed files on the pool
+    if ((wants_pool || hot_reload) && !thread_pool) {
+        setThreadPool(0);
+    }
+
+    // sendfile and splice have no MSG_NOSIGNAL; a client that resets
+    // mid-file must not take the process down with it
+    std::signal(SIGPIPE, SIG_IGN);
+
+    log.info(
+        "Server listening on {}:{} with {} worker(s)...",
+        address,
+        port,
+        workers
+    );
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers; ++i) {
+        int worker_socket = createListenSocket();
+        if (worker_socket < 0) {
+            log.error("Worker {} could not open a listening socket", i);
+            continue;
+        }
+
+        threads.emplace_back([this, worker_socket, i] {
+            pinToCore(i);
+            runReactor(worker_socket);
+            closeSocket(worker_socket);
+        });
+    }
+
+    if (workers > 1) {
+        pinToCore(0);
+    }
+    runReactor(server_socket);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // private member functions
 ///////////////////////////////////////////////////////////////////////////////
 void HttpServer::prepareSocket() {
+    server_socket = createListenSocket();
+}
+
+int HttpServer::createListenSocket() {
     struct sockaddr_in addr;
     int enable = 1;
 
-    int res1 = server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (res1 < 0) {
+    int listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_socket < 0) {
         log.error("Socket creation error");
-        return;
+        return -1;
     }
 
-    log.info(format("Server socket created: {}", server_socket));
+    log.info("Server socket created: {}", listen_socket);
 
-    int res2 = setsockopt(
-        server_socket,
+    int res1 = setsockopt(
+        listen_socket,
         SOL_SOCKET,
         SO_REUSEADDR,
         (const char *)&enable,
         sizeof(enable)
     );
 
-    if (res2 < 0) {
+    if (res1 < 0) {
         log.error("setsockopt failed");
-        closeSocket(server_socket);
-        return;
+        closeSocket(listen_socket);
+        return -1;
+    }
+
+    if (workers > 1) {
+        int res2 = setsockopt(
+            listen_socket,
+            SOL_SOCKET,
+            SO_REUSEPORT,
+            (const char *)&enable,
+            sizeof(enable)
+        );
+
+        if (res2 < 0) {
+            log.error("setsockopt SO_REUSEPORT failed");
+            closeSocket(listen_socket);
+            return -1;
+        }
     }
 
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
 
-    int res3 = bind(server_socket, (struct sockaddr *)&addr, sizeof(addr));
+    int res3 = bind(listen_socket, (struct sockaddr *)&addr, sizeof(addr));
     if (res3 < 0) {
         log.error("Bind failed. Check if port is already in use");
-        closeSocket(server_socket);
-        return;
+        closeSocket(listen_socket);
+        return -1;
     }
 
-    int res4 = listen(server_socket, queue_size);
+    int res4 = listen(listen_socket, queue_size);
     if (res4 < 0) {
         log.error("Listen failed");
-        closeSocket(server_socket);
+        closeSocket(listen_socket);
+        return -1;
+    }
+
+    return listen_socket;
+}
+
+void HttpServer::runReactor(int listen_socket) {
+    http::Reactor reactor(
+        log,
+        reactor_config,
+        [this](
+            const http::RequestHead &head,
+            bool &keep_alive,
+            http::OutputQueue &out,
+            http::ResponseInfo &info,
+            http::Arena &arena
+        ) {
+            return buildResponse(head, keep_alive, out, info, arena);
+        },
+        [this](const http::RequestHead &head) {
+            return findWebSocket(head.target.substr(0, head.target.find('?')));
+        }
+    );
+
+    auto open_res = reactor.open(listen_socket);
+    if (!open_res) {
+        log.error("Event loop setup failed: {}", open_res.error());
+        return;
+    }
+
+    {
+        std::lock_guard lock(reactors_mutex);
+        reactors.push_back(&reactor);
+    }
+
+    // Only the main loop owns the inotify descriptor; the cache itself is
+    // shared, so every worker sees the invalidated entries.
+    if (hot_reload && listen_socket == server_socket) {
+        auto watch_res = reactor.watch(static_files.watchFd(), [this] {
+            if (static_files.handleWatchEvents(thread_pool.get()) > 0) {
+                broadcastReload();
+            }
+        });
+
+        if (!watch_res) {
+            log.error("Hot reload disabled: {}", watch_res.error());
+        }
+    }
+
+    auto run_res = reactor.run();
+    if (!run_res) {
+        log.error("Event loop stopped: {}", run_res.error());
+    }
+
+    std::lock_guard lock(reactors_mutex);
+    std::erase(reactors, &reactor);
+}
+
+void HttpServer::broadcastReload() {
+    log.info("Static files changed, reloading WebSocket clients");
+    broadcast("/ws", "reload");
+}
+
+const http::WebSocketHandler *HttpServer::findWebSocket(string_view path) {
+    http::RouteParams params;
+    size_t id = router.match(static_cast<size_t>(Method::Get), path, params);
+    if (id == http::Router::npos) {
+        return nullptr;
+    }
+
+    return endpoints[id].websocket.get();
+}
+
+void HttpServer::pinToCore(int worker) {
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0 || workers > (int)cores) {
         return;
     }
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(worker % cores, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
 }
 
 void HttpServer::handleClientRequest(int client_socket) {
-    char buffer[4096] = {0};
-    int bytes_received;
-    bytes_received = read(client_socket, buffer, sizeof(buffer) - 1);
+    char buffer[4096];
+    string request;
+    http::RequestParser parser(reactor_config.max_header_size);
+    http::RequestHead head;
+    http::ParseStatus status = http::ParseStatus::Incomplete;
+
+    // One client at a time, so one that never finishes its request would
+    // hold up every other; it gets the header timeout and no more.
+    auto deadline = deadlineAfter(reactor_config.header_timeout);
 
-    if (bytes_received <= 0) {
-        log.error(format(
-            "Client {} disconnected during initial HTTP request "
-            "(recv returned {})",
-            client_socket, bytes_received
-        ));
+    while (status == http::ParseStatus::Incomplete) {
+        if (!waitForSocket(client_socket, POLLIN, deadline)) {
+            log.warn("Client {} timed out sending its request", client_socket);
 
+            if (!request.empty()) {
+                http::OutputQueue out;
+                http::ResponseInfo info;
+                writeError(Status::RequestTimeout, false, out, info);
+                out.flush(client_socket);
+            }
+
+            closeSocket(client_socket);
+            return;
+        }
+
+        int bytes_received = read(client_socket, buffer, sizeof(buffer));
+        if (bytes_received <= 0) {
+            log.error(
+                "Client {} disconnected during initial HTTP request "
+                "(recv returned {})",
+                client_socket, bytes_received
+            );
+
+            closeSocket(client_socket);
+            return;
+        }
+
+        request.append(buffer, bytes_received);
+        status = parser.parse(request, head);
+    }
+
+    if (status != http::ParseStatus::Complete) {
+        Status error = Status::BadRequest;
+        if (status == http::ParseStatus::TooLarge) {
+            log.warn("Request head from client {} is too large", client_socket);
+            error = Status::RequestHeaderFieldsTooLarge;
+        } else if (status == http::ParseStatus::UnsupportedVersion) {
+            log.warn("Client {} sent unsupported version {}", client_socket, head.version);
+            error = Status::HttpVersionNotSupported;
+        } else {
+            log.warn("Malformed request from client {}", client_socket);
+        }
+
+        http::OutputQueue out;
+        http::ResponseInfo info;
+        writeError(error, false, out, info);
+        out.flush(client_socket);
         closeSocket(client_socket);
         return;
     }
 
-    buffer[bytes_received] = '\0';
-    string request(buffer);
-
-    log.info(format(
-        "Received request from client {}: {}",
+    log.debug(
+        "Received request from client {}: {} {} {}",
         client_socket,
-        request.substr(0, request.find('\n'))
-    ));
+        head.method,
+        head.target,
+        head.version
+    );
+
+    bool keep_alive = false;
+    http::OutputQueue out;
+    http::ResponseInfo info;
+
+    // The head points into the request, so the body goes in a string of
+    // its own rather than growing that one.
+    string body;
+    if (!head.body_ready) {
+        http::ParseStatus body_status = receiveBody(
+            client_socket,
+            head,
+            string_view(request).substr(head.length),
+            body
+        );
+
+        if (body_status != http::ParseStatus::Complete) {
+            Status error = Status::BadRequest;
+            if (body_status == http::ParseStatus::TooLarge) {
+                error = Status::ContentTooLarge;
+            } else if (body_status == http::ParseStatus::Incomplete) {
+                error = Status::RequestTimeout;
+            }
+
+            writeError(error, false, out, info);
+            out.flush(client_socket);
+            closeSocket(client_socket);
+            return;
+        }
+
+        head.body = body;
+        head.body_ready = true;
+    }
+
+    http::Arena arena;
+    http::Reactor::Deferred deferred = buildResponse(head, keep_alive, out, info, arena);
+    if (deferred.job) {
+        deferred.job(out, info, keep_alive);
+    } else if (deferred.coroutine) {
+        log.error("Coroutine route {} needs acceptClientWithLoop", head.target);
+        writeError(Status::InternalServerError, false, out, info, head.method == "HEAD");
+    }
+    // The send timeout makes a write to a client that stopped reading
+    // come back short, and one more write timeout without room ends it.
+    if (reactor_config.write_timeout > 0) {
+        timeval send_timeout {reactor_config.write_timeout, 0};
+        setsockopt(
+            client_socket,
+            SOL_SOCKET,
+            SO_SNDTIMEO,
+            &send_timeout,
+            sizeof(send_timeout)
+        );
+    }
+
+    while (out.flush(client_socket) == http::FlushStatus::Blocked) {
+        auto write_deadline = deadlineAfter(reactor_config.write_timeout);
+        if (!waitForSocket(client_socket, POLLOUT, write_deadline)) {
+            log.warn("Client {} stopped reading its response", client_socket);
+            break;
+        }
+    }
+    closeSocket(client_socket);
+}
+
+http::ParseStatus HttpServer::receiveBody(
+    int client_socket,
+    const http::RequestHead &head,
+    string_view received,
+    string &body
+) {
+    char buffer[4096];
+    http::BodyReader reader;
+    http::ParseStatus status = reader.start(head, reactor_config.max_body_size);
+    if (status == http::ParseStatus::TooLarge) {
+        return status;
+    }
+
+    auto deadline = deadlineAfter(reactor_config.body_timeout);
+
+    while (true) {
+        while (!received.empty()) {
+            size_t used = 0;
+            string_view data;
+            status = reader.read(received, used, data);
+            body.append(data);
+            received.remove_prefix(used);
+
+            if (status != http::ParseStatus::Incomplete) {
+                return status;
+            }
+        }
+
+        if (!waitForSocket(client_socket, POLLIN, deadline)) {
+            log.warn("Client {} timed out sending its body", client_socket);
+            return http::ParseStatus::Incomplete;
+        }
+
+        int bytes_received = read(client_socket, buffer, sizeof(buffer));
+        if (bytes_received <= 0) {
+            log.error("Client {} disconnected during request body", client_socket);
+            return http::ParseStatus::Error;
+        }
+
+        received = string_view(buffer, bytes_received);
+    }
+}
+
+std::chrono::steady_clock::time_point HttpServer::deadlineAfter(int seconds) {
+    if (seconds <= 0) {
+        return std::chrono::steady_clock::time_point::max();
+    }
+
+    return std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+}
+
+bool HttpServer::waitForSocket(
+    int socket,
+    short events,
+    std::chrono::steady_clock::time_point deadline
+) {
+    pollfd ready {socket, events, 0};
+
+    while (true) {
+        int timeout = -1;
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()
+            ).count();
+            if (left <= 0) {
+                return false;
+            }
+
+            timeout = static_cast<int>(std::min<long long>(left, INT_MAX));
+        }
+
+        int res = poll(&ready, 1, timeout);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+
+        return res > 0;
+    }
+}
 
-    auto header = parseHttpHeader(request);
+http::Reactor::Deferred HttpServer::buildResponse(
+    const http::RequestHead &head,
+    bool &keep_alive,
+    http::OutputQueue &out,
+    http::ResponseInfo &info,
+    http::Arena &arena
+) {
+    keep_alive = keep_alive && wantsKeepAlive(head);
 
-    string method_line = header["Method"];
-    Method method;
-    if (method_line.starts_with("GET")) {
+    Method method = Method::Get;
+    bool known_method = true;
+    if (head.method == "GET") {
         method = Method::Get;
-    } else if (method_line.starts_with("POST")) {
+    } else if (head.method == "POST") {
         method = Method::Post;
-    } else if (method_line.starts_with("PUT")) {
+    } else if (head.method == "PUT") {
         method = Method::Put;
-    } else if (method_line.starts_with("DELETE")) {
+    } else if (head.method == "DELETE") {
         method = Method::Delete;
-    } else if (method_line.starts_with("HEAD")) {
+    } else if (head.method == "HEAD") {
         method = Method::Head;
-    } else if (method_line.starts_with("OPTIONS")) {
+    } else if (head.method == "OPTIONS") {
         method = Method::Options;
-    } else if (method_line.starts_with("PATCH")) {
+    } else if (head.method == "PATCH") {
         method = Method::Patch;
+    } else {
+        known_method = false;
     }
 
-    string response;
-    size_t first_space = method_line.find(' ');
-    if (first_space == string::npos) {
-        response = "";
+    string_view path = head.target.substr(0, head.target.find('?'));
+
+    // a HEAD response keeps its Content-Length but never carries the body
+    bool head_only = known_method && method == Method::Head;
+
+    if (known_method) {
+        http::RouteParams params;
+        size_t id = router.match(static_cast<size_t>(method), path, params);
+        if (id != http::Router::npos) {
+            const Endpoint &end = endpoints[id];
+            info.route_id = static_cast<std::uint32_t>(id);
+            if (end.websocket) {
+                info.status = 426;
+                http::HeadWriter(out, info.status)
+                    .header("Upgrade: websocket\r\n")
+                    .header("Sec-WebSocket-Version: 13\r\n")
+                    .contentLength(0)
+                    .header(keep_alive
+                        ? "Connection: Upgrade, keep-alive\r\n"
+                        : "Connection: Upgrade, close\r\n")
+                    .date()
+                    .end();
+                return {};
+            }
+
+            if (end.async_handler) {
+                return {
+                    {},
+                    end.async_handler,
+                    http::makeRequest(head, path, params),
+                    false,
+                    end.compress,
+                };
+            }
+
+            // every other handler sees the body whole
+            if (!head.body_ready) {
+                return {{}, {}, {}, true};
+            }
+
+            if (end.arena_handler) {
+                http::RequestView request(head, path, params, arena);
+                string_view body;
+                try {
+                    body = end.arena_handler(request);
+                } catch (...) {
+                    handlerFailed(head.target, keep_alive, out, info, head_only);
+                    return {};
+                }
+
+                string encoded;
+                http::Encoding encoding = encodeBody(
+                    end,
+                    head.header("Accept-Encoding"),
+                    body,
+                    encoded
+                );
+                if (encoding != http::Encoding::Identity) {
+                    writeHead(end, encoded.size(), encoding, keep_alive, out, info);
+                    if (!head_only) {
+                        out.append(std::move(encoded));
+                    }
+                    return {};
+                }
+
+                writeHead(end, body.size(), encoding, keep_alive, out, info);
+                if (!head_only) {
+                    out.appendCopy(body);
+                }
+                return {};
+            }
+
+            if (end.execution == Execution::Pool && thread_pool) {
+                return deferResponse(end, head, path, params, head_only);
+            }
+
+            string response;
+            try {
+                if (end.param_handler) {
+                    response = end.param_handler(path, params);
+                } else {
+                    response = end.handler(string(head.target));
+                }
+            } catch (...) {
+                handlerFailed(head.target, keep_alive, out, info, head_only);
+                return {};
+            }
+
+            writeResponse(
+                end,
+                head.header("Accept-Encoding"),
+                std::move(response),
+                keep_alive,
+                head_only,
+                out,
+                info
+            );
+            return {};
+        }
     }
-    size_t second_space = method_line.find(' ', first_space + 1);
-    if (second_space == string::npos) {
-        response = "";
+
+    // read and dropped, so the connection can carry on after the error
+    if (!head.body_ready) {
+        return {{}, {}, {}, true};
     }
-    string endpoint = method_line
-        .substr(first_space + 1, second_space - (first_space + 1));
-    string content_type_str;
-    ContentType content_type;
-    Endpoint end;
 
-    bool ok = false;
-    for (auto endp : endpoints) {
-        if (endp.count(endpoint) > 0) {
-            if (method == endp[endpoint].method) {
-                response = endp[endpoint].handler(endpoint);
-                content_type = endp[endpoint].content_type;
-                ok = true;
-                break;
-            }
+    bool is_get = method == Method::Get || method == Method::Head;
+    if (known_method && is_get) {
+        string_view connection_line = keep_alive
+            ? "Connection: keep-alive\r\n\r\n"
+            : "Connection: close\r\n\r\n";
+        int status = static_files.serve(path, head, connection_line, out);
+        if (status != 0) {
+            info.status = status;
+            return {};
         }
     }
 
-    content_type_str = getContentTypeString(content_type);
-    string response_header;
+    writeError(Status::NotFound, keep_alive, out, info, head_only);
+    return {};
+}
+
+http::Reactor::Deferred HttpServer::deferResponse(
+    const Endpoint &end,
+    const http::RequestHead &head,
+    string_view path,
+    const http::RouteParams &params,
+    bool head_only
+) {
+    // The request buffer is reused as soon as this returns, so the job
+    // owns a copy of everything the handler looks at.
+    shared_ptr<const http::Request> request = http::makeRequest(head, path, params);
 
-    if (ok) {
-        response_header = format(
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: {}\r\n"
-            "Content-Length: {}\r\n"
-            "Connection: close\r\n"
-            "\r\n"
-            "{}", content_type_str, response.length(), response
+    http::Reactor::Job job = [this, &end, request, head_only](
+        http::OutputQueue &out,
+        http::ResponseInfo &info,
+        bool &keep_alive
+    ) {
+        string response;
+        try {
+            if (end.param_handler) {
+                response = end.param_handler(request->path, request->params);
+            } else {
+                response = end.handler(request->target);
+            }
+        } catch (...) {
+            handlerFailed(request->target, keep_alive, out, info, head_only);
+            return;
+        }
+
+        writeResponse(
+            end,
+            request->header("Accept-Encoding"),
+            std::move(response),
+            keep_alive,
+            head_only,
+            out,
+            info
         );
+    };
 
-        write(client_socket, response_header.c_str(), response_header.length());
-    } else if (response == "") {
-        string response_header =
-            "HTTP/1.1 404 Not Found\r\n"
-            "Content-Type: text/plain\r\r\n"
-            "Content-Length: 13\r\n"
-            "Connection: close\r\n"
-            "\r\n"
-            "404 Not Found";
-
-        write(client_socket, response_header.c_str(), response_header.length());
-        closeSocket(client_socket);
-    } else {
-        string response_header =
-            "HTTP/1.1 400 Bad Request\r\n"
-            "Content-Type: text/plain\r\n"
-            "Content-Length: 15\r\n"
-            "Connection: close\r\n"
-            "\r\n"
-            "400 Bad Request";
-
-        write(client_socket, response_header.c_str(), response_header.length());
-        closeSocket(client_socket);
+    return {std::move(job), {}, {}};
+}
+
+void HttpServer::handlerFailed(
+    string_view target,
+    bool &keep_alive,
+    http::OutputQueue &out,
+    http::ResponseInfo &info,
+    bool head_only
+) {
+    // called from a catch block, so the exception is still current
+    try {
+        throw;
+    } catch (const std::exception &error) {
+        log.error("Handler for {} threw: {}", target, error.what());
+    } catch (...) {
+        log.error("Handler for {} threw", target);
     }
+
+    keep_alive = false;
+    writeError(Status::InternalServerError, false, out, info, head_only);
 }
 
-map<string, string> HttpServer::parseHttpHeader(const string &request) {
-    map<string, string> header;
-    std::istringstream iss(request);
-    string line;
+void HttpServer::writeResponse(
+    const Endpoint &end,
+    string_view accept_encoding,
+    string response,
+    bool keep_alive,
+    bool head_only,
+    http::OutputQueue &out,
+    http::ResponseInfo &info
+) {
+    string encoded;
+    http::Encoding encoding = encodeBody(end, accept_encoding, response, encoded);
+    if (encoding != http::Encoding::Identity) {
+        response = std::move(encoded);
+    }
+
+    writeHead(end, response.size(), encoding, keep_alive, out, info);
+    if (!head_only) {
+        out.append(std::move(response));
+    }
+}
 
-    string method = "Method";
-    std::getline(iss, line);
-    header[method] = line;
+void HttpServer::writeHead(
+    const Endpoint &end,
+    size_t content_length,
+    http::Encoding encoding,
+    bool keep_alive,
+    http::OutputQueue &out,
+    http::ResponseInfo &info
+) {
+    info.status = 200;
+    http::HeadWriter writer(out, end.head);
+    writer.contentLength(content_length);
 
-    while (std::getline(iss, line) && !line.empty() && line != "\r") {
-        size_t colon_pos = line.find(':');
-        if (colon_pos != string::npos) {
-            string key = line.substr(0, colon_pos);
-            string value = line.substr(colon_pos + 1);
+    if (encoding != http::Encoding::Identity) {
+        writer.header("Content-Encoding", http::encodingName(encoding));
+    }
 
-            key.erase(0, key.find_first_not_of(" \t\r\n"));
-            key.erase(key.find_last_not_of(" \t\r\n") + 1);
-            value.erase(0, value.find_first_not_of(" \t\r\n"));
-            value.erase(value.find_last_not_of(" \t\r\n") + 1);
-            header[key] = value;
-        }
+    // whether or not this one was compressed, the next might be
+    if (compresses(end)) {
+        writer.header("Vary: Accept-Encoding\r\n");
+    }
+
+    writer.connection(keep_alive).date().end();
+}
+
+bool HttpServer::compresses(const Endpoint &end) {
+    return reactor_config.compression.enabled
+        && end.compress
+        && http::isCompressible(getContentTypeString(end.content_type));
+}
+
+http::Encoding HttpServer::encodeBody(
+    const Endpoint &end,
+    string_view accept_encoding,
+    string_view body,
+    string &encoded
+) {
+    if (!compresses(end)) {
+        return http::Encoding::Identity;
+    }
+
+    return http::compressBody(reactor_config.compression, accept_encoding, body, encoded);
+}
+
+void HttpServer::writeError(
+    Status status,
+    bool keep_alive,
+    http::OutputQueue &out,
+    http::ResponseInfo &info,
+    bool head_only
+) {
+    info.status = static_cast<std::uint16_t>(status);
+    string_view line = http::statusLine(info.status);
+
+    // the body is the status line without its version and line break
+    string_view body = line.substr(9, line.size() - 11);
+    http::HeadWriter(out, info.status)
+        .contentType("text/plain")
+        .contentLength(body.size())
+        .connection(keep_alive)
+        .date()
+        .end();
+
+    if (!head_only) {
+        out.appendStatic(body);
+    }
+}
+
+bool HttpServer::wantsKeepAlive(const http::RequestHead &head) {
+    string_view connection = head.header("Connection");
+
+    if (http::equalsIgnoreCase(connection, "close")) {
+        return false;
+    }
+
+    if (http::equalsIgnoreCase(connection, "keep-alive")) {
+        return true;
+    }
+
+    return head.version != "HTTP/1.0";
+}
+
+string_view HttpServer::getContentTypeString(ContentType content_type) {
+    constexpr string_view types[] = {
+        "text/html",
+        "application/json",
+        "application/xml",
+        "text/plain",
+        "text/css",
+        "application/javascript",
+        "image/png",
+        "image/jpeg",
+        "image/gif",
+        "image/svg+xml",
+        "application/pdf",
+        "image/x-icon",
+    };
+
+    return types[static_cast<size_t>(content_type)];
+}
+
+void HttpServer::addRoute(string_view endpoint, Endpoint end) {
+    end.head = string(http::statusLine(200));
+    end.head += "Content-Type: ";
+    end.head += getContentTypeString(end.content_type);
+    end.head += "\r\n";
+
+    end.pattern = endpoint;
+
+    auto res = router.add(static_cast<size_t>(end.method), endpoint, endpoints.size());
+    if (!res) {
+        log.error("Route not added: {}", res.error());
+        return;
     }
 
-    return header;
-}
-
-string HttpServer::getContentTypeString(ContentType content_type) {
-    string return_type;
-    if (content_type == ContentType::Html) {
-        return_type = "text/html";
-    } else if (content_type == ContentType::Json) {
-        return_type = "application/json";
-    } else if (content_type == ContentType::Xml) {
-        return_type = "application/xml";
-    } else if (content_type == ContentType::Plain) {
-        return_type = "text/plain";
-    } else if (content_type == ContentType::Css) {
-        return_type = "text/css";
-    } else if (content_type == ContentType::JavaScript) {
-        return_type = "application/javascript";
-    } else if (content_type == ContentType::Png) {
-        return_type = "image/png";
-    } else if (content_type == ContentType::Jpeg) {
-        return_type = "image/jpeg";
-    } else if (content_type == ContentType::Gif) {
-        return_type = "image/gif";
-    } else if (content_type == ContentType::Svg) {
-        return_type = "image/svg+xml";
-    } else if (content_type == ContentType::Pdf) {
-        return_type = "application/pdf";
-    } else if (content_type == ContentType::Icon) {
-        return_type = "image/x-icon";
-    }
-
-    return return_type;
+    endpoints.push_back(std::move(end));
 }
 
 void HttpServer::closeSocket(int socket) {
     if (socket >= 0) {
         close(socket);
-        log.info(format("Socket closed: {}", socket));
+        log.debug("Socket closed: {}", socket);
     }
 }
@@ -1,84 +1,475 @@
+#include <string_view>
 #include <filesystem>
+#include <algorithm>
 #include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <format>
 #include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
 #include <print>
+#include <cerrno>
 #include <ctime>
+#include <mutex>
+
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "logger.hpp"
+#include "clock.hpp"
 
 namespace fs = std::filesystem;
 
+using std::string_view;
+using std::uint64_t;
+using std::int64_t;
 using std::string;
+using std::size_t;
 using std::cerr;
 
+struct Logger::Ring {
+    constexpr static size_t capacity = 1 << 16;
+    alignas(64) std::atomic<uint64_t> head {0};
+    alignas(64) std::atomic<uint64_t> tail {0};
+    char data[capacity];
+};
+
+namespace {
+    struct RecordHeader {
+        int64_t time_ns;
+        std::uint32_t length;
+        char log_type[4];
+    };
+
+    struct Record {
+        int64_t time_ns;
+        char log_type[4];
+        size_t offset;
+        size_t length;
+    };
+
+    constexpr size_t max_record_size = 16384;
+    constexpr string_view level_tags[] = { "TRC", "DBG", "INF", "WRN", "ERR" };
+    constexpr auto batch_interval = std::chrono::milliseconds(20);
+
+    std::atomic<uint64_t> next_logger_id {1};
+
+    thread_local std::vector<std::pair<uint64_t, void *>> local_rings;
+
+    void copyIn(char *ring, size_t capacity, uint64_t pos, const void *src, size_t size) {
+        size_t start = pos & (capacity - 1);
+        size_t first = std::min(size, capacity - start);
+        std::memcpy(ring + start, src, first);
+        std::memcpy(ring, static_cast<const char *>(src) + first, size - first);
+    }
+
+    void copyOut(const char *ring, size_t capacity, uint64_t pos, void *dst, size_t size) {
+        size_t start = pos & (capacity - 1);
+        size_t first = std::min(size, capacity - start);
+        std::memcpy(dst, ring + start, first);
+        std::memcpy(static_cast<char *>(dst) + first, ring, size - first);
+    }
+
+    // Formats straight into a ring, wrapping at the end and counting
+    // everything past `room` without storing it.
+    struct RingWriter {
+        using difference_type = std::ptrdiff_t;
+
+        char *data;
+        size_t mask;
+        uint64_t pos;
+        size_t room;
+        size_t written = 0;
+
+        RingWriter &operator*() {
+            return *this;
+        }
+
+        RingWriter &operator=(char c) {
+            if (written < room) {
+                data[(pos + written) & mask] = c;
+            }
+            return *this;
+        }
+
+        RingWriter &operator++() {
+            ++written;
+            return *this;
+        }
+
+        RingWriter operator++(int) {
+            RingWriter old = *this;
+            ++written;
+            return old;
+        }
+    };
+
+    int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // constructors
 ///////////////////////////////////////////////////////////////////////////////
-Logger::Logger(bool to_console, bool to_file) {
+Logger::Logger(bool to_console, bool to_file)
+    : Logger(to_console, to_file, LogMode::Sync, LogOverflow::Drop) {
+}
+
+Logger::Logger(
+    bool to_console,
+    bool to_file,
+    LogMode mode,
+    LogOverflow overflow
+) {
     this->to_console = to_console;
     this->to_file = to_file;
+    level = LogLevel::Info;
+    this->mode = mode;
+    this->overflow = overflow;
+    file_fd = -1;
+    id = next_logger_id.fetch_add(1);
+    running = false;
+    dropped = 0;
+    flush_requests = 0;
+    flushes_done = 0;
+    blocked = 0;
+
+    if (to_file) {
+        openFile();
+    }
+
+    if (mode == LogMode::Async && (to_console || to_file)) {
+        running = true;
+        writer = std::thread([this] {
+            run();
+        });
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// destructor
+///////////////////////////////////////////////////////////////////////////////
+Logger::~Logger() {
+    if (writer.joinable()) {
+        {
+            std::lock_guard lock(wake_mutex);
+            running = false;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+
+    if (file_fd >= 0) {
+        close(file_fd);
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // public methods
 ///////////////////////////////////////////////////////////////////////////////
-void Logger::info(string message) {
-    handleMessage(message, "INF");
+void Logger::setLevel(LogLevel level) {
+    this->level.store(level, std::memory_order_relaxed);
 }
 
-void Logger::error(string message) {
-    handleMessage(message, "ERR");
+bool Logger::enabled(LogLevel level) const {
+    return (to_console || to_file)
+        && level >= this->level.load(std::memory_order_relaxed);
+}
+
+void Logger::flush() {
+    if (!writer.joinable()) {
+        return;
+    }
+
+    std::unique_lock lock(wake_mutex);
+    uint64_t ticket = ++flush_requests;
+    wake.notify_all();
+    wake.wait(lock, [&] {
+        return flushes_done >= ticket;
+    });
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // private methods
 ///////////////////////////////////////////////////////////////////////////////
-string Logger::getDateTimeNow() {
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+void Logger::openFile() {
+    fs::path log_dir = "logs";
+    fs::path file_path = log_dir / "tcp_log.txt";
+
+    std::error_code ec;
+    fs::create_directory(log_dir, ec);
+
+    file_fd = open(
+        file_path.c_str(),
+        O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+        0644
+    );
+    if (file_fd < 0) {
+        println(cerr, "Error opening file");
+    }
+}
+
+string Logger::formatTime(int64_t time_ns) {
+    std::time_t seconds = time_ns / 1'000'000'000;
     std::tm local_time;
-    localtime_r(&now_c, &local_time);
+    localtime_r(&seconds, &local_time);
 
-    std::ostringstream out;
-    out << std::put_time(&local_time, "%m/%d/%Y %H:%M:%S");
+    char buffer[32];
+    size_t length = strftime(
+        buffer,
+        sizeof(buffer),
+        "%m/%d/%Y %H:%M:%S",
+        &local_time
+    );
 
-    return out.str();
+    return string(buffer, length);
 }
 
-void Logger::appendFile(string file_path, string message) {
-    std::ofstream file(file_path, std::ios::app);
-    if (!file) {
-        println(cerr, "Error opening file");
-    }
+void Logger::writeAll(int fd, string_view data) {
+    while (!data.empty()) {
+        ssize_t bytes = ::write(fd, data.data(), data.size());
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return;
+        }
 
-    std::ostringstream out;
-    out << message << "\n";
-    file << out.str();
+        data.remove_prefix(bytes);
+    }
 }
 
-void Logger::handleMessage(string message, string log_type) {
-    string now = getDateTimeNow();
-    std::ostringstream out;
-    out << "[" << now << " " << log_type << "]" << " " << message;
-    string msg = out.str();
+void Logger::write(LogLevel level, string_view fmt, std::format_args args) {
+    string_view log_type = level_tags[static_cast<int>(level)];
+
+    if (writer.joinable()) {
+        push(log_type, fmt, args);
+        return;
+    }
+
+    thread_local string line;
+    line.clear();
+    std::format_to(
+        std::back_inserter(line),
+        "[{} {}] ",
+        http::Clock::get().logTime(),
+        log_type
+    );
+    std::vformat_to(std::back_inserter(line), fmt, args);
+    line += '\n';
 
+    std::lock_guard lock(write_mutex);
     if (to_console) {
-        println("{}", msg);
+        writeAll(STDOUT_FILENO, line);
     }
 
-    if (to_file) {
-        fs::path log_dir = "logs";
-        fs::path log_filename = "tcp_log.txt";
-        fs::path file_path = log_dir / log_filename;
+    if (to_file && file_fd >= 0) {
+        writeAll(file_fd, line);
+    }
+}
 
-        if (!fs::exists(log_dir)) {
-            fs::create_directory(log_dir);
+Logger::Ring &Logger::localRing() {
+    for (auto &[owner, ring] : local_rings) {
+        if (owner == id) {
+            return *static_cast<Ring *>(ring);
         }
+    }
+
+    auto ring = std::make_unique<Ring>();
+    Ring *raw = ring.get();
+    {
+        std::lock_guard lock(rings_mutex);
+        rings.push_back(std::move(ring));
+    }
+
+    local_rings.emplace_back(id, raw);
+    return *raw;
+}
+
+void Logger::push(string_view log_type, string_view fmt, std::format_args args) {
+    Ring &ring = localRing();
+
+    RecordHeader header;
+    header.time_ns = nowNs();
+    std::memset(header.log_type, 0, sizeof(header.log_type));
+    std::memcpy(header.log_type, log_type.data(), std::min<size_t>(log_type.size(), 3));
+
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    size_t need = 0;
+
+    auto fits = [&] {
+        return head + need - ring.tail.load(std::memory_order_acquire) <= Ring::capacity;
+    };
+
+    while (true) {
+        size_t used = head - ring.tail.load(std::memory_order_acquire);
+        size_t free = Ring::capacity - used;
+        size_t room = free > sizeof(header)
+            ? std::min(free - sizeof(header), max_record_size)
+            : 0;
+
+        RingWriter out {ring.data, Ring::capacity - 1, head + sizeof(header), room};
+        out = std::vformat_to(out, fmt, args);
+
+        // Longer messages are cut at max_record_size rather than refused.
+        size_t length = std::min(out.written, max_record_size);
+        if (length <= room) {
+            header.length = length;
+            need = sizeof(header) + length;
+            break;
+        }
+
+        need = sizeof(header) + length;
+        if (overflow == LogOverflow::Drop) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        std::unique_lock lock(wake_mutex);
+        ++blocked;
+        wake.notify_all();
+        space.wait(lock, fits);
+        --blocked;
+    }
+
+    copyIn(ring.data, Ring::capacity, head, &header, sizeof(header));
+    ring.head.store(head + need, std::memory_order_release);
+
+    // The writer wakes on its own every batch interval; only nudge it
+    // when this thread's ring is filling up faster than that.
+    if (head + need - ring.tail.load(std::memory_order_relaxed) > Ring::capacity / 2) {
+        wake.notify_one();
+    }
+}
+
+bool Logger::drain(string &batch) {
+    std::vector<Record> records;
+    string messages;
+
+    {
+        std::lock_guard lock(rings_mutex);
+        for (auto &ring : rings) {
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+
+            while (tail < head) {
+                RecordHeader header;
+                copyOut(ring->data, Ring::capacity, tail, &header, sizeof(header));
+
+                Record record;
+                record.time_ns = header.time_ns;
+                std::memcpy(record.log_type, header.log_type, sizeof(record.log_type));
+                record.offset = messages.size();
+                record.length = header.length;
+
+                messages.resize(messages.size() + header.length);
+                copyOut(
+                    ring->data,
+                    Ring::capacity,
+                    tail + sizeof(header),
+                    messages.data() + record.offset,
+                    header.length
+                );
 
-        string file_path_str = file_path.string();
-        appendFile(file_path_str, msg);
+                records.push_back(record);
+                tail += sizeof(header) + header.length;
+            }
+
+            ring->tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    if (records.empty()) {
+        return false;
+    }
+
+    // Each ring is already in order; merge the threads back into one
+    // timeline before writing.
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.time_ns < b.time_ns;
+    });
+
+    http::Clock &clock = http::Clock::get();
+    int64_t second = -1;
+    string time_str;
+    for (const Record &record : records) {
+        if (record.time_ns / 1'000'000'000 != second) {
+            second = record.time_ns / 1'000'000'000;
+            time_str = second == clock.seconds()
+                ? string(clock.logTime())
+                : formatTime(record.time_ns);
+        }
+
+        std::format_to(
+            std::back_inserter(batch),
+            "[{} {}] {}\n",
+            time_str,
+            string_view(record.log_type),
+            string_view(messages.data() + record.offset, record.length)
+        );
+    }
+
+    return true;
+}
+
+void Logger::run() {
+    string batch;
+
+    while (true) {
+        bool stopping = !running;
+        uint64_t requested = flush_requests;
+
+        batch.clear();
+        bool drained = drain(batch);
+
+        if (drained && blocked > 0) {
+            std::lock_guard lock(wake_mutex);
+            space.notify_all();
+        }
+
+        uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            std::format_to(
+                std::back_inserter(batch),
+                "[{} ERR] {} log record(s) dropped, ring buffer full\n",
+                http::Clock::get().logTime(),
+                lost
+            );
+        }
+
+        if (!batch.empty()) {
+            if (to_console) {
+                writeAll(STDOUT_FILENO, batch);
+            }
+
+            if (to_file && file_fd >= 0) {
+                writeAll(file_fd, batch);
+            }
+        }
+
+        if (requested > flushes_done) {
+            std::lock_guard lock(wake_mutex);
+            flushes_done = requested;
+            wake.notify_all();
+        }
+
+        if (stopping) {
+            break;
+        }
+
+        if (!drained) {
+            std::unique_lock lock(wake_mutex);
+            wake.wait_for(lock, batch_interval, [&] {
+                return !running || flush_requests != requested || blocked > 0;
+            });
+        }
     }
 }
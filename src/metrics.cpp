@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <format>
+#include <string>
+
+#include "metrics.hpp"
+
+using std::uint64_t;
+using std::string;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // pool stats
+    ///////////////////////////////////////////////////////////////////////////
+    double PoolStats::hitRate() const {
+        uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    string formatMetrics(const Metrics &metrics) {
+        return std::format(
+            "http_connections {}\n"
+            "http_connection_slot_hits {}\n"
+            "http_connection_slot_misses {}\n"
+            "http_connection_slot_hit_rate {:.4f}\n"
+            "http_buffer_hits {}\n"
+            "http_buffer_misses {}\n"
+            "http_buffer_hit_rate {:.4f}\n"
+            "http_pooled_buffer_bytes {}\n"
+            "http_compressed_responses {}\n"
+            "http_compression_bytes_in {}\n"
+            "http_compression_bytes_out {}\n"
+            "http_compression_cpu_seconds {:.6f}\n",
+            metrics.connections,
+            metrics.connection_slots.hits,
+            metrics.connection_slots.misses,
+            metrics.connection_slots.hitRate(),
+            metrics.buffers.hits,
+            metrics.buffers.misses,
+            metrics.buffers.hitRate(),
+            metrics.pooled_buffer_bytes,
+            metrics.compression.responses,
+            metrics.compression.bytes_in,
+            metrics.compression.bytes_out,
+            metrics.compression.cpu_ns / 1e9
+        );
+    }
+}
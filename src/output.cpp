@@ -0,0 +1,413 @@
+#include <string_view>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <cerrno>
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "output.hpp"
+
+using std::string_view;
+using std::shared_ptr;
+using std::string;
+using std::size_t;
+
+namespace http {
+    struct SplicePipe {
+        int read_fd = -1;
+        int write_fd = -1;
+
+        SplicePipe() {
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0) {
+                read_fd = fds[0];
+                write_fd = fds[1];
+            }
+        }
+
+        ~SplicePipe() {
+            if (read_fd >= 0) {
+                close(read_fd);
+            }
+
+            if (write_fd >= 0) {
+                close(write_fd);
+            }
+        }
+    };
+
+    ///////////////////////////////////////////////////////////////////////////
+    // file handle
+    ///////////////////////////////////////////////////////////////////////////
+    FileHandle::FileHandle(int fd) {
+        fd_ = fd;
+    }
+
+    FileHandle::~FileHandle() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    int FileHandle::get() const {
+        return fd_;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // segment
+    ///////////////////////////////////////////////////////////////////////////
+    const char *OutputQueue::Segment::data() const {
+        if (kind == SegmentKind::Owned) {
+            return owned.data();
+        }
+
+        if (kind == SegmentKind::Copied) {
+            return copied.data();
+        }
+
+        return borrowed.data();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void OutputQueue::append(string data) {
+        if (data.size() <= coalesce_limit_) {
+            appendCopy(data);
+            return;
+        }
+
+        Segment segment;
+        segment.kind = SegmentKind::Owned;
+        segment.size = data.size();
+        segment.owned = std::move(data);
+        push(std::move(segment));
+    }
+
+    void OutputQueue::append(shared_ptr<const string> owner, string_view data) {
+        if (data.empty()) {
+            return;
+        }
+
+        Segment segment;
+        segment.kind = SegmentKind::Borrowed;
+        segment.owner = std::move(owner);
+        segment.borrowed = data;
+        segment.size = data.size();
+        push(std::move(segment));
+    }
+
+    void OutputQueue::appendStatic(string_view data) {
+        append(nullptr, data);
+    }
+
+    void OutputQueue::appendCopy(string_view data) {
+        if (data.empty()) {
+            return;
+        }
+
+        // a gathered segment is still being sent from and must not move
+        if (segments_.size() - head_ > gathered_) {
+            Segment &last = segments_.back();
+            if (last.kind == SegmentKind::Copied
+                && last.size + data.size() <= coalesce_limit_) {
+                last.copied.append(data.data(), data.size());
+                last.size += data.size();
+                pending_ += data.size();
+                return;
+            }
+        }
+
+        Segment segment;
+        segment.kind = SegmentKind::Copied;
+        segment.copied.append(data.data(), data.size());
+        segment.size = data.size();
+        push(std::move(segment));
+    }
+
+    void OutputQueue::appendFile(
+        shared_ptr<FileHandle> file,
+        size_t offset,
+        size_t size
+    ) {
+        if (size == 0) {
+            return;
+        }
+
+        Segment segment;
+        segment.kind = SegmentKind::File;
+        segment.file = std::move(file);
+        segment.file_offset = offset;
+        segment.size = size;
+        push(std::move(segment));
+    }
+
+    void OutputQueue::append(OutputQueue &&other) {
+        for (size_t i = other.head_; i < other.segments_.size(); ++i) {
+            Segment &segment = other.segments_[i];
+            if (segment.kind == SegmentKind::Copied) {
+                appendCopy(string_view(segment.data() + segment.sent, segment.size - segment.sent));
+            } else {
+                push(std::move(segment));
+            }
+        }
+
+        other.clear();
+    }
+
+    bool OutputQueue::empty() const {
+        return head_ == segments_.size();
+    }
+
+    size_t OutputQueue::pending() const {
+        return pending_;
+    }
+
+    FlushStatus OutputQueue::flush(int fd) {
+        while (!empty()) {
+            if (segments_[head_].kind == SegmentKind::File) {
+                FlushStatus status = flushFile(fd, segments_[head_]);
+                if (status != FlushStatus::Done) {
+                    return status;
+                }
+
+                popFront();
+                continue;
+            }
+
+            iovec iov[max_iovecs_];
+            int count = 0;
+            int flags = MSG_NOSIGNAL;
+            size_t length = 0;
+            for (size_t i = head_; i < segments_.size(); ++i) {
+                const Segment &segment = segments_[i];
+                if (segment.kind == SegmentKind::File) {
+                    // Hold the headers back so they share a packet with
+                    // the start of the file.
+                    flags |= MSG_MORE;
+                    break;
+                }
+
+                if (count == max_iovecs_) {
+                    break;
+                }
+
+                iov[count].iov_base = const_cast<char *>(segment.data() + segment.sent);
+                iov[count].iov_len = segment.size - segment.sent;
+                length += iov[count].iov_len;
+                ++count;
+            }
+
+            msghdr message {};
+            message.msg_iov = iov;
+            message.msg_iovlen = count;
+
+            ssize_t bytes = sendmsg(fd, &message, flags);
+            if (bytes < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return FlushStatus::Blocked;
+                }
+
+                return FlushStatus::Error;
+            }
+
+            consume(bytes);
+
+            // A short write means the send buffer is full and the kernel
+            // will report the socket writable again; asking once more
+            // would only fetch the EAGAIN.
+            if (static_cast<size_t>(bytes) < length) {
+                return FlushStatus::Blocked;
+            }
+        }
+
+        return FlushStatus::Done;
+    }
+
+    int OutputQueue::gather(iovec *iov, int max, int &flags) {
+        int count = 0;
+        for (size_t i = head_; i < segments_.size(); ++i) {
+            const Segment &segment = segments_[i];
+            if (segment.kind == SegmentKind::File) {
+                flags |= MSG_MORE;
+                break;
+            }
+
+            if (count == max) {
+                break;
+            }
+
+            iov[count].iov_base = const_cast<char *>(segment.data() + segment.sent);
+            iov[count].iov_len = segment.size - segment.sent;
+            ++count;
+        }
+
+        gathered_ = count;
+        return count;
+    }
+
+    void OutputQueue::complete(size_t bytes) {
+        consume(bytes);
+        gathered_ = 0;
+    }
+
+    bool OutputQueue::frontIsFile() const {
+        return !empty() && segments_[head_].kind == SegmentKind::File;
+    }
+
+    void OutputQueue::clear() {
+        segments_.clear();
+        head_ = 0;
+        pending_ = 0;
+        gathered_ = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    FlushStatus OutputQueue::flushFile(int fd, Segment &segment) {
+        if (segment.pipe) {
+            return spliceFile(fd, segment);
+        }
+
+        while (segment.sent < segment.size) {
+            off_t offset = segment.file_offset + segment.sent;
+            size_t chunk = std::min(sendfile_chunk_size_, segment.size - segment.sent);
+            ssize_t bytes = sendfile(fd, segment.file->get(), &offset, chunk);
+
+            if (bytes > 0) {
+                segment.sent += bytes;
+                pending_ -= bytes;
+                continue;
+            }
+
+            if (bytes == 0) {
+                return FlushStatus::Error;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FlushStatus::Blocked;
+            }
+
+            if (errno == EINVAL || errno == ENOSYS) {
+                segment.pipe = std::make_shared<SplicePipe>();
+                return spliceFile(fd, segment);
+            }
+
+            return FlushStatus::Error;
+        }
+
+        return FlushStatus::Done;
+    }
+
+    FlushStatus OutputQueue::spliceFile(int fd, Segment &segment) {
+        SplicePipe &pipe = *segment.pipe;
+        if (pipe.read_fd < 0) {
+            return FlushStatus::Error;
+        }
+
+        while (segment.sent < segment.size) {
+            size_t unread = segment.size - segment.sent - segment.in_pipe;
+            if (segment.in_pipe == 0 && unread > 0) {
+                loff_t offset = segment.file_offset + segment.sent;
+                ssize_t bytes = splice(
+                    segment.file->get(),
+                    &offset,
+                    pipe.write_fd,
+                    nullptr,
+                    std::min(splice_chunk_size_, unread),
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+                );
+
+                if (bytes < 0 && errno == EINTR) {
+                    continue;
+                }
+
+                if (bytes <= 0) {
+                    return FlushStatus::Error;
+                }
+
+                segment.in_pipe = bytes;
+            }
+
+            ssize_t bytes = splice(
+                pipe.read_fd,
+                nullptr,
+                fd,
+                nullptr,
+                segment.in_pipe,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE
+            );
+
+            if (bytes > 0) {
+                segment.in_pipe -= bytes;
+                segment.sent += bytes;
+                pending_ -= bytes;
+                continue;
+            }
+
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return FlushStatus::Blocked;
+            }
+
+            return FlushStatus::Error;
+        }
+
+        return FlushStatus::Done;
+    }
+
+    void OutputQueue::consume(size_t bytes) {
+        pending_ -= bytes;
+
+        while (bytes > 0) {
+            Segment &front = segments_[head_];
+            size_t left = front.size - front.sent;
+            if (bytes < left) {
+                front.sent += bytes;
+                return;
+            }
+
+            bytes -= left;
+            popFront();
+        }
+    }
+
+    void OutputQueue::push(Segment segment) {
+        // reuse the consumed front rather than growing past it
+        if (head_ > 0 && segments_.size() == segments_.capacity()) {
+            segments_.erase(segments_.begin(), segments_.begin() + head_);
+            head_ = 0;
+        }
+
+        pending_ += segment.size;
+        segments_.push_back(std::move(segment));
+    }
+
+    void OutputQueue::popFront() {
+        segments_[head_] = Segment();
+        ++head_;
+
+        if (head_ == segments_.size()) {
+            segments_.clear();
+            head_ = 0;
+        }
+    }
+}
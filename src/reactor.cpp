@@ -0,0 +1,1882 @@
+#include <functional>
+#include <algorithm>
+#include <charconv>
+#include <expected>
+#include <exception>
+#include <optional>
+#include <cstring>
+#include <chrono>
+#include <string_view>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <limits>
+#include <mutex>
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#include "http_parser.hpp"
+#include "compression.hpp"
+#include "access_log.hpp"
+#include "thread_pool.hpp"
+#include "timer_wheel.hpp"
+#include "connection.hpp"
+#include "websocket.hpp"
+#include "output.hpp"
+#include "logger.hpp"
+#include "reactor.hpp"
+#include "headers.hpp"
+#include "async.hpp"
+#include "clock.hpp"
+#include "uring.hpp"
+
+using std::string_view;
+using std::shared_ptr;
+using std::unexpected;
+using std::optional;
+using std::expected;
+using std::uint32_t;
+using std::uint64_t;
+using std::string;
+
+namespace http {
+    namespace {
+        // io_uring user_data: what the operation was, the descriptor it was
+        // for, and the low bits of the connection (or wait) id so that
+        // completions for a closed and reused descriptor can be told apart.
+        enum class Op : uint64_t {
+            Accept = 1,
+            Receive,
+            Send,
+            PollOut,
+            Close,
+            Watch,
+            Waiter,
+            Cancel,
+        };
+
+        uint64_t tag(Op op, int fd, uint64_t id) {
+            return static_cast<uint64_t>(op) << 56
+                | (static_cast<uint64_t>(fd) & 0xFFFFFF) << 32
+                | (id & 0xFFFFFFFF);
+        }
+
+        Op tagOp(uint64_t user_data) {
+            return static_cast<Op>(user_data >> 56);
+        }
+
+        int tagFd(uint64_t user_data) {
+            return static_cast<int>((user_data >> 32) & 0xFFFFFF);
+        }
+
+        bool tagMatches(uint64_t user_data, uint64_t id) {
+            return (user_data & 0xFFFFFFFF) == (id & 0xFFFFFFFF);
+        }
+
+        constexpr string_view bad_request_response =
+            "HTTP/1.1 400 Bad Request\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 15\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "400 Bad Request";
+
+        constexpr string_view bad_handshake_response =
+            "HTTP/1.1 400 Bad Request\r\n"
+            "Sec-WebSocket-Version: 13\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 15\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "400 Bad Request";
+
+        constexpr string_view payload_too_large_response =
+            "HTTP/1.1 413 Content Too Large\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 21\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "413 Content Too Large";
+
+        constexpr string_view header_too_large_response =
+            "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 35\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "431 Request Header Fields Too Large";
+
+        constexpr string_view version_not_supported_response =
+            "HTTP/1.1 505 HTTP Version Not Supported\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 30\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "505 HTTP Version Not Supported";
+
+        constexpr string_view request_timeout_response =
+            "HTTP/1.1 408 Request Timeout\r\n"
+            "Content-Type: text/plain\r\n"
+            "Content-Length: 19\r\n"
+            "Connection: close\r\n"
+            "\r\n"
+            "408 Request Timeout";
+
+        constexpr string_view last_chunk = "0\r\n\r\n";
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    Reactor::Reactor(
+        Logger &log,
+        ReactorConfig config,
+        RequestHandler on_request,
+        UpgradeHandler on_upgrade
+    ) : log_(log),
+        config_(config),
+        on_request_(std::move(on_request)),
+        on_upgrade_(std::move(on_upgrade)) {
+        server_socket_ = -1;
+        epoll_fd_ = -1;
+        wake_fd_ = -1;
+        next_connection_id_ = 1;
+        epoch_ = std::chrono::steady_clock::now();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    Reactor::~Reactor() {
+        // a submitted close may already have released the descriptor
+        for (int fd : connections_.live()) {
+            if (!connections_.find(fd)->close_submitted) {
+                close(fd);
+            }
+        }
+
+        // suspended coroutines unregister themselves from the members
+        // below as they are destroyed
+        connections_.clear();
+
+        Completion *completion = completions_.popAll();
+        while (completion) {
+            Completion *next = completion->next;
+            delete completion;
+            completion = next;
+        }
+
+        if (wake_fd_ >= 0) {
+            close(wake_fd_);
+        }
+
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> Reactor::open(int server_socket) {
+        if (server_socket < 0) {
+            log_.error("Reactor opened without a listening socket");
+            return unexpected("Reactor opened without a listening socket");
+        }
+
+        server_socket_ = server_socket;
+
+        int non_blocking_res = setNonBlocking(server_socket_);
+        if (non_blocking_res < 0) {
+            log_.error("Nonblocking failed");
+            return unexpected("Nonblocking failed");
+        }
+
+        if (config_.backend == Backend::IoUring) {
+            auto uring_res = openUring();
+            if (!uring_res) {
+                log_.warn("io_uring unavailable, using epoll: {}", uring_res.error());
+                uring_.reset();
+            }
+        }
+
+        if (!uring_) {
+            epoll_fd_ = epoll_create1(0);
+            if (epoll_fd_ < 0) {
+                log_.error("epoll_create1 failed");
+                return unexpected("epoll_create1 failed");
+            }
+
+            epoll_event event {};
+            event.events = EPOLLIN;
+            event.data.fd = server_socket_;
+            int ctl_res = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_socket_, &event);
+            if (ctl_res < 0) {
+                log_.error("epoll_ctl failed: {}", strerror(errno));
+                return unexpected("epoll_ctl failed");
+            }
+        }
+
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            log_.error("eventfd failed: {}", strerror(errno));
+            return unexpected("eventfd failed");
+        }
+
+        return watch(wake_fd_, [this] {
+            handleWake();
+        });
+    }
+
+    expected<void, string> Reactor::watch(int fd, std::function<void()> on_readable) {
+        if (epoll_fd_ < 0 && !uring_) {
+            return unexpected("Reactor must be opened before watching a descriptor");
+        }
+
+        if (uring_) {
+            watchers_[fd] = std::move(on_readable);
+            armPoll(fd, POLLIN, tag(Op::Watch, fd, 0));
+            return {};
+        }
+
+        epoll_event event {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        int ctl_res = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        if (ctl_res < 0) {
+            log_.error("epoll_ctl failed: {}", strerror(errno));
+            return unexpected("epoll_ctl failed");
+        }
+
+        watchers_[fd] = std::move(on_readable);
+        return {};
+    }
+
+    expected<void, string> Reactor::run() {
+        now_ = std::chrono::steady_clock::now();
+
+        if (uring_) {
+            return runUring();
+        }
+
+        while (true) {
+            int n = epoll_wait(epoll_fd_, events_, max_events_, nextTimeout());
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                log_.error("epoll_wait failed: {}", strerror(errno));
+                return unexpected("epoll_wait failed");
+            }
+
+            now_ = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < n; ++i) {
+                int fd = events_[i].data.fd;
+                if (fd == server_socket_) {
+                    acceptConnections();
+                    continue;
+                }
+
+                Connection *found = connections_.find(fd);
+                if (!found) {
+                    auto watcher = watchers_.find(fd);
+                    if (watcher != watchers_.end()) {
+                        watcher->second();
+                        continue;
+                    }
+
+                    auto waiter = fd_waiters_.find(fd);
+                    if (waiter != fd_waiters_.end()) {
+                        Wake wake = waiter->second;
+                        fd_waiters_.erase(waiter);
+                        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                        wakeWaiter(wake, true);
+                    }
+
+                    continue;
+                }
+
+                Connection &conn = *found;
+                uint32_t ready = events_[i].events;
+
+                if (ready & EPOLLERR) {
+                    closeConnection(fd);
+                    continue;
+                }
+
+                // A hangup can come with the client's last pipelined
+                // requests still unread; read them first and let the
+                // read that returns 0 close the connection.
+                if (ready & (EPOLLIN | EPOLLHUP)) {
+                    handleReadable(conn);
+                }
+
+                if ((ready & EPOLLOUT) && conn.state == ConnectionState::Writing) {
+                    handleWritable(conn);
+                }
+
+                if (conn.state == ConnectionState::Closing) {
+                    closeConnection(fd);
+                }
+            }
+
+            runUnread();
+            runTimers();
+            runReady();
+        }
+
+        return {};
+    }
+
+    void Reactor::broadcast(
+        const WebSocketHandler *target,
+        shared_ptr<const string> frame
+    ) {
+        if (wake_fd_ < 0) {
+            return;
+        }
+
+        {
+            std::lock_guard lock(broadcast_mutex_);
+            broadcasts_.emplace_back(target, std::move(frame));
+        }
+
+        uint64_t one = 1;
+        write(wake_fd_, &one, sizeof(one));
+    }
+
+    bool Reactor::wait(
+        Context &context,
+        WaitKind kind,
+        int fd,
+        std::chrono::steady_clock::time_point deadline
+    ) {
+        Wake wake {context.fd_, context.connection_id_, context.wait_id_};
+
+        if (kind == WaitKind::Timer) {
+            timers_.arm(context.timer_, tick(deadline), context.fd_);
+            return true;
+        }
+
+        if (kind == WaitKind::Yield) {
+            ready_.push_back(wake);
+            return true;
+        }
+
+        // Once the body is over the wait fails straight away; otherwise
+        // the next piece is fetched from the loop, not from in here.
+        if (kind == WaitKind::Body) {
+            Connection *found = connections_.find(context.fd_);
+            if (!found || found->id != context.connection_id_ || !found->body_streaming) {
+                return false;
+            }
+
+            found->body_waiting = true;
+            ready_.push_back(wake);
+            return true;
+        }
+
+        if (kind == WaitKind::Drain) {
+            context.draining_ = true;
+            return true;
+        }
+
+        if (kind != WaitKind::Readable && kind != WaitKind::Writable) {
+            return false;
+        }
+
+        if (fd < 0
+            || fd == server_socket_
+            || connections_.contains(fd)
+            || watchers_.contains(fd)
+            || fd_waiters_.contains(fd)) {
+            return false;
+        }
+
+        if (uring_) {
+            uint32_t events = kind == WaitKind::Readable ? POLLIN : POLLOUT;
+            armPoll(fd, events, tag(Op::Waiter, fd, wake.wait_id));
+            fd_waiters_[fd] = wake;
+            context.wait_fd_ = fd;
+            return true;
+        }
+
+        epoll_event event {};
+        event.events = (kind == WaitKind::Readable ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            log_.warn("Could not wait on descriptor {}: {}", fd, strerror(errno));
+            return false;
+        }
+
+        fd_waiters_[fd] = wake;
+        context.wait_fd_ = fd;
+        return true;
+    }
+
+    void Reactor::cancel(Context &context) {
+        context.timer_.cancel();
+        if (context.wait_fd_ < 0) {
+            return;
+        }
+
+        fd_waiters_.erase(context.wait_fd_);
+        if (uring_) {
+            io_uring_sqe *sqe = uring_->sqe();
+            if (!sqe) {
+                context.wait_fd_ = -1;
+                return;
+            }
+
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = tag(Op::Waiter, context.wait_fd_, context.wait_id_);
+            sqe->user_data = tag(Op::Cancel, context.wait_fd_, 0);
+        } else {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, context.wait_fd_, nullptr);
+        }
+        context.wait_fd_ = -1;
+    }
+
+    WaitKind Reactor::send(Context &context, string data, bool chunk) {
+        Connection *found = connections_.find(context.fd_);
+        if (!found || found->id != context.connection_id_) {
+            return WaitKind::Failed;
+        }
+
+        Connection &conn = *found;
+        if (conn.state == ConnectionState::Closing || conn.close_queued) {
+            return WaitKind::Failed;
+        }
+
+        // The framing goes in beside the data rather than around a copy of
+        // it, and small pieces coalesce, so a chunk is one gathered write.
+        size_t before = conn.out.pending();
+        if (chunk) {
+            char line[24];
+            char *end = std::to_chars(line, line + 16, data.size(), 16).ptr;
+            *end++ = '\r';
+            *end++ = '\n';
+            conn.out.appendCopy(string_view(line, end - line));
+            conn.out.append(std::move(data));
+            conn.out.appendStatic("\r\n");
+        } else {
+            conn.out.append(std::move(data));
+        }
+        context.sent_ += conn.out.pending() - before;
+
+        // Nothing is written from here; whatever the handler queues goes
+        // out together when it next suspends or finishes.
+        return conn.out.pending() > stream_watermark_ ? WaitKind::Drain : WaitKind::Done;
+    }
+
+    size_t Reactor::connectionCount() const {
+        return connections_.openCount();
+    }
+
+    PoolStats Reactor::connectionSlots() const {
+        return connections_.stats();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> Reactor::openUring() {
+        uring_ = std::make_unique<Uring>();
+
+        auto open_res = uring_->open(ring_entries_);
+        if (!open_res) {
+            return open_res;
+        }
+
+        auto buffers_res = uring_->provideBuffers(ring_buffers_, buffer_size_, buffer_group_);
+        if (!buffers_res) {
+            return buffers_res;
+        }
+
+        armAccept();
+        log_.info("Event loop using io_uring");
+        return {};
+    }
+
+    expected<void, string> Reactor::runUring() {
+        while (true) {
+            // everything queued since the last turn goes in with the wait
+            int res = uring_->submitAndWait(nextTimeout());
+            if (res < 0) {
+                log_.error("io_uring_enter failed: {}", strerror(-res));
+                return unexpected("io_uring_enter failed");
+            }
+
+            now_ = std::chrono::steady_clock::now();
+
+            unsigned n = 0;
+            do {
+                n = uring_->completions(cqes_, max_events_);
+                for (unsigned i = 0; i < n; ++i) {
+                    handleCompletion(cqes_[i]);
+                }
+            } while (n == max_events_);
+
+            runTimers();
+            runReady();
+        }
+
+        return {};
+    }
+
+    void Reactor::acceptConnections() {
+        while (true) {
+            int client_socket = accept(server_socket_, nullptr, nullptr);
+            if (client_socket < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log_.error("Accept failed: {}", strerror(errno));
+                }
+
+                return;
+            }
+
+            setNonBlocking(client_socket);
+            addConnection(client_socket);
+        }
+    }
+
+    Connection &Reactor::addConnection(int fd) {
+        Connection &conn = connections_.acquire(fd);
+        conn.fd = fd;
+        conn.id = next_connection_id_++;
+        conn.parser = RequestParser(config_.max_header_size);
+        conn.reading = Timeout::Header;
+        setTimeout(conn, Timeout::Header);
+
+        if (uring_) {
+            armReceive(conn);
+        } else {
+            epoll_event client_event {};
+            client_event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            client_event.data.fd = fd;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &client_event);
+        }
+
+        log_.debug("Client socket created: {}", fd);
+        return conn;
+    }
+
+    void Reactor::handleReadable(Connection &conn) {
+        if (conn.state == ConnectionState::Closing || conn.close_after_write) {
+            return;
+        }
+
+        // A request out on the pool keeps the rest of the pipeline
+        // waiting; leave further input in the socket until it is back.
+        // A coroutine reading its body takes it a window at a time.
+        bool streaming = conn.in_flight && conn.body_streaming;
+        if (conn.out.pending() > max_pending_output_
+            || (conn.in_flight && !streaming)
+            || (streaming && conn.in.size() >= body_window_)) {
+            conn.read_paused = true;
+
+            // a multishot receive keeps delivering until it is cancelled
+            if (uring_ && conn.recv_armed) {
+                cancelRequest(tag(Op::Receive, conn.fd, conn.id));
+            }
+            return;
+        }
+
+        bool peer_closed = false;
+
+        if (uring_) {
+            // the completions have already appended whatever arrived
+            peer_closed = conn.peer_closed;
+            if (!conn.recv_armed && !peer_closed) {
+                armReceive(conn);
+            }
+        }
+
+        // Reads land straight in a pooled buffer, and a connection that
+        // turns up nothing hands it back rather than holding it idle. One
+        // burst takes about a request head, or a window while a body comes
+        // in, and the parser sees it before the socket is read any further.
+        size_t burst = conn.body_buffering || streaming
+            ? body_window_
+            : config_.max_header_size;
+        size_t burst_read = 0;
+        bool unread = false;
+
+        while (!uring_) {
+            conn.in.reserve(min_read_room_);
+            ssize_t bytes = read(conn.fd, conn.in.tail(), conn.in.room());
+            if (bytes > 0) {
+                conn.in.commit(bytes);
+                if (streaming && conn.in.size() >= body_window_) {
+                    conn.read_paused = true;
+                    break;
+                }
+
+                burst_read += bytes;
+                if (burst_read >= burst) {
+                    unread = true;
+                    break;
+                }
+
+                continue;
+            }
+
+            if (conn.in.empty()) {
+                conn.in.reset();
+            }
+
+            if (bytes == 0) {
+                peer_closed = true;
+                break;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            log_.error(
+                "Error reading from socket {}: {}",
+                conn.fd,
+                strerror(errno)
+            );
+            conn.state = ConnectionState::Closing;
+            return;
+        }
+
+        if (streaming) {
+            if (peer_closed) {
+                conn.peer_closed = true;
+                conn.close_after_write = true;
+            }
+
+            if (conn.body_waiting && (!conn.in.empty() || peer_closed)) {
+                ready_.push_back({conn.fd, conn.id, conn.async->context.wait_id_});
+            }
+            return;
+        }
+
+        processRequests(conn);
+
+        if (peer_closed) {
+            if (conn.state == ConnectionState::Writing) {
+                conn.close_after_write = true;
+            } else {
+                conn.state = ConnectionState::Closing;
+            }
+        }
+
+        // an edge-triggered socket will not report what is left again
+        if (unread && conn.state != ConnectionState::Closing) {
+            unread_.push_back({conn.fd, conn.id});
+        }
+    }
+
+    void Reactor::handleWritable(Connection &conn) {
+        FlushStatus status = uring_ ? submitSend(conn) : conn.out.flush(conn.fd);
+
+        if (conn.async
+            && conn.async->context.draining_
+            && conn.out.pending() <= stream_watermark_) {
+            Context &context = conn.async->context;
+            context.draining_ = false;
+            ready_.push_back({conn.fd, conn.id, context.wait_id_});
+        }
+
+        if (status == FlushStatus::Blocked) {
+            setTimeout(conn, Timeout::Write);
+            return;
+        }
+
+        if (status == FlushStatus::Error) {
+            conn.state = ConnectionState::Closing;
+            return;
+        }
+
+        if (conn.close_after_write) {
+            conn.state = ConnectionState::Closing;
+            return;
+        }
+
+        conn.state = ConnectionState::Reading;
+        setTimeout(conn, conn.reading);
+
+        if (conn.read_paused) {
+            conn.read_paused = false;
+            handleReadable(conn);
+        }
+    }
+
+    void Reactor::processRequests(Connection &conn) {
+        bool body_pending = false;
+
+        while (!conn.close_after_write && !conn.websocket && !conn.in_flight) {
+            string_view pending(
+                conn.in.data() + conn.in_offset,
+                conn.in.size() - conn.in_offset
+            );
+
+            ParseStatus status = conn.parser.parse(pending, head_);
+            if (status == ParseStatus::Incomplete) {
+                break;
+            }
+
+            if (status == ParseStatus::Error) {
+                log_.warn("Malformed request from client {}", conn.fd);
+                reject(conn, ParseStatus::Error, accessMethod(head_.method));
+                break;
+            }
+
+            if (status == ParseStatus::TooLarge) {
+                log_.warn("Request head from client {} is too large", conn.fd);
+                reject(conn, header_too_large_response, 431, AccessMethod::Other);
+                break;
+            }
+
+            if (status == ParseStatus::UnsupportedVersion) {
+                log_.warn("Client {} sent unsupported version {}", conn.fd, head_.version);
+                reject(conn, version_not_supported_response, 505, accessMethod(head_.method));
+                break;
+            }
+
+            // A handler that wants the body whole has it decoded in place
+            // behind the head; a coroutine reads it as it arrives instead.
+            if (conn.body_buffering) {
+                ParseStatus body_status = collectBody(conn);
+                if (body_status == ParseStatus::Incomplete) {
+                    body_pending = true;
+                    break;
+                }
+
+                if (body_status != ParseStatus::Complete) {
+                    reject(conn, body_status, accessMethod(head_.method));
+                    break;
+                }
+            } else {
+                ParseStatus body_status = conn.body.start(head_, config_.max_body_size);
+                if (body_status == ParseStatus::TooLarge) {
+                    reject(conn, body_status, accessMethod(head_.method));
+                    break;
+                }
+
+                log_.debug(
+                    "Received request from client {}: {} {} {}",
+                    conn.fd,
+                    head_.method,
+                    head_.target,
+                    head_.version
+                );
+            }
+
+            size_t request_length = head_.length + conn.body_raw;
+
+            if (on_upgrade_ && isWebSocketUpgrade(head_)) {
+                const WebSocketHandler *handler = on_upgrade_(head_);
+                if (handler) {
+                    conn.in_offset += request_length;
+                    upgradeConnection(conn, *handler);
+                    break;
+                }
+            }
+
+            bool keep_alive =
+                conn.requests_served + 1 < config_.max_keep_alive_requests;
+            ResponseInfo info;
+            auto start = now_;
+            size_t before = conn.out.pending();
+            Deferred deferred = on_request_(head_, keep_alive, conn.out, info, arena_);
+
+            // whatever the handler built there has been copied out
+            arena_.reset();
+
+            if (deferred.needs_body) {
+                conn.body_buffering = true;
+                continue;
+            }
+
+            conn.requests_served++;
+            conn.in_offset += request_length;
+            conn.body_buffering = false;
+            conn.body_raw = 0;
+
+            if (deferred.coroutine) {
+                conn.body_streaming = !head_.body_ready;
+                startAsync(conn, deferred, keep_alive, info, start);
+                if (conn.in_flight) {
+                    break;
+                }
+
+                continue;
+            }
+
+            if (deferred.job && config_.pool) {
+                dispatch(conn, std::move(deferred.job), keep_alive, start);
+                break;
+            }
+
+            if (deferred.job) {
+                deferred.job(conn.out, info, keep_alive);
+            }
+
+            if (config_.access_log) {
+                recordAccess(
+                    conn.fd,
+                    accessMethod(head_.method),
+                    info,
+                    conn.out.pending() - before,
+                    start
+                );
+            }
+
+            if (!keep_alive) {
+                conn.close_after_write = true;
+            }
+        }
+
+        if (conn.in_offset > 0) {
+            conn.in.consume(conn.in_offset);
+            conn.in_offset = 0;
+        }
+
+        // The header and body deadlines run from the first byte of the
+        // request, so trickling it in a byte at a time does not help.
+        if (conn.body_streaming) {
+            conn.reading = Timeout::Body;
+        } else if (conn.websocket || conn.in_flight || conn.close_after_write) {
+            conn.reading = Timeout::None;
+        } else if (conn.in.empty()) {
+            conn.reading = Timeout::Idle;
+        } else {
+            conn.reading = body_pending ? Timeout::Body : Timeout::Header;
+        }
+        setTimeout(conn, conn.reading);
+
+        if (conn.websocket) {
+            processFrames(conn);
+            return;
+        }
+
+        if (!conn.out.empty()) {
+            conn.state = ConnectionState::Writing;
+            handleWritable(conn);
+        }
+    }
+
+    ParseStatus Reactor::collectBody(Connection &conn) {
+        size_t body_start = conn.in_offset + head_.length;
+        ParseStatus status = ParseStatus::Incomplete;
+
+        // Decoded bytes never get ahead of the raw ones, so each piece
+        // moves down over the framing in front of it.
+        while (body_start + conn.body_raw < conn.in.size()) {
+            char *body = conn.in.data() + body_start;
+            size_t decoded = conn.body.size();
+            size_t used = 0;
+            string_view data;
+            status = conn.body.read(
+                string_view(
+                    body + conn.body_raw,
+                    conn.in.size() - body_start - conn.body_raw
+                ),
+                used,
+                data
+            );
+
+            if (data.data() != body + decoded) {
+                std::memmove(body + decoded, data.data(), data.size());
+            }
+            conn.body_raw += used;
+
+            if (status != ParseStatus::Incomplete || used == 0) {
+                break;
+            }
+        }
+
+        // the framing left behind goes, so it cannot pile up
+        size_t decoded = conn.body.size();
+        if (conn.body_raw > decoded) {
+            conn.in.erase(body_start + decoded, conn.body_raw - decoded);
+            conn.body_raw = decoded;
+        }
+
+        if (status == ParseStatus::Complete) {
+            head_.body = string_view(conn.in.data() + body_start, decoded);
+            head_.body_ready = true;
+        }
+
+        return status;
+    }
+
+    void Reactor::feedBody(Connection &conn) {
+        Context &context = conn.async->context;
+        ParseStatus status = ParseStatus::Incomplete;
+        size_t consumed = 0;
+
+        // The piece is copied out, so the handler can hold on to it while
+        // more arrives behind it.
+        while (consumed < conn.in.size()) {
+            size_t used = 0;
+            string_view data;
+            status = conn.body.read(
+                string_view(conn.in.data() + consumed, conn.in.size() - consumed),
+                used,
+                data
+            );
+            context.body_.append(data.data(), data.size());
+            consumed += used;
+
+            if (status != ParseStatus::Incomplete) {
+                break;
+            }
+        }
+        conn.in.consume(consumed);
+
+        int fd = conn.fd;
+        if (status == ParseStatus::Error || status == ParseStatus::TooLarge) {
+            log_.warn("Bad request body from client {}", fd);
+            AccessMethod method = conn.async->method;
+            if (abandonBody(conn)) {
+                reject(conn, status, method);
+                conn.state = ConnectionState::Writing;
+                handleWritable(conn);
+            }
+        } else if (status == ParseStatus::Incomplete && context.body_.empty()) {
+            if (conn.peer_closed) {
+                conn.state = ConnectionState::Closing;
+            }
+        } else {
+            if (status == ParseStatus::Complete) {
+                conn.body_streaming = false;
+            }
+            conn.body_waiting = false;
+
+            if (conn.read_paused) {
+                conn.read_paused = false;
+                handleReadable(conn);
+            }
+
+            if (conn.state != ConnectionState::Closing) {
+                resumeAsync(conn, !context.body_.empty());
+                return;
+            }
+        }
+
+        if (conn.state == ConnectionState::Closing) {
+            closeConnection(fd);
+        }
+    }
+
+    bool Reactor::abandonBody(Connection &conn) {
+        conn.body_streaming = false;
+        conn.body_waiting = false;
+
+        // too late for an error response once the handler has written
+        const Context &context = conn.async->context;
+        if (context.sent_ > 0 || context.streaming_) {
+            conn.state = ConnectionState::Closing;
+            return false;
+        }
+
+        conn.async.reset();
+        conn.in_flight = false;
+        return true;
+    }
+
+    void Reactor::reject(Connection &conn, ParseStatus status, AccessMethod method) {
+        if (status == ParseStatus::TooLarge) {
+            reject(conn, payload_too_large_response, 413, method);
+            return;
+        }
+
+        reject(conn, bad_request_response, 400, method);
+    }
+
+    void Reactor::reject(
+        Connection &conn,
+        string_view response,
+        uint16_t status,
+        AccessMethod method
+    ) {
+        conn.out.appendStatic(response);
+        conn.close_after_write = true;
+
+        if (config_.access_log) {
+            ResponseInfo info{status, no_route};
+            recordAccess(conn.fd, method, info, response.size(), now_);
+        }
+    }
+
+    void Reactor::upgradeConnection(
+        Connection &conn,
+        const WebSocketHandler &handler
+    ) {
+        auto response = acceptHandshake(head_);
+        if (!response) {
+            log_.warn(
+                "WebSocket handshake from client {} rejected: {}",
+                conn.fd,
+                response.error()
+            );
+            conn.out.appendStatic(bad_handshake_response);
+            conn.close_after_write = true;
+            return;
+        }
+
+        conn.out.append(std::move(*response));
+        conn.websocket = std::make_unique<WebSocket>(
+            handler,
+            conn.out,
+            max_pending_output_,
+            config_.max_message_size
+        );
+
+        log_.debug("WebSocket opened on client {}", conn.fd);
+        conn.websocket->open();
+    }
+
+    void Reactor::processFrames(Connection &conn) {
+        if (!conn.in.empty()) {
+            size_t consumed = conn.websocket->receive(conn.in.data(), conn.in.size());
+            conn.in.consume(consumed);
+        }
+
+        if (conn.websocket->closing()) {
+            conn.close_after_write = true;
+        }
+
+        if (!conn.out.empty()) {
+            conn.state = ConnectionState::Writing;
+            handleWritable(conn);
+        }
+    }
+
+    void Reactor::startAsync(
+        Connection &conn,
+        Deferred &deferred,
+        bool keep_alive,
+        const ResponseInfo &info,
+        std::chrono::steady_clock::time_point start
+    ) {
+        conn.async = std::make_unique<AsyncRequest>(
+            *this,
+            conn.fd,
+            conn.id,
+            keep_alive,
+            deferred.coroutine,
+            std::move(deferred.request)
+        );
+
+        AsyncRequest &async = *conn.async;
+        async.info = info;
+        async.method = accessMethod(head_.method);
+        async.start = start;
+        async.compress = deferred.compress;
+        async.context.suspended_ = async.task.handle();
+        conn.in_flight = true;
+
+        // Run up to the first suspension now; a handler that never
+        // suspends completes without a trip through the loop.
+        async.context.resume(true);
+        if (async.task.done()) {
+            completeAsync(conn);
+        }
+    }
+
+    void Reactor::resumeAsync(Connection &conn, bool result) {
+        int fd = conn.fd;
+        conn.async->context.resume(result);
+
+        if (conn.async->task.done()) {
+            completeAsync(conn);
+            processRequests(conn);
+        } else if (!conn.out.empty() && conn.state == ConnectionState::Reading) {
+            conn.state = ConnectionState::Writing;
+            handleWritable(conn);
+        }
+
+        if (conn.state == ConnectionState::Closing) {
+            closeConnection(fd);
+        }
+    }
+
+    void Reactor::completeAsync(Connection &conn) {
+        AsyncRequest &async = *conn.async;
+        Context &context = async.context;
+        size_t bytes = context.sent_;
+
+        optional<Response> result;
+        try {
+            result = async.task.result();
+        } catch (const std::exception &error) {
+            log_.error("Handler for client {} threw: {}", conn.fd, error.what());
+        } catch (...) {
+            log_.error("Handler for client {} threw", conn.fd);
+        }
+
+        // A handler that threw gets a 500 and the connection closed, or
+        // just the close once the head of its own response is out.
+        if (!result) {
+            context.keep_alive_ = false;
+            if (context.streaming_) {
+                async.info.status = context.status_;
+            } else {
+                std::uint16_t status = 500;
+                string_view line = statusLine(status);
+                string_view body = line.substr(9, line.size() - 11);
+                size_t before = conn.out.pending();
+                HeadWriter(conn.out, status)
+                    .contentType("text/plain")
+                    .contentLength(body.size())
+                    .connection(false)
+                    .date()
+                    .end();
+                if (sendsBody(context.request().method, status)) {
+                    conn.out.appendStatic(body);
+                }
+
+                async.info.status = status;
+                bytes += conn.out.pending() - before;
+            }
+        } else if (context.chunked_) {
+            async.info.status = context.status_;
+            conn.out.appendStatic(last_chunk);
+            bytes += last_chunk.size();
+        } else if (context.streaming_) {
+            async.info.status = context.status_;
+            bool sized = context.content_length_ != Context::unknown_length_
+                && !context.bodiless_;
+            if (sized && context.streamed_ != context.content_length_) {
+                log_.warn(
+                    "Streamed response to client {} ended after {} of {} bytes",
+                    conn.fd,
+                    context.streamed_,
+                    context.content_length_
+                );
+                conn.close_after_write = true;
+            }
+        } else {
+            Response response = std::move(*result);
+
+            // the same rules as the other routes, on the type it returned
+            bool compresses = async.compress
+                && config_.compression.enabled
+                && isCompressible(response.content_type);
+            Encoding encoding = Encoding::Identity;
+            if (compresses) {
+                string encoded;
+                encoding = compressBody(
+                    config_.compression,
+                    context.request().header("Accept-Encoding"),
+                    response.body,
+                    encoded
+                );
+                if (encoding != Encoding::Identity) {
+                    response.body = std::move(encoded);
+                }
+            }
+
+            bool body = sendsBody(context.request().method, response.status);
+            size_t before = conn.out.pending();
+            HeadWriter writer(conn.out, response.status);
+            writer.contentType(response.content_type);
+            if (response.status != 204) {
+                writer.contentLength(response.body.size());
+            }
+            if (encoding != Encoding::Identity) {
+                writer.header("Content-Encoding", encodingName(encoding));
+            }
+            if (compresses) {
+                writer.header("Vary: Accept-Encoding\r\n");
+            }
+            writer.connection(context.keep_alive_)
+                .date()
+                .end();
+
+            async.info.status = response.status;
+            bytes += conn.out.pending() - before;
+            if (body) {
+                bytes += response.body.size();
+                conn.out.append(std::move(response.body));
+            }
+        }
+
+        if (config_.access_log) {
+            recordAccess(conn.fd, async.method, async.info, bytes, async.start);
+        }
+
+        if (!context.keep_alive_) {
+            conn.close_after_write = true;
+        }
+
+        // the rest of an unread body is still in the way of the next request
+        if (conn.body_streaming) {
+            conn.body_streaming = false;
+            conn.body_waiting = false;
+            conn.close_after_write = true;
+        }
+
+        conn.in_flight = false;
+        conn.async.reset();
+    }
+
+    void Reactor::wakeWaiter(const Wake &wake, bool result) {
+        Connection *found = connections_.find(wake.fd);
+        if (!found) {
+            return;
+        }
+
+        Connection &conn = *found;
+        if (conn.id != wake.connection_id
+            || !conn.async
+            || conn.async->context.wait_id_ != wake.wait_id) {
+            return;
+        }
+
+        if (conn.body_waiting) {
+            feedBody(conn);
+            return;
+        }
+
+        resumeAsync(conn, result);
+    }
+
+    void Reactor::runTimers() {
+        uint64_t now = tick(now_);
+
+        // one at a time, as firing one may cancel or arm others
+        while (Timer *timer = timers_.expire(now)) {
+            Connection *found = connections_.find(timer->fd());
+            if (!found) {
+                continue;
+            }
+
+            Connection &conn = *found;
+            if (timer == &conn.timer) {
+                timeOut(conn);
+            } else if (conn.async && timer == &conn.async->context.timer_) {
+                Context &context = conn.async->context;
+                wakeWaiter({conn.fd, conn.id, context.wait_id_}, true);
+            }
+        }
+    }
+
+    void Reactor::setTimeout(Connection &conn, Timeout timeout) {
+        // Only writing restarts its deadline, on every bit of progress;
+        // the others keep the one set when the phase began.
+        if (timeout == conn.timeout && conn.timer.armed() && timeout != Timeout::Write) {
+            return;
+        }
+
+        conn.timeout = timeout;
+        int seconds = 0;
+        switch (timeout) {
+            case Timeout::None:
+                conn.timer.cancel();
+                return;
+            case Timeout::Header:
+                seconds = config_.header_timeout;
+                break;
+            case Timeout::Body:
+                seconds = config_.body_timeout;
+                break;
+            case Timeout::Idle:
+                seconds = config_.keep_alive_timeout;
+                break;
+            case Timeout::Write:
+                seconds = config_.write_timeout;
+                break;
+        }
+
+        if (seconds <= 0) {
+            conn.timer.cancel();
+            return;
+        }
+
+        timers_.arm(conn.timer, tick(now_ + std::chrono::seconds(seconds)), conn.fd);
+    }
+
+    void Reactor::timeOut(Connection &conn) {
+        if (conn.state == ConnectionState::Closing) {
+            return;
+        }
+
+        int fd = conn.fd;
+        Timeout timeout = conn.timeout;
+        conn.timeout = Timeout::None;
+
+        // A client that got part of a request in is told why it is
+        // dropped, unless a handler has already answered it.
+        bool partial = (timeout == Timeout::Header && !conn.in.empty())
+            || timeout == Timeout::Body;
+        AccessMethod method = AccessMethod::Other;
+        if (partial && conn.in_flight) {
+            method = conn.async ? conn.async->method : method;
+            partial = conn.body_streaming && abandonBody(conn);
+        }
+
+        if (partial) {
+            log_.debug("Request from client {} timed out", fd);
+            conn.in.reset();
+            reject(conn, request_timeout_response, 408, method);
+            conn.state = ConnectionState::Writing;
+            handleWritable(conn);
+        } else {
+            log_.debug("Connection {} timed out", fd);
+            conn.state = ConnectionState::Closing;
+        }
+
+        if (conn.state == ConnectionState::Closing) {
+            closeConnection(fd);
+        }
+    }
+
+    uint64_t Reactor::tick(std::chrono::steady_clock::time_point time) const {
+        // rounded up, so a timer never fires before its deadline
+        auto since = std::chrono::ceil<std::chrono::milliseconds>(time - epoch_);
+        return static_cast<uint64_t>(std::max<long long>(since.count(), 0));
+    }
+
+    void Reactor::runReady() {
+        woken_.swap(ready_);
+        for (const Wake &wake : woken_) {
+            wakeWaiter(wake, true);
+        }
+
+        woken_.clear();
+    }
+
+    void Reactor::runUnread() {
+        // connections queued while these run wait for the next turn
+        size_t count = unread_.size();
+        for (size_t i = 0; i < count; ++i) {
+            auto [fd, id] = unread_[i];
+            Connection *conn = connections_.find(fd);
+            if (!conn || conn->id != id) {
+                continue;
+            }
+
+            handleReadable(*conn);
+            if (conn->state == ConnectionState::Closing) {
+                closeConnection(fd);
+            }
+        }
+
+        unread_.erase(unread_.begin(), unread_.begin() + count);
+    }
+
+    int Reactor::nextTimeout() const {
+        if (!ready_.empty() || !unread_.empty()) {
+            return 0;
+        }
+
+        uint64_t due = timers_.next();
+        if (due == std::numeric_limits<uint64_t>::max()) {
+            return -1;
+        }
+
+        auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+            epoch_ + std::chrono::milliseconds(due) - std::chrono::steady_clock::now()
+        ).count();
+        return static_cast<int>(std::clamp<long long>(wait, 0, std::numeric_limits<int>::max()));
+    }
+
+    void Reactor::dispatch(
+        Connection &conn,
+        Job job,
+        bool keep_alive,
+        std::chrono::steady_clock::time_point start
+    ) {
+        Completion *completion = new Completion();
+        completion->fd = conn.fd;
+        completion->connection_id = conn.id;
+        completion->keep_alive = keep_alive;
+        completion->method = accessMethod(head_.method);
+        completion->start = start;
+        conn.in_flight = true;
+
+        config_.pool->submit([this, completion, job = std::move(job)] {
+            job(completion->out, completion->info, completion->keep_alive);
+
+            if (completions_.push(completion)) {
+                uint64_t one = 1;
+                write(wake_fd_, &one, sizeof(one));
+            }
+        });
+    }
+
+    void Reactor::recordAccess(
+        int fd,
+        AccessMethod method,
+        const ResponseInfo &info,
+        size_t bytes,
+        std::chrono::steady_clock::time_point start
+    ) {
+        // both from the time the loop read when it woke, not a fresh read
+        AccessRecord record{};
+        record.timestamp_ns = Clock::get().wallTime(now_);
+        record.latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now_ - start
+        ).count();
+        record.bytes = bytes;
+        record.route_id = info.route_id;
+        record.fd = fd;
+        record.status = info.status;
+        record.method = method;
+        config_.access_log->record(record);
+    }
+
+    void Reactor::handleWake() {
+        uint64_t count;
+        while (read(wake_fd_, &count, sizeof(count)) > 0) {
+        }
+
+        drainBroadcasts();
+        drainCompletions();
+    }
+
+    void Reactor::drainBroadcasts() {
+        std::vector<std::pair<const WebSocketHandler *, shared_ptr<const string>>> pending;
+        {
+            std::lock_guard lock(broadcast_mutex_);
+            pending.swap(broadcasts_);
+        }
+
+        std::vector<int> closed;
+        for (auto &[target, frame] : pending) {
+            for (int fd : connections_.live()) {
+                Connection &conn = *connections_.find(fd);
+                if (!conn.websocket
+                    || &conn.websocket->handler() != target
+                    || conn.state == ConnectionState::Closing) {
+                    continue;
+                }
+
+                // A client that cannot keep up misses the message instead
+                // of growing its queue without bound.
+                if (!conn.websocket->sendFrame(frame)) {
+                    continue;
+                }
+
+                if (conn.state == ConnectionState::Reading) {
+                    conn.state = ConnectionState::Writing;
+                    handleWritable(conn);
+                }
+
+                if (conn.state == ConnectionState::Closing) {
+                    closed.push_back(fd);
+                }
+            }
+        }
+
+        for (int fd : closed) {
+            closeConnection(fd);
+        }
+    }
+
+    void Reactor::drainCompletions() {
+        Completion *completion = completions_.popAll();
+
+        while (completion) {
+            std::unique_ptr<Completion> done(completion);
+            completion = completion->next;
+
+            // the client may have gone away, and its descriptor been
+            // reused, while the job was running
+            Connection *found = connections_.find(done->fd);
+            if (!found
+                || found->id != done->connection_id
+                || found->state == ConnectionState::Closing) {
+                continue;
+            }
+
+            Connection &conn = *found;
+            conn.in_flight = false;
+
+            if (config_.access_log) {
+                recordAccess(
+                    conn.fd,
+                    done->method,
+                    done->info,
+                    done->out.pending(),
+                    done->start
+                );
+            }
+
+            conn.out.append(std::move(done->out));
+            if (!done->keep_alive) {
+                conn.close_after_write = true;
+            }
+
+            processRequests(conn);
+
+            if (conn.state == ConnectionState::Closing) {
+                closeConnection(done->fd);
+            }
+        }
+    }
+
+    void Reactor::closeConnection(int fd) {
+        Connection *found = connections_.find(fd);
+        if (found && found->websocket) {
+            found->websocket->finish();
+        }
+
+        if (uring_) {
+            if (!found || found->close_queued) {
+                return;
+            }
+
+            // Receives and sends hold their own reference to the socket,
+            // so they are cancelled first; a send still in flight submits
+            // the close when it completes.
+            Connection &conn = *found;
+            conn.state = ConnectionState::Closing;
+            conn.close_queued = true;
+            conn.timer.cancel();
+            conn.async.reset();
+            cancelAll(fd);
+
+            if (!conn.sending) {
+                submitClose(conn);
+            }
+            return;
+        }
+
+        connections_.release(fd);
+        close(fd);
+        log_.debug("Socket closed: {}", fd);
+    }
+
+    int Reactor::setNonBlocking(int socket) {
+        int flags = fcntl(socket, F_GETFL, 0);
+        return fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    void Reactor::handleCompletion(const io_uring_cqe &cqe) {
+        Op op = tagOp(cqe.user_data);
+        int fd = tagFd(cqe.user_data);
+        bool more = cqe.flags & IORING_CQE_F_MORE;
+
+        if (op == Op::Receive) {
+            handleReceived(cqe);
+            return;
+        }
+
+        if (op == Op::Accept) {
+            if (!more) {
+                armAccept();
+            }
+
+            if (cqe.res < 0) {
+                if (cqe.res != -ECANCELED) {
+                    log_.error("Accept failed: {}", strerror(-cqe.res));
+                }
+                return;
+            }
+
+            addConnection(cqe.res);
+            return;
+        }
+
+        if (op == Op::Watch) {
+            auto watcher = watchers_.find(fd);
+            if (watcher == watchers_.end() || cqe.res == -ECANCELED) {
+                return;
+            }
+
+            // one-shot, so whatever the callback leaves unread is
+            // reported again
+            watcher->second();
+            armPoll(fd, POLLIN, tag(Op::Watch, fd, 0));
+            return;
+        }
+
+        if (op == Op::Waiter) {
+            auto waiter = fd_waiters_.find(fd);
+            if (waiter == fd_waiters_.end()
+                || !tagMatches(cqe.user_data, waiter->second.wait_id)) {
+                return;
+            }
+
+            Wake wake = waiter->second;
+            fd_waiters_.erase(waiter);
+            wakeWaiter(wake, cqe.res >= 0);
+            return;
+        }
+
+        if (op != Op::Send && op != Op::PollOut && op != Op::Close) {
+            return;
+        }
+
+        Connection *found = connections_.find(fd);
+        if (!found || !tagMatches(cqe.user_data, found->id)) {
+            return;
+        }
+
+        Connection &conn = *found;
+
+        if (op == Op::Close) {
+            // a linked close is skipped when its send came up short
+            if (cqe.res == -ECANCELED) {
+                submitClose(conn);
+                return;
+            }
+
+            if (conn.websocket) {
+                conn.websocket->finish();
+            }
+
+            connections_.release(fd);
+            log_.debug("Socket closed: {}", fd);
+            return;
+        }
+
+        conn.sending = false;
+        if (op == Op::Send) {
+            conn.out.complete(cqe.res > 0 ? cqe.res : 0);
+        }
+
+        if (conn.close_queued) {
+            if (!conn.close_submitted) {
+                submitClose(conn);
+            }
+            return;
+        }
+
+        if (cqe.res < 0) {
+            log_.debug("Send to client {} failed: {}", fd, strerror(-cqe.res));
+            conn.state = ConnectionState::Closing;
+        } else if (op == Op::PollOut && (cqe.res & (POLLERR | POLLHUP))) {
+            conn.state = ConnectionState::Closing;
+        } else {
+            handleWritable(conn);
+        }
+
+        if (conn.state == ConnectionState::Closing) {
+            closeConnection(fd);
+        }
+    }
+
+    void Reactor::handleReceived(const io_uring_cqe &cqe) {
+        int fd = tagFd(cqe.user_data);
+        Connection *conn = connections_.find(fd);
+        if (conn && !tagMatches(cqe.user_data, conn->id)) {
+            conn = nullptr;
+        }
+
+        // the buffer goes back to the ring whether or not anyone wants it
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            uint16_t id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+            if (conn && cqe.res > 0 && !conn->close_queued) {
+                conn->in.append(uring_->buffer(id), cqe.res);
+            }
+            uring_->recycle(id);
+        }
+
+        if (!conn || conn->close_queued) {
+            return;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            conn->recv_armed = false;
+        }
+
+        if (cqe.res == 0) {
+            conn->peer_closed = true;
+        } else if (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED) {
+            log_.error("Error reading from socket {}: {}", fd, strerror(-cqe.res));
+            conn->state = ConnectionState::Closing;
+        }
+
+        handleReadable(*conn);
+
+        if (conn->state == ConnectionState::Closing) {
+            closeConnection(fd);
+        }
+    }
+
+    FlushStatus Reactor::submitSend(Connection &conn) {
+        if (conn.close_queued) {
+            return FlushStatus::Error;
+        }
+
+        if (conn.sending) {
+            return FlushStatus::Blocked;
+        }
+
+        if (conn.out.empty()) {
+            return FlushStatus::Done;
+        }
+
+        // Files still go out through sendfile; the ring only tells us when
+        // the socket has room again.
+        if (conn.out.frontIsFile()) {
+            FlushStatus status = conn.out.flush(conn.fd);
+            if (status == FlushStatus::Blocked) {
+                conn.sending = true;
+                armPoll(conn.fd, POLLOUT, tag(Op::PollOut, conn.fd, conn.id));
+            }
+            return status;
+        }
+
+        if (!conn.send) {
+            conn.send = std::make_unique<SendState>();
+        }
+
+        SendState &send = *conn.send;
+        int flags = MSG_NOSIGNAL;
+        int count = conn.out.gather(send.iov, max_send_iovecs_, flags);
+
+        size_t length = 0;
+        for (int i = 0; i < count; ++i) {
+            length += send.iov[i].iov_len;
+        }
+
+        send.message = {};
+        send.message.msg_iov = send.iov;
+        send.message.msg_iovlen = count;
+
+        // The last response on a connection takes the close with it; the
+        // receive is cancelled first so the close really ends the socket.
+        bool last = conn.close_after_write && length == conn.out.pending();
+        if (last) {
+            flags |= MSG_WAITALL;
+            cancelAll(conn.fd);
+        }
+
+        // the ring only refuses when the kernel stopped taking submissions
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return FlushStatus::Error;
+        }
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = conn.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&send.message);
+        sqe->msg_flags = flags;
+        sqe->user_data = tag(Op::Send, conn.fd, conn.id);
+        conn.sending = true;
+
+        if (last) {
+            sqe->flags |= IOSQE_IO_LINK;
+            conn.state = ConnectionState::Closing;
+            conn.close_queued = true;
+            submitClose(conn);
+
+            // the ring was full, so the send is still ours to unlink
+            if (!conn.close_submitted) {
+                sqe->flags &= ~IOSQE_IO_LINK;
+            }
+        }
+
+        return FlushStatus::Blocked;
+    }
+
+    void Reactor::submitClose(Connection &conn) {
+        // Rather than leak the descriptor when the ring is unusable, close
+        // it here the way the completion would. A send still in flight owns
+        // the connection, so its completion tries again instead.
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            if (conn.sending) {
+                return;
+            }
+
+            int fd = conn.fd;
+            if (conn.websocket) {
+                conn.websocket->finish();
+            }
+
+            connections_.release(fd);
+            close(fd);
+            log_.debug("Socket closed: {}", fd);
+            return;
+        }
+
+        conn.close_submitted = true;
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = conn.fd;
+        sqe->user_data = tag(Op::Close, conn.fd, conn.id);
+    }
+
+    void Reactor::armAccept() {
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = server_socket_;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = tag(Op::Accept, server_socket_, 0);
+    }
+
+    void Reactor::armReceive(Connection &conn) {
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = conn.fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = buffer_group_;
+        sqe->user_data = tag(Op::Receive, conn.fd, conn.id);
+        conn.recv_armed = true;
+    }
+
+    void Reactor::armPoll(int fd, uint32_t events, uint64_t user_data) {
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = events;
+        sqe->user_data = user_data;
+    }
+
+    void Reactor::cancelRequest(uint64_t user_data) {
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = user_data;
+        sqe->user_data = tag(Op::Cancel, tagFd(user_data), 0);
+    }
+
+    void Reactor::cancelAll(int fd) {
+        io_uring_sqe *sqe = uring_->sqe();
+        if (!sqe) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = tag(Op::Cancel, fd, 0);
+    }
+}
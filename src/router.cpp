@@ -0,0 +1,251 @@
+#include <string_view>
+#include <algorithm>
+#include <expected>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <string>
+
+#include "router.hpp"
+
+using std::string_view;
+using std::unique_ptr;
+using std::unexpected;
+using std::expected;
+using std::string;
+using std::format;
+using std::size_t;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // route params
+    ///////////////////////////////////////////////////////////////////////////
+    string_view RouteParams::get(string_view name) const {
+        for (size_t i = 0; i < count; ++i) {
+            if (params[i].name == name) {
+                return params[i].value;
+            }
+        }
+
+        return {};
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    Router::Node::Node() {
+        std::fill(std::begin(handlers), std::end(handlers), npos);
+    }
+
+    Router::Router() : root_(std::make_unique<Node>()) {
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    Router::~Router() {
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> Router::add(
+        size_t method,
+        string_view pattern,
+        size_t id
+    ) {
+        if (method >= max_methods) {
+            return unexpected(format("Unsupported method index {}", method));
+        }
+
+        if (!pattern.starts_with('/')) {
+            return unexpected(format("Route {} must start with '/'", pattern));
+        }
+
+        string_view rest = pattern;
+        Node *node = root_.get();
+        size_t param_count = 0;
+
+        while (!rest.empty()) {
+            if (rest[0] == ':' || rest[0] == '*') {
+                bool wildcard = rest[0] == '*';
+                size_t name_end = rest.find('/');
+                string_view name = rest.substr(1, name_end - 1);
+
+                if (name.empty()) {
+                    return unexpected(format("Unnamed parameter in {}", pattern));
+                }
+
+                if (++param_count > RouteParams::max_params) {
+                    return unexpected(format("Too many parameters in {}", pattern));
+                }
+
+                if (wildcard) {
+                    if (name_end != string_view::npos) {
+                        return unexpected(format(
+                            "Wildcard must be the last segment in {}",
+                            pattern
+                        ));
+                    }
+
+                    if (!node->wildcard_child) {
+                        node->wildcard_child = std::make_unique<Node>();
+                        node->wildcard_name = name;
+                    } else if (node->wildcard_name != name) {
+                        return unexpected(format(
+                            "Wildcard *{} in {} conflicts with *{}",
+                            name,
+                            pattern,
+                            node->wildcard_name
+                        ));
+                    }
+
+                    node = node->wildcard_child.get();
+                    break;
+                }
+
+                if (!node->param_child) {
+                    node->param_child = std::make_unique<Node>();
+                    node->param_name = name;
+                } else if (node->param_name != name) {
+                    return unexpected(format(
+                        "Parameter :{} in {} conflicts with :{}",
+                        name,
+                        pattern,
+                        node->param_name
+                    ));
+                }
+
+                node = node->param_child.get();
+                rest = name_end == string_view::npos
+                    ? string_view {}
+                    : rest.substr(name_end);
+                continue;
+            }
+
+            size_t static_end = rest.find_first_of(":*");
+            string_view segment = rest.substr(0, static_end);
+            if (static_end != string_view::npos && !segment.ends_with('/')) {
+                return unexpected(format(
+                    "Parameters must start a path segment in {}",
+                    pattern
+                ));
+            }
+
+            size_t index = node->indices.find(segment[0]);
+            if (index == string::npos) {
+                auto child = std::make_unique<Node>();
+                child->prefix = segment;
+                node->indices.push_back(segment[0]);
+                node->children.push_back(std::move(child));
+                node = node->children.back().get();
+                rest = rest.substr(segment.size());
+                continue;
+            }
+
+            unique_ptr<Node> &child = node->children[index];
+            size_t common = 0;
+            size_t limit = std::min(child->prefix.size(), segment.size());
+            while (common < limit && child->prefix[common] == segment[common]) {
+                ++common;
+            }
+
+            if (common < child->prefix.size()) {
+                auto split = std::make_unique<Node>();
+                split->prefix = child->prefix.substr(0, common);
+                child->prefix.erase(0, common);
+                split->indices.push_back(child->prefix[0]);
+                split->children.push_back(std::move(child));
+                child = std::move(split);
+            }
+
+            node = child.get();
+            rest = rest.substr(common);
+        }
+
+        if (node->handlers[method] != npos) {
+            return unexpected(format("Duplicate route {}", pattern));
+        }
+
+        node->handlers[method] = id;
+        return {};
+    }
+
+    size_t Router::match(
+        size_t method,
+        string_view path,
+        RouteParams &params
+    ) const {
+        params.count = 0;
+        if (method >= max_methods) {
+            return npos;
+        }
+
+        size_t id = npos;
+        if (matchNode(root_.get(), path, method, params, id)) {
+            return id;
+        }
+
+        return npos;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool Router::matchNode(
+        const Node *node,
+        string_view path,
+        size_t method,
+        RouteParams &params,
+        size_t &id
+    ) const {
+        if (path.empty() && node->handlers[method] != npos) {
+            id = node->handlers[method];
+            return true;
+        }
+
+        if (!path.empty()) {
+            size_t index = node->indices.find(path[0]);
+            if (index != string::npos) {
+                const Node *child = node->children[index].get();
+                if (path.starts_with(child->prefix)) {
+                    string_view rest = path.substr(child->prefix.size());
+                    if (matchNode(child, rest, method, params, id)) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        if (node->param_child && !path.empty() && path[0] != '/') {
+            size_t end = path.find('/');
+            if (end == string_view::npos) {
+                end = path.size();
+            }
+
+            size_t saved = params.count;
+            params.params[params.count++] = RouteParam {
+                node->param_name,
+                path.substr(0, end)
+            };
+
+            if (matchNode(node->param_child.get(), path.substr(end), method, params, id)) {
+                return true;
+            }
+
+            params.count = saved;
+        }
+
+        if (node->wildcard_child
+            && node->wildcard_child->handlers[method] != npos) {
+            params.params[params.count++] = RouteParam {
+                node->wildcard_name,
+                path
+            };
+            id = node->wildcard_child->handlers[method];
+            return true;
+        }
+
+        return false;
+    }
+}
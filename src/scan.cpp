@@ -0,0 +1,387 @@
+#include <cstddef>
+#include <cstdint>
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_SCAN_X86 1
+#endif
+
+#include "scan.hpp"
+
+using std::size_t;
+
+namespace http::scan {
+    namespace {
+        constexpr bool isTokenChar(unsigned char c) {
+            if ((c >= '0' && c <= '9')
+                || (c >= 'A' && c <= 'Z')
+                || (c >= 'a' && c <= 'z')) {
+                return true;
+            }
+
+            switch (c) {
+                case '!': case '#': case '$': case '%': case '&': case '\'':
+                case '*': case '+': case '-': case '.': case '^': case '_':
+                case '`': case '|': case '~':
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        constexpr bool isControlChar(unsigned char c) {
+            return (c < 0x20 && c != '\t') || c == 0x7f;
+        }
+
+        constexpr std::array<bool, 256> token_table = [] {
+            std::array<bool, 256> table {};
+            for (int c = 0; c < 256; ++c) {
+                table[c] = isTokenChar(static_cast<unsigned char>(c));
+            }
+            return table;
+        }();
+
+        // For each low nibble, the set of high nibbles (0-7) that make a
+        // tchar. Lets the SIMD kernels classify 16 bytes with two pshufb.
+        constexpr std::array<uint8_t, 16> token_nibble_table = [] {
+            std::array<uint8_t, 16> table {};
+            for (int c = 0; c < 128; ++c) {
+                if (isTokenChar(static_cast<unsigned char>(c))) {
+                    table[c & 0x0f] |= uint8_t(1 << (c >> 4));
+                }
+            }
+            return table;
+        }();
+
+        ///////////////////////////////////////////////////////////////////////
+        // scalar kernels
+        ///////////////////////////////////////////////////////////////////////
+        size_t findHeaderEndScalar(const char *data, size_t size) {
+            for (size_t i = 0; i + 3 < size; ++i) {
+                if (data[i] == '\r' && data[i + 1] == '\n'
+                    && data[i + 2] == '\r' && data[i + 3] == '\n') {
+                    return i;
+                }
+            }
+
+            return npos;
+        }
+
+        size_t findCharScalar(const char *data, size_t size, char c) {
+            for (size_t i = 0; i < size; ++i) {
+                if (data[i] == c) {
+                    return i;
+                }
+            }
+
+            return npos;
+        }
+
+        size_t findNonTokenScalar(const char *data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                if (!token_table[static_cast<unsigned char>(data[i])]) {
+                    return i;
+                }
+            }
+
+            return size;
+        }
+
+        size_t findControlScalar(const char *data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                if (isControlChar(static_cast<unsigned char>(data[i]))) {
+                    return i;
+                }
+            }
+
+            return size;
+        }
+
+#ifdef HTTP_SCAN_X86
+        ///////////////////////////////////////////////////////////////////////
+        // sse4.2 kernels
+        ///////////////////////////////////////////////////////////////////////
+        __attribute__((target("sse4.2")))
+        size_t findHeaderEndSse42(const char *data, size_t size) {
+            const __m128i cr = _mm_set1_epi8('\r');
+            const __m128i lf = _mm_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 16 + 3 <= size; i += 16) {
+                const char *p = data + i;
+                __m128i a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), cr);
+                __m128i b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 1)), lf);
+                __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 2)), cr);
+                __m128i d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 3)), lf);
+                int mask = _mm_movemask_epi8(
+                    _mm_and_si128(_mm_and_si128(a, b), _mm_and_si128(c, d))
+                );
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            size_t rest = findHeaderEndScalar(data + i, size - i);
+            return rest == npos ? npos : i + rest;
+        }
+
+        __attribute__((target("sse4.2")))
+        size_t findCharSse42(const char *data, size_t size, char c) {
+            const __m128i needle = _mm_set1_epi8(c);
+            size_t i = 0;
+
+            for (; i + 16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            size_t rest = findCharScalar(data + i, size - i, c);
+            return rest == npos ? npos : i + rest;
+        }
+
+        __attribute__((target("sse4.2")))
+        size_t findNonTokenSse42(const char *data, size_t size) {
+            const __m128i lo_table = _mm_loadu_si128(
+                (const __m128i *)token_nibble_table.data()
+            );
+            const __m128i hi_bits = _mm_setr_epi8(
+                1, 2, 4, 8, 16, 32, 64, (char)128,
+                0, 0, 0, 0, 0, 0, 0, 0
+            );
+            const __m128i nibble = _mm_set1_epi8(0x0f);
+            size_t i = 0;
+
+            for (; i + 16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+                __m128i lo = _mm_and_si128(chunk, nibble);
+                __m128i hi = _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble);
+                __m128i hit = _mm_and_si128(
+                    _mm_shuffle_epi8(lo_table, lo),
+                    _mm_shuffle_epi8(hi_bits, hi)
+                );
+                int mask = _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(hit, _mm_setzero_si128())
+                );
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            return i + findNonTokenScalar(data + i, size - i);
+        }
+
+        __attribute__((target("sse4.2")))
+        size_t findControlSse42(const char *data, size_t size) {
+            alignas(16) static const char ranges[16] = {
+                '\t', '\t', ' ', '~', (char)0x80, (char)0xff
+            };
+            const __m128i allowed = _mm_load_si128((const __m128i *)ranges);
+            size_t i = 0;
+
+            for (; i + 16 <= size; i += 16) {
+                __m128i chunk = _mm_loadu_si128((const __m128i *)(data + i));
+                int index = _mm_cmpestri(
+                    allowed, 6, chunk, 16,
+                    _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES
+                        | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT
+                );
+                if (index != 16) {
+                    return i + index;
+                }
+            }
+
+            return i + findControlScalar(data + i, size - i);
+        }
+
+        ///////////////////////////////////////////////////////////////////////
+        // avx2 kernels
+        ///////////////////////////////////////////////////////////////////////
+        __attribute__((target("avx2")))
+        size_t findHeaderEndAvx2(const char *data, size_t size) {
+            const __m256i cr = _mm256_set1_epi8('\r');
+            const __m256i lf = _mm256_set1_epi8('\n');
+            size_t i = 0;
+
+            for (; i + 32 + 3 <= size; i += 32) {
+                const char *p = data + i;
+                __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), cr);
+                __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 1)), lf);
+                __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 2)), cr);
+                __m256i d = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + 3)), lf);
+                uint32_t mask = _mm256_movemask_epi8(
+                    _mm256_and_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, d))
+                );
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            size_t rest = findHeaderEndScalar(data + i, size - i);
+            return rest == npos ? npos : i + rest;
+        }
+
+        __attribute__((target("avx2")))
+        size_t findCharAvx2(const char *data, size_t size, char c) {
+            const __m256i needle = _mm256_set1_epi8(c);
+            size_t i = 0;
+
+            for (; i + 32 <= size; i += 32) {
+                __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+                uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            size_t rest = findCharScalar(data + i, size - i, c);
+            return rest == npos ? npos : i + rest;
+        }
+
+        __attribute__((target("avx2")))
+        size_t findNonTokenAvx2(const char *data, size_t size) {
+            const __m256i lo_table = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128((const __m128i *)token_nibble_table.data())
+            );
+            const __m256i hi_bits = _mm256_setr_epi8(
+                1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0,
+                1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0
+            );
+            const __m256i nibble = _mm256_set1_epi8(0x0f);
+            size_t i = 0;
+
+            for (; i + 32 <= size; i += 32) {
+                __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+                __m256i lo = _mm256_and_si256(chunk, nibble);
+                __m256i hi = _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble);
+                __m256i hit = _mm256_and_si256(
+                    _mm256_shuffle_epi8(lo_table, lo),
+                    _mm256_shuffle_epi8(hi_bits, hi)
+                );
+                uint32_t mask = _mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(hit, _mm256_setzero_si256())
+                );
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            return i + findNonTokenScalar(data + i, size - i);
+        }
+
+        __attribute__((target("avx2")))
+        size_t findControlAvx2(const char *data, size_t size) {
+            const __m256i space = _mm256_set1_epi8(0x20);
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i del = _mm256_set1_epi8(0x7f);
+            const __m256i minus_one = _mm256_set1_epi8(-1);
+            size_t i = 0;
+
+            for (; i + 32 <= size; i += 32) {
+                __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + i));
+                // Signed compares: bytes >= 0x80 are negative and allowed.
+                __m256i below_space = _mm256_and_si256(
+                    _mm256_cmpgt_epi8(space, chunk),
+                    _mm256_cmpgt_epi8(chunk, minus_one)
+                );
+                __m256i control = _mm256_or_si256(
+                    _mm256_andnot_si256(_mm256_cmpeq_epi8(chunk, tab), below_space),
+                    _mm256_cmpeq_epi8(chunk, del)
+                );
+                uint32_t mask = _mm256_movemask_epi8(control);
+                if (mask != 0) {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            return i + findControlScalar(data + i, size - i);
+        }
+#endif
+
+        constexpr Kernels scalar_kernels {
+            Isa::Scalar,
+            findHeaderEndScalar,
+            findCharScalar,
+            findNonTokenScalar,
+            findControlScalar,
+        };
+
+#ifdef HTTP_SCAN_X86
+        constexpr Kernels sse42_kernels {
+            Isa::Sse42,
+            findHeaderEndSse42,
+            findCharSse42,
+            findNonTokenSse42,
+            findControlSse42,
+        };
+
+        constexpr Kernels avx2_kernels {
+            Isa::Avx2,
+            findHeaderEndAvx2,
+            findCharAvx2,
+            findNonTokenAvx2,
+            findControlAvx2,
+        };
+#endif
+
+        const Kernels &selectKernels() {
+            if (supported(Isa::Avx2)) {
+                return kernelsFor(Isa::Avx2);
+            }
+
+            if (supported(Isa::Sse42)) {
+                return kernelsFor(Isa::Sse42);
+            }
+
+            return scalar_kernels;
+        }
+    }
+
+    const Kernels &kernels() {
+        static const Kernels &active = selectKernels();
+        return active;
+    }
+
+    const Kernels &kernelsFor(Isa isa) {
+#ifdef HTTP_SCAN_X86
+        if (isa == Isa::Avx2) {
+            return avx2_kernels;
+        }
+
+        if (isa == Isa::Sse42) {
+            return sse42_kernels;
+        }
+#endif
+
+        (void)isa;
+        return scalar_kernels;
+    }
+
+    bool supported(Isa isa) {
+#ifdef HTTP_SCAN_X86
+        if (isa == Isa::Avx2) {
+            return __builtin_cpu_supports("avx2");
+        }
+
+        if (isa == Isa::Sse42) {
+            return __builtin_cpu_supports("sse4.2");
+        }
+#endif
+
+        return isa == Isa::Scalar;
+    }
+
+    const char *isaName(Isa isa) {
+        switch (isa) {
+            case Isa::Avx2:
+                return "avx2";
+            case Isa::Sse42:
+                return "sse4.2";
+            default:
+                return "scalar";
+        }
+    }
+}
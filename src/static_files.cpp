@@ -0,0 +1,681 @@
+#include <shared_mutex>
+#include <string_view>
+#include <filesystem>
+#include <expected>
+#include <cstddef>
+#include <fstream>
+#include <format>
+#include <memory>
+#include <string>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "static_files.hpp"
+#include "compression.hpp"
+#include "http_parser.hpp"
+#include "headers.hpp"
+#include "output.hpp"
+#include "logger.hpp"
+#include "clock.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::shared_ptr;
+using std::unexpected;
+using std::expected;
+using std::string;
+using std::format;
+using std::size_t;
+
+namespace http {
+    namespace {
+        void appendTrailer(OutputQueue &out, string_view connection) {
+            out.appendCopy(Clock::get().dateHeader());
+            out.appendCopy(connection);
+        }
+
+        struct Sibling {
+            string_view extension;
+            Encoding encoding;
+        };
+
+        constexpr Sibling siblings[] = {
+            { ".gz", Encoding::Gzip },
+            { ".br", Encoding::Brotli },
+        };
+
+        constexpr Encoding encodings[] = {
+            Encoding::Gzip,
+            Encoding::Brotli,
+        };
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    StaticFiles::StaticFiles(Logger &log) : log_(log) {
+        cached_bytes_ = 0;
+        inotify_fd_ = -1;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    StaticFiles::~StaticFiles() {
+        if (inotify_fd_ >= 0) {
+            close(inotify_fd_);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> StaticFiles::load(
+        const string &directory,
+        StaticFilesConfig config
+    ) {
+        std::error_code ec;
+        {
+            std::lock_guard lock(mutex_);
+
+            root_ = fs::canonical(directory, ec);
+            if (ec || !fs::is_directory(root_)) {
+                log_.error("Static directory not found: {}", directory);
+                return unexpected(format("Static directory not found: {}", directory));
+            }
+
+            config_ = config;
+            entries_.clear();
+            lru_.clear();
+            cached_bytes_ = 0;
+        }
+
+        auto options = fs::directory_options::skip_permission_denied;
+        for (auto it = fs::recursive_directory_iterator(root_, options, ec);
+             !ec && it != fs::recursive_directory_iterator();
+             it.increment(ec)) {
+            if (it->is_regular_file()) {
+                addFile(it->path(), CompressionLevel::Best);
+            }
+        }
+
+        if (ec) {
+            log_.error("Error walking {}: {}", directory, ec.message());
+            return unexpected(format("Error walking {}: {}", directory, ec.message()));
+        }
+
+        std::shared_lock lock(mutex_);
+        log_.info(
+            "Serving {} static file(s) from {} ({} bytes cached)",
+            entries_.size(),
+            root_.string(),
+            cached_bytes_
+        );
+
+        return {};
+    }
+
+    int StaticFiles::serve(
+        string_view path,
+        const RequestHead &head,
+        string_view connection,
+        OutputQueue &out
+    ) {
+        std::shared_lock lock(mutex_);
+
+        auto it = entries_.find(path);
+        if (it == entries_.end()) {
+            return 0;
+        }
+
+        shared_ptr<Entry> held = it->second;
+        Entry &entry = *held;
+
+        // An evicted file is read back by the first request to miss it,
+        // outside the lock, while the others are served from disk.
+        if (entry.cached == 0 && cacheable(entry) && !entry.warming.exchange(true)) {
+            lock.unlock();
+            Bodies bodies = readBodies(entry, CompressionLevel::Fast);
+            {
+                std::lock_guard exclusive(mutex_);
+                cacheBodies(entry, std::move(bodies), CompressionLevel::Fast);
+            }
+            entry.warming = false;
+            lock.lock();
+        }
+
+        if (!entry.referenced.load(std::memory_order_relaxed)) {
+            entry.referenced.store(true, std::memory_order_relaxed);
+        }
+
+        Encoding encoding = Encoding::Identity;
+        if (entry.compressible) {
+            encoding = negotiateEncoding(
+                head.header("Accept-Encoding"),
+                offers(entry, Encoding::Gzip),
+                offers(entry, Encoding::Brotli)
+            );
+        }
+        Variant &variant = entry.variants[static_cast<size_t>(encoding)];
+
+        if (head.header("If-None-Match") == variant.etag) {
+            out.append(variant.not_modified, *variant.not_modified);
+            appendTrailer(out, connection);
+            return 304;
+        }
+
+        shared_ptr<const string> header = variant.header;
+        bool head_only = head.method == "HEAD";
+
+        if (head_only) {
+            out.append(header, *header);
+            appendTrailer(out, connection);
+            return 200;
+        }
+
+        shared_ptr<const string> body = variant.body;
+        if (body) {
+            out.append(header, *header);
+            appendTrailer(out, connection);
+            out.append(body, *body);
+            return 200;
+        }
+
+        fs::path file = variant.file;
+        size_t size = variant.size;
+        lock.unlock();
+
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            log_.error("Could not open {}", file.string());
+            return 0;
+        }
+
+        out.append(header, *header);
+        appendTrailer(out, connection);
+        out.appendFile(std::make_shared<FileHandle>(fd), 0, size);
+        return 200;
+    }
+
+    bool StaticFiles::empty() const {
+        return entries_.empty();
+    }
+
+    expected<void, string> StaticFiles::watch() {
+        if (root_.empty()) {
+            return unexpected("No static directory loaded");
+        }
+
+        if (inotify_fd_ < 0) {
+            inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (inotify_fd_ < 0) {
+                log_.error("inotify_init1 failed: {}", strerror(errno));
+                return unexpected("inotify_init1 failed");
+            }
+        }
+
+        addWatch(root_);
+        return {};
+    }
+
+    int StaticFiles::watchFd() const {
+        return inotify_fd_;
+    }
+
+    size_t StaticFiles::handleWatchEvents(ThreadPool *pool) {
+        alignas(inotify_event) char buffer[16384];
+        size_t changed = 0;
+
+        while (true) {
+            ssize_t bytes = read(inotify_fd_, buffer, sizeof(buffer));
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+
+            if (bytes <= 0) {
+                break;
+            }
+
+            for (char *p = buffer; p < buffer + bytes;) {
+                auto *event = reinterpret_cast<inotify_event *>(p);
+                p += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    log_.warn("inotify queue overflowed, some changes were missed");
+                    continue;
+                }
+
+                auto dir = watch_dirs_.find(event->wd);
+                if (dir == watch_dirs_.end()) {
+                    continue;
+                }
+
+                if (event->mask & IN_IGNORED) {
+                    watch_dirs_.erase(dir);
+                    continue;
+                }
+
+                if (event->len == 0) {
+                    continue;
+                }
+
+                fs::path path = dir->second / event->name;
+                bool is_dir = event->mask & IN_ISDIR;
+
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    changed += is_dir ? removeDirectory(path) : removeFile(path);
+                } else if (is_dir && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    changed += addWatch(path);
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB)) {
+                    changed += addFile(path, CompressionLevel::Fast) ? 1 : 0;
+                }
+            }
+        }
+
+        if (changed > 0) {
+            log_.info("{} static file(s) changed, cache invalidated", changed);
+        }
+
+        // The changes went out compressed at the fast level so this loop
+        // was not held up; the best level follows off it.
+        for (shared_ptr<Entry> &entry : recompress_) {
+            if (pool) {
+                pool->submit([this, entry = std::move(entry)] {
+                    recompress(entry);
+                });
+            } else {
+                recompress(entry);
+            }
+        }
+        recompress_.clear();
+
+        return changed;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool StaticFiles::addFile(const fs::path &file, CompressionLevel level) {
+        struct stat info;
+        if (stat(file.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            return false;
+        }
+
+        string url = urlFor(file);
+        refreshOriginal(file, level);
+
+        auto entry = std::make_shared<Entry>();
+        entry->content_type = mimeType(file.extension().string());
+        entry->last_modified = httpDate(info.st_mtim.tv_sec);
+        entry->compressible = config_.compress && isCompressible(entry->content_type);
+        entry->lru = lru_.end();
+
+        Variant &plain = entry->variants[0];
+        plain.file = file;
+        plain.size = info.st_size;
+        plain.etag = format(
+            "\"{:x}.{:x}-{:x}\"",
+            (long long)info.st_mtim.tv_sec,
+            (long long)info.st_mtim.tv_nsec,
+            (long long)info.st_size
+        );
+        describe(*entry, Encoding::Identity, CompressionLevel::Best);
+
+        // siblings older than the file are left over from an earlier version
+        for (const Sibling &sibling : siblings) {
+            struct stat sibling_info;
+            fs::path path = file;
+            path += sibling.extension;
+            if (!entry->compressible
+                || stat(path.c_str(), &sibling_info) != 0
+                || !S_ISREG(sibling_info.st_mode)
+                || sibling_info.st_mtim.tv_sec < info.st_mtim.tv_sec) {
+                continue;
+            }
+
+            Variant &variant = entry->variants[static_cast<size_t>(sibling.encoding)];
+            variant.file = path;
+            variant.size = sibling_info.st_size;
+            describe(*entry, sibling.encoding, CompressionLevel::Best);
+        }
+
+        // compressed here once rather than per request
+        Bodies bodies;
+        if (cacheable(*entry)) {
+            bodies = readBodies(*entry, level);
+        }
+
+        std::lock_guard lock(mutex_);
+
+        auto old = entries_.find(url);
+        if (old != entries_.end()) {
+            retire(*old->second);
+        }
+
+        if (file.filename() == "index.html") {
+            entries_.insert_or_assign(url.substr(0, url.size() - 10), entry);
+        }
+
+        entries_.insert_or_assign(url, entry);
+        cacheBodies(*entry, std::move(bodies), level);
+
+        if (level == CompressionLevel::Fast && entry->compressible && entry->cached > 0) {
+            recompress_.push_back(entry);
+        }
+
+        return true;
+    }
+
+    void StaticFiles::refreshOriginal(const fs::path &file, CompressionLevel level) {
+        // a changed sibling changes what its original offers
+        for (const Sibling &sibling : siblings) {
+            if (file.extension() != sibling.extension) {
+                continue;
+            }
+
+            fs::path original = file;
+            original.replace_extension();
+
+            bool known = false;
+            {
+                std::shared_lock lock(mutex_);
+                known = entries_.contains(urlFor(original));
+            }
+
+            if (known) {
+                addFile(original, level);
+            }
+        }
+    }
+
+    // Swaps the fast bodies for best ones in one go under the lock, unless
+    // the file changed or was evicted while they were being compressed.
+    void StaticFiles::recompress(const shared_ptr<Entry> &entry) {
+        Bodies bodies = readBodies(*entry, CompressionLevel::Best);
+        if (!bodies[0]) {
+            return;
+        }
+
+        std::lock_guard lock(mutex_);
+        if (entry->retired || entry->cached == 0) {
+            return;
+        }
+
+        dropBody(*entry);
+        cacheBodies(*entry, std::move(bodies), CompressionLevel::Best);
+    }
+
+    size_t StaticFiles::removeFile(const fs::path &file) {
+        string url = urlFor(file);
+        {
+            std::lock_guard lock(mutex_);
+
+            auto it = entries_.find(url);
+            if (it == entries_.end()) {
+                return 0;
+            }
+
+            retire(*it->second);
+            entries_.erase(it);
+
+            if (file.filename() == "index.html") {
+                entries_.erase(url.substr(0, url.size() - 10));
+            }
+        }
+
+        refreshOriginal(file, CompressionLevel::Fast);
+        return 1;
+    }
+
+    size_t StaticFiles::removeDirectory(const fs::path &dir) {
+        string prefix = urlFor(dir) + "/";
+        size_t removed = 0;
+
+        for (auto it = watch_dirs_.begin(); it != watch_dirs_.end();) {
+            if (it->second == dir || urlFor(it->second).starts_with(prefix)) {
+                inotify_rm_watch(inotify_fd_, it->first);
+                it = watch_dirs_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::lock_guard lock(mutex_);
+
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (it->first.starts_with(prefix)) {
+                retire(*it->second);
+                it = entries_.erase(it);
+                ++removed;
+            } else {
+                ++it;
+            }
+        }
+
+        return removed;
+    }
+
+    size_t StaticFiles::addWatch(const fs::path &dir) {
+        constexpr uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+            | IN_CREATE | IN_DELETE | IN_ATTRIB | IN_ONLYDIR;
+
+        size_t added = 0;
+        std::error_code ec;
+        auto options = fs::directory_options::skip_permission_denied;
+
+        int wd = inotify_add_watch(inotify_fd_, dir.c_str(), mask);
+        if (wd >= 0) {
+            watch_dirs_[wd] = dir;
+        }
+
+        for (auto it = fs::recursive_directory_iterator(dir, options, ec);
+             !ec && it != fs::recursive_directory_iterator();
+             it.increment(ec)) {
+            if (it->is_directory()) {
+                wd = inotify_add_watch(inotify_fd_, it->path().c_str(), mask);
+                if (wd >= 0) {
+                    watch_dirs_[wd] = it->path();
+                }
+            } else if (it->is_regular_file() && dir != root_) {
+                added += addFile(it->path(), CompressionLevel::Fast) ? 1 : 0;
+            }
+        }
+
+        return added;
+    }
+
+    string StaticFiles::urlFor(const fs::path &file) const {
+        return "/" + file.lexically_relative(root_).generic_string();
+    }
+
+    void StaticFiles::describe(Entry &entry, Encoding encoding, CompressionLevel level) {
+        Variant &plain = entry.variants[0];
+        Variant &variant = entry.variants[static_cast<size_t>(encoding)];
+
+        // Each encoding is its own representation, so it gets its own
+        // tag, and caches are told the choice depends on the request. A
+        // fast recompression is different bytes from the best one.
+        string extra;
+        if (encoding != Encoding::Identity) {
+            variant.etag = format(
+                "{}-{}{}\"",
+                string_view(plain.etag).substr(0, plain.etag.size() - 1),
+                encodingName(encoding),
+                level == CompressionLevel::Fast ? "-fast" : ""
+            );
+            extra = format("Content-Encoding: {}\r\n", encodingName(encoding));
+        }
+
+        if (entry.compressible) {
+            extra += "Vary: Accept-Encoding\r\n";
+        }
+
+        variant.header = std::make_shared<const string>(format(
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: {}\r\n"
+            "Content-Length: {}\r\n"
+            "{}"
+            "ETag: {}\r\n"
+            "Last-Modified: {}\r\n",
+            entry.content_type,
+            variant.size,
+            extra,
+            variant.etag,
+            entry.last_modified
+        ));
+        variant.not_modified = std::make_shared<const string>(format(
+            "HTTP/1.1 304 Not Modified\r\n"
+            "{}"
+            "ETag: {}\r\n"
+            "Last-Modified: {}\r\n",
+            entry.compressible ? "Vary: Accept-Encoding\r\n" : "",
+            variant.etag,
+            entry.last_modified
+        ));
+    }
+
+    bool StaticFiles::offers(const Entry &entry, Encoding encoding) const {
+        const Variant &variant = entry.variants[static_cast<size_t>(encoding)];
+        return variant.header && (variant.body || !variant.file.empty());
+    }
+
+    bool StaticFiles::cacheable(const Entry &entry) const {
+        size_t size = entry.variants[0].size;
+        return size <= config_.max_cached_file_size && size <= config_.cache_budget;
+    }
+
+    // Reads only what does not change once an entry is published, so it
+    // runs without the lock.
+    StaticFiles::Bodies StaticFiles::readBodies(const Entry &entry, CompressionLevel level) {
+        Bodies bodies;
+        const Variant &plain = entry.variants[0];
+
+        string data;
+        if (!readFile(plain.file, data) || data.size() != plain.size) {
+            return bodies;
+        }
+
+        bodies[0] = std::make_shared<const string>(std::move(data));
+        if (!entry.compressible) {
+            return bodies;
+        }
+
+        // an encoding that saves nothing is not offered
+        for (Encoding encoding : encodings) {
+            size_t index = static_cast<size_t>(encoding);
+            const Variant &variant = entry.variants[index];
+
+            string encoded;
+            if (!variant.file.empty()) {
+                if (!readFile(variant.file, encoded) || encoded.size() != variant.size) {
+                    continue;
+                }
+            } else {
+                bool compressed = Compressor::local().compress(
+                    encoding,
+                    *bodies[0],
+                    level,
+                    encoded
+                );
+                if (!compressed || encoded.size() >= plain.size) {
+                    continue;
+                }
+            }
+
+            bodies[index] = std::make_shared<const string>(std::move(encoded));
+        }
+
+        return bodies;
+    }
+
+    void StaticFiles::cacheBodies(Entry &entry, Bodies bodies, CompressionLevel level) {
+        if (!bodies[0] || entry.cached > 0 || entry.retired) {
+            return;
+        }
+
+        size_t cached = 0;
+        for (Encoding encoding : {Encoding::Identity, Encoding::Gzip, Encoding::Brotli}) {
+            size_t index = static_cast<size_t>(encoding);
+            Variant &variant = entry.variants[index];
+            if (!bodies[index]) {
+                continue;
+            }
+
+            if (encoding != Encoding::Identity && variant.file.empty()) {
+                variant.size = bodies[index]->size();
+                describe(entry, encoding, level);
+            }
+
+            cached += bodies[index]->size();
+            variant.body = std::move(bodies[index]);
+        }
+
+        evict(cached);
+
+        lru_.push_front(&entry);
+        entry.lru = lru_.begin();
+        entry.cached = cached;
+        cached_bytes_ += cached;
+    }
+
+    void StaticFiles::dropBody(Entry &entry) {
+        if (entry.cached == 0) {
+            return;
+        }
+
+        if (entry.lru != lru_.end()) {
+            lru_.erase(entry.lru);
+            entry.lru = lru_.end();
+        }
+
+        cached_bytes_ -= entry.cached;
+        entry.cached = 0;
+        for (Variant &variant : entry.variants) {
+            variant.body = nullptr;
+        }
+    }
+
+    // a request still holding a replaced entry must not cache into it
+    void StaticFiles::retire(Entry &entry) {
+        dropBody(entry);
+        entry.retired = true;
+    }
+
+    bool StaticFiles::readFile(const fs::path &file, string &data) {
+        std::ifstream stream(file, std::ios::binary);
+        if (!stream) {
+            return false;
+        }
+
+        std::error_code ec;
+        size_t size = fs::file_size(file, ec);
+        if (ec) {
+            return false;
+        }
+
+        data.resize(size);
+        stream.read(data.data(), data.size());
+        return bool(stream);
+    }
+
+    void StaticFiles::evict(size_t incoming) {
+        while (!lru_.empty() && cached_bytes_ + incoming > config_.cache_budget) {
+            Entry &oldest = *lru_.back();
+            if (oldest.referenced.exchange(false, std::memory_order_relaxed)) {
+                lru_.splice(lru_.begin(), lru_, oldest.lru);
+                continue;
+            }
+
+            dropBody(oldest);
+        }
+    }
+}
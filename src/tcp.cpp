@@ -69,7 +69,7 @@ namespace http {
         );
 
         if (opt_res < 0) {
-            log_.error(format("setsockopt failed: {}", strerror(errno)));
+            log_.error("setsockopt failed: {}", strerror(errno));
             return unexpected(format("setsockopt failed", strerror(errno)));
         }
 
@@ -94,7 +94,7 @@ namespace http {
             return unexpected("Listen failed");
         }
 
-        log_.info(format("Server listening on port {}...", port));
+        log_.info("Server listening on port {}...", port);
 
         return {};
     }
@@ -114,7 +114,7 @@ namespace http {
             return unexpected("Accept failed");
         }
 
-        log_.info(format("Client socket created: {}", client_socket.get()));
+        log_.debug("Client socket created: {}", client_socket.get());
 
         char client_ip[INET_ADDRSTRLEN];
         const char *inet_ntop_res = inet_ntop(
@@ -128,11 +128,11 @@ namespace http {
             log_.error("inet_ntop failed");
         }
 
-        log_.info(format(
+        log_.debug(
             "Connection accepted from {}:{}",
             client_ip,
             ntohs(addr.sin_port)
-        ));
+        );
 
         return {};
     }
@@ -153,10 +153,10 @@ namespace http {
                 return unexpected("Accept failed");
             }
 
-            log_.info(format(
+            log_.debug(
                 "Client socket created: {}",
                 client_socket.get()
-            ));
+            );
 
             char client_ip[INET_ADDRSTRLEN];
             const char *inet_ntop_res = inet_ntop(
@@ -170,11 +170,11 @@ namespace http {
                 log_.error("inet_ntop failed");
             }
 
-            log_.info(format(
+            log_.debug(
                 "Connection accepted from {}:{}",
                 client_ip,
                 ntohs(addr.sin_port)
-            ));
+            );
         }
 
         return {};
@@ -196,10 +196,10 @@ namespace http {
                 return unexpected("Accept failed");
             }
 
-            log_.info(format(
+            log_.debug(
                 "Client socket created: {}",
                 client_socket.get()
-            ));
+            );
 
             char client_ip[INET_ADDRSTRLEN];
             const char *inet_ntop_res = inet_ntop(
@@ -213,11 +213,11 @@ namespace http {
                 log_.error("inet_ntop failed");
             }
 
-            log_.info(format(
+            log_.debug(
                 "Connection accepted from {}:{}",
                 client_ip,
                 ntohs(addr.sin_port)
-            ));
+            );
 
             vector<char> buffer(4096);
             int bytes_received;
@@ -232,9 +232,9 @@ namespace http {
                 if (bytes_received > 0) {
                     buffer[bytes_received] = '\0';
                     string message(buffer.data());
-                    log_.info(format("{}", message));
+                    log_.info("{}", message);
                 } else if (bytes_received == 0) {
-                    log_.info("Client disconnected gracefully");
+                    log_.debug("Client disconnected gracefully");
                     break;
                 } else {
                     if (errno == EINTR) {
@@ -243,10 +243,10 @@ namespace http {
                         log_.error("No data available to read");
                         continue;
                     } else {
-                        log_.error(format(
+                        log_.error(
                             "Error reading from socket: {}",
                             strerror(errno)
-                        ));
+                        );
                         break;
                     }
                 }
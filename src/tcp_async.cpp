@@ -1,5 +1,4 @@
 #include <expected>
-#include <format>
 #include <string>
 
 #include <sys/socket.h>
@@ -15,7 +14,6 @@
 using std::unexpected;
 using std::expected;
 using std::string;
-using std::format;
 
 namespace http {
     TcpAsync::TcpAsync() : log_(false, false) {
@@ -96,7 +94,7 @@ namespace http {
         event_.data.fd = server_socket_;
         epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, server_socket_, &event_);
 
-        log_.info(format("Server listening on port {}...", port));
+        log_.info("Server listening on port {}...", port);
 
         return {};
     }
@@ -116,15 +114,15 @@ namespace http {
             return unexpected("Accept failed");
         }
 
-        log_.info(format("Client socket created: {}", client_socket));
+        log_.debug("Client socket created: {}", client_socket);
 
         char client_ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &(addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        log_.info(format(
+        log_.debug(
             "Connection accepted from {}:{}",
             client_ip,
             ntohs(addr.sin_port)
-        ));
+        );
 
         return {};
     }
@@ -154,16 +152,16 @@ namespace http {
                     client_event.data.fd = client_socket;
                     epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client_socket, &client_event);
 
-                    log_.info(format("Client socket created: {}", client_socket));
+                    log_.debug("Client socket created: {}", client_socket);
                 } else {
                     char buffer[buffer_size_];
                     int bytes = read(events_[i].data.fd, buffer, sizeof(buffer) - 1);
                     if (bytes <= 0) {
                         closeSocket(events_[i].data.fd);
-                        log_.info(format("Closed connection: {}", (int)events_[i].data.fd));
+                        log_.debug("Closed connection: {}", (int)events_[i].data.fd);
                     } else {
                         buffer[bytes] = '\0';
-                        log_.info(format("Received from {}: {}", (int)events_[i].data.fd, buffer));
+                        log_.debug("Received from {}: {}", (int)events_[i].data.fd, buffer);
                         send(events_[i].data.fd, buffer, bytes, 0);
                     }
                 }
@@ -189,15 +187,15 @@ namespace http {
                 return unexpected("Accept failed");
             }
 
-            log_.info(format("Client socket created: {}", client_socket));
+            log_.debug("Client socket created: {}", client_socket);
 
             char client_ip[INET_ADDRSTRLEN];
             inet_ntop(AF_INET, &(addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-            log_.info(format(
+            log_.debug(
                 "Connection accepted from {}:{}",
                 client_ip,
                 ntohs(addr.sin_port)
-            ));
+            );
 
             char buffer[4096] = {0};
             int bytes_received;
@@ -205,7 +203,7 @@ namespace http {
             while ((bytes_received = read(client_socket, buffer, sizeof(buffer) - 1)) > 0) {
                 buffer[bytes_received] = '\0';
                 string message(buffer);
-                log_.info(format("{}", message));
+                log_.info("{}", message);
             }
 
             closeSocket(client_socket);
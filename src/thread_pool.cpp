@@ -0,0 +1,170 @@
+#include <cstddef>
+#include <utility>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+
+#include "thread_pool.hpp"
+
+using std::size_t;
+
+namespace http {
+    namespace {
+        // Lets a task that submits more work push onto its own worker's
+        // deque instead of going round-robin.
+        thread_local const ThreadPool *current_pool = nullptr;
+        thread_local size_t current_worker = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    ThreadPool::ThreadPool(size_t threads) {
+        next_worker_ = 0;
+        queued_ = 0;
+        sleepers_ = 0;
+        running_ = true;
+
+        if (threads == 0) {
+            threads = 1;
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+
+        for (size_t i = 0; i < threads; i++) {
+            threads_.emplace_back([this, i] {
+                run(i);
+            });
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard lock(sleep_mutex_);
+            running_ = false;
+        }
+
+        wake_.notify_all();
+        for (std::thread &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void ThreadPool::submit(Task task) {
+        bool own = current_pool == this;
+        size_t index = own
+            ? current_worker
+            : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+        // Counting the task before reading sleepers_, while a worker
+        // registers as a sleeper before reading queued_, means one of the
+        // two always sees the other; the mutex is only needed to wake one.
+        queued_.fetch_add(1, std::memory_order_seq_cst);
+
+        Worker &worker = *workers_[index];
+        {
+            std::lock_guard lock(worker.mutex);
+            (own ? worker.local : worker.injected).push_back(std::move(task));
+        }
+
+        // under the mutex, so the wake cannot fall between a sleeper's
+        // check and its wait
+        if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard lock(sleep_mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    size_t ThreadPool::size() const {
+        return workers_.size();
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool ThreadPool::pop(size_t index, Task &task) {
+        Worker &worker = *workers_[index];
+        std::lock_guard lock(worker.mutex);
+
+        if (!worker.local.empty()) {
+            task = std::move(worker.local.back());
+            worker.local.pop_back();
+            return true;
+        }
+
+        if (!worker.injected.empty()) {
+            task = std::move(worker.injected.front());
+            worker.injected.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::steal(size_t index, Task &task) {
+        for (size_t i = 1; i < workers_.size(); i++) {
+            Worker &victim = *workers_[(index + i) % workers_.size()];
+            std::unique_lock lock(victim.mutex, std::try_to_lock);
+
+            if (!lock.owns_lock()) {
+                continue;
+            }
+
+            std::deque<Task> &tasks = victim.injected.empty()
+                ? victim.local
+                : victim.injected;
+            if (tasks.empty()) {
+                continue;
+            }
+
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+
+        return false;
+    }
+
+    void ThreadPool::run(size_t index) {
+        current_pool = this;
+        current_worker = index;
+
+        Task task;
+        while (true) {
+            if (pop(index, task) || steal(index, task)) {
+                queued_.fetch_sub(1, std::memory_order_relaxed);
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex_);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            if (queued_.load(std::memory_order_seq_cst) > 0) {
+                // counted but not pushed yet, or a victim was busy during
+                // the try_lock pass; go again
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (!running_) {
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+
+            wake_.wait(lock, [this] {
+                return !running_ || queued_.load(std::memory_order_relaxed) > 0;
+            });
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <bit>
+
+#include "timer_wheel.hpp"
+
+using std::uint64_t;
+
+namespace http {
+    ///////////////////////////////////////////////////////////////////////////
+    // timer
+    ///////////////////////////////////////////////////////////////////////////
+    Timer::Timer(const Timer &) {
+    }
+
+    Timer &Timer::operator=(const Timer &other) {
+        if (this != &other) {
+            cancel();
+            fd_ = -1;
+        }
+
+        return *this;
+    }
+
+    Timer::~Timer() {
+        cancel();
+    }
+
+    bool Timer::armed() const {
+        return next_ != nullptr;
+    }
+
+    void Timer::cancel() {
+        if (!next_) {
+            return;
+        }
+
+        // the slot's bit stays set until the wheel next looks at it
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = nullptr;
+        next_ = nullptr;
+    }
+
+    int Timer::fd() const {
+        return fd_;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    TimerWheel::TimerWheel() {
+        for (unsigned level = 0; level < levels_; ++level) {
+            for (Timer &head : heads_[level]) {
+                head.prev_ = &head;
+                head.next_ = &head;
+            }
+
+            occupied_[level] = 0;
+        }
+
+        current_ = 0;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    TimerWheel::~TimerWheel() {
+        // timers outliving the wheel are left disarmed, not dangling
+        for (unsigned level = 0; level < levels_; ++level) {
+            for (Timer &head : heads_[level]) {
+                while (head.next_ != &head) {
+                    head.next_->cancel();
+                }
+
+                head.prev_ = nullptr;
+                head.next_ = nullptr;
+            }
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void TimerWheel::arm(Timer &timer, uint64_t expires, int fd) {
+        timer.cancel();
+        timer.fd_ = fd;
+
+        // never into the slot being expired, or it would fire this turn
+        timer.expires_ = std::max(expires, current_ + 1);
+        place(timer);
+    }
+
+    Timer *TimerWheel::expire(uint64_t now) {
+        while (true) {
+            Timer &head = heads_[0][current_ & mask_];
+            if (head.next_ != &head) {
+                Timer *timer = head.next_;
+                timer->cancel();
+                return timer;
+            }
+
+            occupied_[0] &= ~(uint64_t(1) << (current_ & mask_));
+            if (current_ >= now) {
+                return nullptr;
+            }
+
+            // Nothing sits in the slots passed over, so the wheel can
+            // jump straight to the next one that has work.
+            uint64_t due = next();
+            if (due > now) {
+                current_ = now;
+                return nullptr;
+            }
+
+            current_ = due;
+            for (unsigned level = 1; level < levels_; ++level) {
+                uint64_t span = uint64_t(1) << (level * level_bits_);
+                if ((current_ & (span - 1)) != 0) {
+                    break;
+                }
+
+                cascade(level);
+            }
+        }
+    }
+
+    uint64_t TimerWheel::next() const {
+        uint64_t due = std::numeric_limits<uint64_t>::max();
+
+        for (unsigned level = 0; level < levels_; ++level) {
+            if (occupied_[level] == 0) {
+                continue;
+            }
+
+            // first occupied slot after the current one, wrapping round
+            unsigned shift = level * level_bits_;
+            uint64_t base = current_ >> shift;
+            int start = static_cast<int>((base + 1) & mask_);
+            uint64_t rotated = std::rotr(occupied_[level], start);
+            uint64_t block = base + 1 + std::countr_zero(rotated);
+            due = std::min(due, block << shift);
+        }
+
+        return due;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    void TimerWheel::place(Timer &timer) {
+        uint64_t delta = timer.expires_ - current_;
+        unsigned level = 0;
+        if (delta >= slots_) {
+            level = (std::bit_width(delta) - 1) / level_bits_;
+        }
+
+        if (level >= levels_) {
+            level = levels_ - 1;
+            timer.expires_ = current_ + (uint64_t(1) << (levels_ * level_bits_)) - 1;
+        }
+
+        uint64_t index = (timer.expires_ >> (level * level_bits_)) & mask_;
+        Timer &head = heads_[level][index];
+        timer.prev_ = head.prev_;
+        timer.next_ = &head;
+        head.prev_->next_ = &timer;
+        head.prev_ = &timer;
+        occupied_[level] |= uint64_t(1) << index;
+    }
+
+    void TimerWheel::cascade(unsigned level) {
+        uint64_t index = (current_ >> (level * level_bits_)) & mask_;
+        Timer &head = heads_[level][index];
+
+        // everything here is due within this slot's span, so it always
+        // lands in a lower level
+        while (head.next_ != &head) {
+            Timer *timer = head.next_;
+            timer->cancel();
+            place(*timer);
+        }
+
+        occupied_[level] &= ~(uint64_t(1) << index);
+    }
+}
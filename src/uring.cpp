@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <expected>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "uring.hpp"
+
+using std::unexpected;
+using std::expected;
+using std::uint16_t;
+using std::uint64_t;
+using std::size_t;
+using std::string;
+
+namespace http {
+    namespace {
+        void *mapRing(int fd, size_t size, uint64_t offset) {
+            void *ring = mmap(
+                nullptr,
+                size,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                fd,
+                offset
+            );
+
+            return ring == MAP_FAILED ? nullptr : ring;
+        }
+
+        void *mapAnonymous(size_t size) {
+            void *memory = mmap(
+                nullptr,
+                size,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                -1,
+                0
+            );
+
+            return memory == MAP_FAILED ? nullptr : memory;
+        }
+
+        template <typename T>
+        T *at(void *base, unsigned offset) {
+            return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    Uring::Uring() {
+        ring_fd_ = -1;
+        sq_ring_ = nullptr;
+        cq_ring_ = nullptr;
+        sq_ring_size_ = 0;
+        cq_ring_size_ = 0;
+        sqes_ = nullptr;
+        sqes_size_ = 0;
+        sq_head_ = nullptr;
+        sq_tail_ = nullptr;
+        sq_flags_ = nullptr;
+        sq_mask_ = 0;
+        sq_entries_ = 0;
+        cq_head_ = nullptr;
+        cq_tail_ = nullptr;
+        cq_mask_ = 0;
+        cqes_ = nullptr;
+        local_tail_ = 0;
+        to_submit_ = 0;
+        buf_ring_ = nullptr;
+        buf_ring_size_ = 0;
+        buffers_ = nullptr;
+        buffers_size_ = 0;
+        buf_count_ = 0;
+        buf_size_ = 0;
+        buf_tail_ = 0;
+        buf_group_ = 0;
+        legacy_buffers_ = false;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // destructor
+    ///////////////////////////////////////////////////////////////////////////
+    Uring::~Uring() {
+        // closing the ring cancels whatever is still in flight
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+        }
+
+        if (buffers_) {
+            munmap(buffers_, buffers_size_);
+        }
+
+        if (buf_ring_) {
+            munmap(buf_ring_, buf_ring_size_);
+        }
+
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+
+        if (cq_ring_ && cq_ring_ != sq_ring_) {
+            munmap(cq_ring_, cq_ring_size_);
+        }
+
+        if (sq_ring_) {
+            munmap(sq_ring_, sq_ring_size_);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> Uring::open(unsigned entries) {
+        // Multishot receives and provided buffers arrive in bursts, so the
+        // completion ring gets more room than the submission ring.
+        io_uring_params params {};
+        params.flags = IORING_SETUP_CQSIZE
+            | IORING_SETUP_SUBMIT_ALL
+            | IORING_SETUP_COOP_TASKRUN
+            | IORING_SETUP_TASKRUN_FLAG
+            | IORING_SETUP_SINGLE_ISSUER;
+        params.cq_entries = entries * 4;
+
+        ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        if (ring_fd_ < 0 && errno == EINVAL) {
+            params = {};
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = entries * 4;
+            ring_fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        }
+
+        if (ring_fd_ < 0) {
+            return unexpected(std::format("io_uring_setup failed: {}", strerror(errno)));
+        }
+
+        if (!(params.features & IORING_FEAT_EXT_ARG)) {
+            return unexpected("io_uring lacks IORING_FEAT_EXT_ARG");
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+            cq_ring_size_ = sq_ring_size_;
+        }
+
+        sq_ring_ = mapRing(ring_fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+        if (!sq_ring_) {
+            return unexpected(std::format("Could not map io_uring: {}", strerror(errno)));
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = mapRing(ring_fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+            if (!cq_ring_) {
+                return unexpected(std::format("Could not map io_uring: {}", strerror(errno)));
+            }
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(mapRing(ring_fd_, sqes_size_, IORING_OFF_SQES));
+        if (!sqes_) {
+            return unexpected(std::format("Could not map io_uring: {}", strerror(errno)));
+        }
+
+        sq_head_ = at<unsigned>(sq_ring_, params.sq_off.head);
+        sq_tail_ = at<unsigned>(sq_ring_, params.sq_off.tail);
+        sq_flags_ = at<unsigned>(sq_ring_, params.sq_off.flags);
+        sq_mask_ = *at<unsigned>(sq_ring_, params.sq_off.ring_mask);
+        sq_entries_ = params.sq_entries;
+        cq_head_ = at<unsigned>(cq_ring_, params.cq_off.head);
+        cq_tail_ = at<unsigned>(cq_ring_, params.cq_off.tail);
+        cq_mask_ = *at<unsigned>(cq_ring_, params.cq_off.ring_mask);
+        cqes_ = at<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+        // SQEs are always used in ring order, so the index array is fixed
+        unsigned *array = at<unsigned>(sq_ring_, params.sq_off.array);
+        for (unsigned i = 0; i < sq_entries_; ++i) {
+            array[i] = i;
+        }
+
+        local_tail_ = *sq_tail_;
+        return checkSupport();
+    }
+
+    expected<void, string> Uring::provideBuffers(
+        unsigned count,
+        unsigned size,
+        uint16_t group
+    ) {
+        if (count == 0 || (count & (count - 1)) != 0 || count > 32768) {
+            return unexpected("Buffer count must be a power of two up to 32768");
+        }
+
+        buf_ring_size_ = count * sizeof(io_uring_buf);
+        buf_ring_ = static_cast<io_uring_buf_ring *>(mapAnonymous(buf_ring_size_));
+        if (!buf_ring_) {
+            return unexpected(std::format("Could not map buffer ring: {}", strerror(errno)));
+        }
+
+        buffers_size_ = static_cast<size_t>(count) * size;
+        buffers_ = static_cast<char *>(mapAnonymous(buffers_size_));
+        if (!buffers_) {
+            return unexpected(std::format("Could not map buffers: {}", strerror(errno)));
+        }
+
+        io_uring_buf_reg reg {};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = count;
+        reg.bgid = group;
+
+        int res = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1);
+        if (res < 0) {
+            return unexpected(std::format(
+                "Could not register buffer ring: {}", strerror(errno)
+            ));
+        }
+
+        buf_count_ = count;
+        buf_size_ = size;
+        buf_group_ = group;
+        for (unsigned id = 0; id < count; ++id) {
+            recycle(id);
+        }
+
+        // Some kernels accept the ring but never hand its buffers out;
+        // those get the same buffers through IORING_OP_PROVIDE_BUFFERS.
+        if (!bufferRingWorks()) {
+            syscall(__NR_io_uring_register, ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+            legacy_buffers_ = true;
+            for (unsigned id = 0; id < count; ++id) {
+                returned_.push_back(id);
+            }
+            provideReturned();
+        }
+
+        return {};
+    }
+
+    io_uring_sqe *Uring::sqe() {
+        unsigned head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+        if (local_tail_ - head >= sq_entries_ && !flush()) {
+            return nullptr;
+        }
+
+        io_uring_sqe *sqe = &sqes_[local_tail_ & sq_mask_];
+        std::memset(sqe, 0, sizeof(*sqe));
+        local_tail_++;
+        to_submit_++;
+        return sqe;
+    }
+
+    int Uring::submitAndWait(int timeout_ms) {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+        unsigned flags = std::atomic_ref(*sq_flags_).load(std::memory_order_relaxed);
+
+        if (!returned_.empty()) {
+            provideReturned();
+        }
+
+        int res = 0;
+        if (head != tail || !reaped_.empty() || timeout_ms == 0) {
+            // Completions are already waiting; only go into the kernel if
+            // there is something to hand over or deferred work to run.
+            if (to_submit_ > 0 || (flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW))) {
+                res = enter(to_submit_, 0, 0);
+            }
+        } else {
+            res = enter(to_submit_, 1, timeout_ms);
+        }
+
+        if (res == -ETIME || res == -EINTR || res == -EAGAIN || res == -EBUSY) {
+            return 0;
+        }
+
+        return res < 0 ? res : 0;
+    }
+
+    unsigned Uring::completions(io_uring_cqe *out, unsigned max) {
+        // whatever flush() set aside came first
+        unsigned count = std::min<size_t>(reaped_.size(), max);
+        if (count > 0) {
+            std::copy_n(reaped_.begin(), count, out);
+            reaped_.erase(reaped_.begin(), reaped_.begin() + count);
+        }
+
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+
+        while (head != tail && count < max) {
+            out[count++] = cqes_[head & cq_mask_];
+            head++;
+        }
+
+        std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+        return count;
+    }
+
+    char *Uring::buffer(uint16_t id) const {
+        return buffers_ + static_cast<size_t>(id) * buf_size_;
+    }
+
+    void Uring::recycle(uint16_t id) {
+        if (legacy_buffers_) {
+            returned_.push_back(id);
+            return;
+        }
+
+        io_uring_buf *buf = &buf_ring_->bufs[buf_tail_ & (buf_count_ - 1)];
+        buf->addr = reinterpret_cast<uint64_t>(buffer(id));
+        buf->len = buf_size_;
+        buf->bid = id;
+
+        buf_tail_++;
+        std::atomic_ref(buf_ring_->tail).store(buf_tail_, std::memory_order_release);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    expected<void, string> Uring::checkSupport() {
+        // multishot receive, which everything else here builds on, landed
+        // in 6.0 and cannot be probed for directly
+        utsname name;
+        int major = 0;
+        int minor = 0;
+        if (uname(&name) == 0) {
+            std::sscanf(name.release, "%d.%d", &major, &minor);
+        }
+
+        if (major < 6) {
+            return unexpected(std::format(
+                "io_uring backend needs Linux 6.0 or newer, found {}", name.release
+            ));
+        }
+
+        constexpr unsigned max_ops = 256;
+        std::vector<char> storage(
+            sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op)
+        );
+        auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+
+        int res = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, max_ops);
+        if (res < 0) {
+            return unexpected(std::format("io_uring probe failed: {}", strerror(errno)));
+        }
+
+        for (int op : {
+            IORING_OP_ACCEPT,
+            IORING_OP_RECV,
+            IORING_OP_SENDMSG,
+            IORING_OP_CLOSE,
+            IORING_OP_POLL_ADD,
+            IORING_OP_POLL_REMOVE,
+            IORING_OP_ASYNC_CANCEL,
+        }) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return unexpected(std::format("io_uring lacks opcode {}", op));
+            }
+        }
+
+        return {};
+    }
+
+    bool Uring::bufferRingWorks() {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+            return false;
+        }
+
+        io_uring_sqe *probe = sqe();
+        if (!probe) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+
+        probe->opcode = IORING_OP_RECV;
+        probe->fd = fds[0];
+        probe->flags = IOSQE_BUFFER_SELECT;
+        probe->buf_group = buf_group_;
+
+        io_uring_cqe cqe {};
+        bool received = ::write(fds[1], "x", 1) == 1
+            && enter(to_submit_, 1, 1000) >= 0
+            && completions(&cqe, 1) == 1;
+
+        close(fds[0]);
+        close(fds[1]);
+
+        if (cqe.flags & IORING_CQE_F_BUFFER) {
+            recycle(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        }
+
+        return received && cqe.res == 1;
+    }
+
+    void Uring::provideReturned() {
+        // hand buffers back in runs of consecutive ids, one SQE per run
+        std::sort(returned_.begin(), returned_.end());
+
+        size_t start = 0;
+        for (size_t i = 1; i <= returned_.size(); ++i) {
+            if (i < returned_.size() && returned_[i] == returned_[i - 1] + 1) {
+                continue;
+            }
+
+            // the rest go in with a later turn
+            io_uring_sqe *provide = sqe();
+            if (!provide) {
+                returned_.erase(returned_.begin(), returned_.begin() + start);
+                return;
+            }
+
+            provide->opcode = IORING_OP_PROVIDE_BUFFERS;
+            provide->fd = static_cast<int>(i - start);
+            provide->addr = reinterpret_cast<uint64_t>(buffer(returned_[start]));
+            provide->len = buf_size_;
+            provide->off = returned_[start];
+            provide->buf_group = buf_group_;
+            provide->flags = IOSQE_CQE_SKIP_SUCCESS;
+            start = i;
+        }
+
+        returned_.clear();
+    }
+
+    int Uring::enter(unsigned to_submit, unsigned min_complete, int timeout_ms) {
+        std::atomic_ref(*sq_tail_).store(local_tail_, std::memory_order_release);
+
+        __kernel_timespec ts {};
+        io_uring_getevents_arg arg {};
+        if (min_complete > 0 && timeout_ms >= 0) {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+
+        int res = syscall(
+            __NR_io_uring_enter,
+            ring_fd_,
+            to_submit,
+            min_complete,
+            IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+            &arg,
+            sizeof(arg)
+        );
+
+        if (res < 0) {
+            return -errno;
+        }
+
+        to_submit_ -= std::min<unsigned>(res, to_submit_);
+        return res;
+    }
+
+    // Hands a full submission ring to the kernel. Under CQ overflow it
+    // takes nothing until the completion ring has room, so completions are
+    // set aside for completions() and the submit is tried again.
+    bool Uring::flush() {
+        while (true) {
+            unsigned head = std::atomic_ref(*sq_head_).load(std::memory_order_acquire);
+            if (local_tail_ - head < sq_entries_) {
+                return true;
+            }
+
+            int res = enter(to_submit_, 0, 0);
+            if (res == -EINTR) {
+                continue;
+            }
+
+            if (res < 0 && res != -EBUSY && res != -EAGAIN) {
+                return false;
+            }
+
+            if (std::atomic_ref(*sq_head_).load(std::memory_order_acquire) != head) {
+                continue;
+            }
+
+            unsigned cq_head = *cq_head_;
+            unsigned cq_tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+            if (cq_head == cq_tail) {
+                return false;
+            }
+
+            while (cq_head != cq_tail) {
+                reaped_.push_back(cqes_[cq_head & cq_mask_]);
+                cq_head++;
+            }
+            std::atomic_ref(*cq_head_).store(cq_head, std::memory_order_release);
+        }
+    }
+}
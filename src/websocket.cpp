@@ -0,0 +1,625 @@
+#include <string_view>
+#include <algorithm>
+#include <expected>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <string>
+#include <array>
+
+#include "http_parser.hpp"
+#include "websocket.hpp"
+#include "output.hpp"
+
+using std::string_view;
+using std::shared_ptr;
+using std::unexpected;
+using std::expected;
+using std::uint64_t;
+using std::uint32_t;
+using std::uint16_t;
+using std::string;
+using std::format;
+using std::size_t;
+
+namespace http {
+    namespace {
+        constexpr string_view websocket_guid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        constexpr size_t max_close_reason = 123;
+
+        uint32_t rotateLeft(uint32_t value, int bits) {
+            return (value << bits) | (value >> (32 - bits));
+        }
+
+        std::array<unsigned char, 20> sha1(string_view data) {
+            uint32_t h[5] = {
+                0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+            };
+
+            string message(data);
+            message += '\x80';
+            while (message.size() % 64 != 56) {
+                message += '\0';
+            }
+
+            uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                message += static_cast<char>(bits >> shift);
+            }
+
+            for (size_t block = 0; block < message.size(); block += 64) {
+                const auto *bytes =
+                    reinterpret_cast<const unsigned char *>(message.data() + block);
+
+                uint32_t w[80];
+                for (int i = 0; i < 16; ++i) {
+                    w[i] = (uint32_t)bytes[i * 4] << 24
+                        | (uint32_t)bytes[i * 4 + 1] << 16
+                        | (uint32_t)bytes[i * 4 + 2] << 8
+                        | (uint32_t)bytes[i * 4 + 3];
+                }
+
+                for (int i = 16; i < 80; ++i) {
+                    w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+                }
+
+                uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+                for (int i = 0; i < 80; ++i) {
+                    uint32_t f;
+                    uint32_t k;
+                    if (i < 20) {
+                        f = (b & c) | (~b & d);
+                        k = 0x5A827999;
+                    } else if (i < 40) {
+                        f = b ^ c ^ d;
+                        k = 0x6ED9EBA1;
+                    } else if (i < 60) {
+                        f = (b & c) | (b & d) | (c & d);
+                        k = 0x8F1BBCDC;
+                    } else {
+                        f = b ^ c ^ d;
+                        k = 0xCA62C1D6;
+                    }
+
+                    uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+                    e = d;
+                    d = c;
+                    c = rotateLeft(b, 30);
+                    b = a;
+                    a = temp;
+                }
+
+                h[0] += a;
+                h[1] += b;
+                h[2] += c;
+                h[3] += d;
+                h[4] += e;
+            }
+
+            std::array<unsigned char, 20> digest;
+            for (int i = 0; i < 5; ++i) {
+                digest[i * 4] = h[i] >> 24;
+                digest[i * 4 + 1] = h[i] >> 16;
+                digest[i * 4 + 2] = h[i] >> 8;
+                digest[i * 4 + 3] = h[i];
+            }
+
+            return digest;
+        }
+
+        string base64(const unsigned char *data, size_t size) {
+            constexpr string_view alphabet =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+            string encoded;
+            encoded.reserve((size + 2) / 3 * 4);
+
+            for (size_t i = 0; i < size; i += 3) {
+                uint32_t group = (uint32_t)data[i] << 16;
+                if (i + 1 < size) {
+                    group |= (uint32_t)data[i + 1] << 8;
+                }
+                if (i + 2 < size) {
+                    group |= data[i + 2];
+                }
+
+                encoded += alphabet[(group >> 18) & 0x3F];
+                encoded += alphabet[(group >> 12) & 0x3F];
+                encoded += i + 1 < size ? alphabet[(group >> 6) & 0x3F] : '=';
+                encoded += i + 2 < size ? alphabet[group & 0x3F] : '=';
+            }
+
+            return encoded;
+        }
+
+        bool hasToken(string_view list, string_view token) {
+            while (!list.empty()) {
+                size_t comma = list.find(',');
+                string_view item = list.substr(0, comma);
+                list = comma == string_view::npos
+                    ? string_view {}
+                    : list.substr(comma + 1);
+
+                while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+                    item.remove_prefix(1);
+                }
+                while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+                    item.remove_suffix(1);
+                }
+
+                if (equalsIgnoreCase(item, token)) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool validCloseCode(uint16_t code) {
+            if (code >= 3000 && code <= 4999) {
+                return true;
+            }
+
+            return code >= 1000 && code <= 1011
+                && code != 1004 && code != 1005 && code != 1006;
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // constructors
+    ///////////////////////////////////////////////////////////////////////////
+    WebSocket::WebSocket(
+        const WebSocketHandler &handler,
+        OutputQueue &out,
+        size_t max_pending,
+        size_t max_message_size
+    ) : handler_(handler), out_(out) {
+        max_pending_ = max_pending;
+        max_message_size_ = max_message_size;
+        message_opcode_ = Opcode::Continuation;
+        close_code_ = CloseCode::Abnormal;
+        close_sent_ = false;
+        close_received_ = false;
+        finished_ = false;
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // public member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool WebSocket::send(string_view text) {
+        if (closing() || out_.pending() > max_pending_) {
+            return false;
+        }
+
+        out_.append(encodeFrame(Opcode::Text, text));
+        return true;
+    }
+
+    bool WebSocket::sendBinary(string_view data) {
+        if (closing() || out_.pending() > max_pending_) {
+            return false;
+        }
+
+        out_.append(encodeFrame(Opcode::Binary, data));
+        return true;
+    }
+
+    bool WebSocket::sendFrame(shared_ptr<const string> frame) {
+        if (closing() || out_.pending() > max_pending_) {
+            return false;
+        }
+
+        string_view data = *frame;
+        out_.append(std::move(frame), data);
+        return true;
+    }
+
+    void WebSocket::close(CloseCode code, string_view reason) {
+        if (close_sent_) {
+            return;
+        }
+
+        uint16_t raw = static_cast<uint16_t>(code);
+        string payload;
+        payload += static_cast<char>(raw >> 8);
+        payload += static_cast<char>(raw);
+        payload += reason.substr(0, max_close_reason);
+
+        out_.append(encodeFrame(Opcode::Close, payload));
+        close_sent_ = true;
+
+        if (!close_received_) {
+            close_code_ = code;
+        }
+    }
+
+    size_t WebSocket::buffered() const {
+        return out_.pending();
+    }
+
+    bool WebSocket::closing() const {
+        return close_sent_ || close_received_;
+    }
+
+    const WebSocketHandler &WebSocket::handler() const {
+        return handler_;
+    }
+
+    void WebSocket::open() {
+        if (handler_.on_open) {
+            handler_.on_open(*this);
+        }
+    }
+
+    size_t WebSocket::receive(char *data, size_t size) {
+        size_t consumed = 0;
+
+        while (!closing()) {
+            Frame frame;
+            ParseStatus status = parseFrame(
+                data + consumed,
+                size - consumed,
+                max_message_size_,
+                frame
+            );
+
+            if (status == ParseStatus::Incomplete) {
+                break;
+            }
+
+            if (status == ParseStatus::Error) {
+                fail(frame.error);
+                return size;
+            }
+
+            consumed += frame.length;
+            handleFrame(frame);
+        }
+
+        return closing() ? size : consumed;
+    }
+
+    void WebSocket::finish() {
+        if (finished_) {
+            return;
+        }
+
+        finished_ = true;
+        if (handler_.on_close) {
+            handler_.on_close(*this, close_code_);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // private member functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool WebSocket::handleFrame(const Frame &frame) {
+        switch (frame.opcode) {
+            case Opcode::Text:
+            case Opcode::Binary:
+                if (message_opcode_ != Opcode::Continuation) {
+                    fail(CloseCode::ProtocolError);
+                    return false;
+                }
+
+                if (frame.fin) {
+                    deliver(frame.payload, frame.opcode);
+                } else {
+                    message_.assign(frame.payload);
+                    message_opcode_ = frame.opcode;
+                }
+                return true;
+
+            case Opcode::Continuation:
+                if (message_opcode_ == Opcode::Continuation) {
+                    fail(CloseCode::ProtocolError);
+                    return false;
+                }
+
+                if (message_.size() + frame.payload.size() > max_message_size_) {
+                    fail(CloseCode::TooBig);
+                    return false;
+                }
+
+                message_.append(frame.payload);
+                if (frame.fin) {
+                    Opcode opcode = message_opcode_;
+                    message_opcode_ = Opcode::Continuation;
+                    deliver(message_, opcode);
+                    message_.clear();
+                    message_.shrink_to_fit();
+                }
+                return true;
+
+            case Opcode::Ping:
+                out_.append(encodeFrame(Opcode::Pong, frame.payload));
+                return true;
+
+            case Opcode::Pong:
+                return true;
+
+            case Opcode::Close:
+                return handleClose(frame.payload);
+        }
+
+        return false;
+    }
+
+    bool WebSocket::handleClose(string_view payload) {
+        close_received_ = true;
+
+        if (payload.empty()) {
+            close_code_ = CloseCode::NoStatus;
+            close(CloseCode::Normal);
+            return false;
+        }
+
+        uint16_t raw = payload.size() >= 2
+            ? (uint16_t)((unsigned char)payload[0] << 8 | (unsigned char)payload[1])
+            : 0;
+
+        if (payload.size() < 2 || !validCloseCode(raw)) {
+            close_code_ = CloseCode::ProtocolError;
+            close(CloseCode::ProtocolError);
+            return false;
+        }
+
+        if (!validUtf8(payload.substr(2))) {
+            close_code_ = CloseCode::InvalidPayload;
+            close(CloseCode::InvalidPayload);
+            return false;
+        }
+
+        close_code_ = static_cast<CloseCode>(raw);
+        close(close_code_);
+        return false;
+    }
+
+    void WebSocket::deliver(string_view message, Opcode opcode) {
+        if (opcode == Opcode::Text && !validUtf8(message)) {
+            fail(CloseCode::InvalidPayload);
+            return;
+        }
+
+        if (handler_.on_message) {
+            handler_.on_message(*this, message, opcode == Opcode::Binary);
+        }
+    }
+
+    void WebSocket::fail(CloseCode code) {
+        message_.clear();
+        message_opcode_ = Opcode::Continuation;
+        close(code);
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // free functions
+    ///////////////////////////////////////////////////////////////////////////
+    bool isWebSocketUpgrade(const RequestHead &head) {
+        return hasToken(head.header("Upgrade"), "websocket");
+    }
+
+    expected<string, string> acceptHandshake(const RequestHead &head) {
+        if (head.method != "GET" || head.version != "HTTP/1.1") {
+            return unexpected("WebSocket handshake must be an HTTP/1.1 GET");
+        }
+
+        if (!hasToken(head.header("Connection"), "upgrade")) {
+            return unexpected("WebSocket handshake is missing Connection: Upgrade");
+        }
+
+        if (head.header("Sec-WebSocket-Version") != "13") {
+            return unexpected(format(
+                "Unsupported WebSocket version {}",
+                head.header("Sec-WebSocket-Version")
+            ));
+        }
+
+        string_view key = head.header("Sec-WebSocket-Key");
+        if (key.size() != 24) {
+            return unexpected("Invalid Sec-WebSocket-Key");
+        }
+
+        return format(
+            "HTTP/1.1 101 Switching Protocols\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Accept: {}\r\n"
+            "\r\n",
+            acceptKey(key)
+        );
+    }
+
+    string acceptKey(string_view key) {
+        string combined(key);
+        combined += websocket_guid;
+
+        std::array<unsigned char, 20> digest = sha1(combined);
+        return base64(digest.data(), digest.size());
+    }
+
+    ParseStatus parseFrame(
+        char *data,
+        size_t size,
+        size_t max_payload,
+        Frame &frame
+    ) {
+        if (size < 2) {
+            return ParseStatus::Incomplete;
+        }
+
+        auto *bytes = reinterpret_cast<unsigned char *>(data);
+        frame.fin = bytes[0] & 0x80;
+        frame.opcode = static_cast<Opcode>(bytes[0] & 0x0F);
+        frame.error = CloseCode::ProtocolError;
+
+        // No extensions are negotiated, so every reserved bit must be clear.
+        if (bytes[0] & 0x70) {
+            return ParseStatus::Error;
+        }
+
+        bool control = bytes[0] & 0x08;
+        switch (frame.opcode) {
+            case Opcode::Continuation:
+            case Opcode::Text:
+            case Opcode::Binary:
+            case Opcode::Close:
+            case Opcode::Ping:
+            case Opcode::Pong:
+                break;
+            default:
+                return ParseStatus::Error;
+        }
+
+        // Clients must mask every frame they send.
+        if (!(bytes[1] & 0x80)) {
+            return ParseStatus::Error;
+        }
+
+        uint64_t length = bytes[1] & 0x7F;
+        size_t header = 2;
+
+        if (length == 126) {
+            if (size < 4) {
+                return ParseStatus::Incomplete;
+            }
+            length = (uint64_t)bytes[2] << 8 | bytes[3];
+            header = 4;
+        } else if (length == 127) {
+            if (size < 10) {
+                return ParseStatus::Incomplete;
+            }
+            length = 0;
+            for (int i = 2; i < 10; ++i) {
+                length = length << 8 | bytes[i];
+            }
+            if (length >> 63) {
+                return ParseStatus::Error;
+            }
+            header = 10;
+        }
+
+        if (control && (!frame.fin || length > 125)) {
+            return ParseStatus::Error;
+        }
+
+        if (length > max_payload) {
+            frame.error = CloseCode::TooBig;
+            return ParseStatus::Error;
+        }
+
+        header += 4;
+        if (size < header + length) {
+            return ParseStatus::Incomplete;
+        }
+
+        unmask(data + header, length, bytes + header - 4);
+        frame.payload = string_view(data + header, length);
+        frame.length = header + length;
+        return ParseStatus::Complete;
+    }
+
+    string encodeFrame(Opcode opcode, string_view payload) {
+        string frame;
+        frame.reserve(payload.size() + 10);
+        frame += static_cast<char>(0x80 | static_cast<unsigned char>(opcode));
+
+        if (payload.size() < 126) {
+            frame += static_cast<char>(payload.size());
+        } else if (payload.size() <= 0xFFFF) {
+            frame += static_cast<char>(126);
+            frame += static_cast<char>(payload.size() >> 8);
+            frame += static_cast<char>(payload.size());
+        } else {
+            frame += static_cast<char>(127);
+            for (int shift = 56; shift >= 0; shift -= 8) {
+                frame += static_cast<char>((uint64_t)payload.size() >> shift);
+            }
+        }
+
+        frame += payload;
+        return frame;
+    }
+
+    void unmask(char *data, size_t size, const unsigned char key[4]) {
+        // XOR eight bytes at a time with the key repeated across a word;
+        // every full word starts on a multiple of four, so the key lines up.
+        uint32_t key32;
+        std::memcpy(&key32, key, 4);
+        uint64_t key64 = (uint64_t)key32 << 32 | key32;
+
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            word ^= key64;
+            std::memcpy(data + i, &word, 8);
+        }
+
+        for (; i < size; ++i) {
+            data[i] ^= key[i & 3];
+        }
+    }
+
+    bool validUtf8(string_view text) {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(text.data());
+        size_t size = text.size();
+        size_t i = 0;
+
+        while (i < size) {
+            if (i + 8 <= size) {
+                uint64_t word;
+                std::memcpy(&word, bytes + i, 8);
+                if (!(word & 0x8080808080808080ULL)) {
+                    i += 8;
+                    continue;
+                }
+            }
+
+            unsigned char lead = bytes[i];
+            if (lead < 0x80) {
+                ++i;
+                continue;
+            }
+
+            size_t length;
+            uint32_t code_point;
+            if ((lead & 0xE0) == 0xC0) {
+                length = 2;
+                code_point = lead & 0x1F;
+            } else if ((lead & 0xF0) == 0xE0) {
+                length = 3;
+                code_point = lead & 0x0F;
+            } else if ((lead & 0xF8) == 0xF0) {
+                length = 4;
+                code_point = lead & 0x07;
+            } else {
+                return false;
+            }
+
+            if (i + length > size) {
+                return false;
+            }
+
+            for (size_t k = 1; k < length; ++k) {
+                if ((bytes[i + k] & 0xC0) != 0x80) {
+                    return false;
+                }
+                code_point = code_point << 6 | (bytes[i + k] & 0x3F);
+            }
+
+            constexpr uint32_t min_code_point[] = { 0, 0, 0x80, 0x800, 0x10000 };
+            if (code_point < min_code_point[length]
+                || code_point > 0x10FFFF
+                || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+                return false;
+            }
+
+            i += length;
+        }
+
+        return true;
+    }
+}
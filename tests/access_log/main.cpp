@@ -0,0 +1,200 @@
+#include <string_view>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <print>
+#include <thread>
+#include <vector>
+
+#include "access_log.hpp"
+#include "../check.hpp"
+
+namespace fs = std::filesystem;
+
+using http::AccessMethod;
+using http::AccessRecord;
+using http::AccessLog;
+using std::string_view;
+using std::uint64_t;
+using std::size_t;
+using std::string;
+using std::vector;
+using test::check;
+
+string decoder;
+
+// Every field is derived from the timestamp, so a decoded line shows
+// whether its record was stored whole.
+AccessRecord recordFor(uint64_t timestamp) {
+    AccessRecord record {};
+    record.timestamp_ns = timestamp;
+    record.latency_ns = timestamp * 3;
+    record.bytes = timestamp * 5;
+    record.route_id = timestamp % 4 == 0 ? http::no_route : static_cast<std::uint32_t>(timestamp % 4);
+    record.fd = static_cast<std::int32_t>(timestamp % 1000);
+    record.status = timestamp % 2 == 0 ? 200 : 404;
+    record.method = timestamp % 3 == 0 ? AccessMethod::Post : AccessMethod::Get;
+    return record;
+}
+
+string csvFor(uint64_t timestamp) {
+    AccessRecord record = recordFor(timestamp);
+    return std::format(
+        "{},{},{},{},{},{},{}",
+        record.timestamp_ns,
+        record.fd,
+        http::accessMethodName(record.method),
+        record.route_id == http::no_route ? "" : std::to_string(record.route_id),
+        record.status,
+        record.bytes,
+        record.latency_ns
+    );
+}
+
+// Runs the offline decoder over directory and returns its CSV rows.
+vector<string> decode(const fs::path &directory) {
+    vector<string> rows;
+    string command = std::format("{} --csv {}", decoder, directory.string());
+    FILE *pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        check(false, "decoder runs");
+        return rows;
+    }
+
+    char line[512];
+    while (std::fgets(line, sizeof(line), pipe)) {
+        string_view row(line);
+        if (row.ends_with('\n')) {
+            row.remove_suffix(1);
+        }
+        rows.emplace_back(row);
+    }
+
+    check(pclose(pipe) == 0, "decoder succeeds");
+    check(!rows.empty() && rows[0] == "timestamp_ns,fd,method,route_id,status,bytes,latency_ns", "csv header");
+    if (!rows.empty()) {
+        rows.erase(rows.begin());
+    }
+    return rows;
+}
+
+size_t files(const fs::path &directory) {
+    size_t count = 0;
+    for (const auto &entry : fs::directory_iterator(directory)) {
+        count += entry.path().extension() == ".bin";
+    }
+    return count;
+}
+
+void roundTrip(const fs::path &directory) {
+    {
+        AccessLog log;
+        check(!log.enabled(), "closed log is disabled");
+        check(log.open(directory.string(), 4, 3).has_value(), "open");
+        check(log.enabled(), "open log is enabled");
+        check(!log.open(directory.string(), 4, 3).has_value(), "open twice");
+
+        for (uint64_t timestamp = 1; timestamp <= 10; ++timestamp) {
+            log.record(recordFor(timestamp));
+        }
+    }
+
+    // ten records at four a file rotate twice
+    check(files(directory) == 3, "one file per four records");
+
+    vector<string> expected;
+    for (uint64_t timestamp = 1; timestamp <= 10; ++timestamp) {
+        expected.push_back(csvFor(timestamp));
+    }
+    check(decode(directory) == expected, "records decode as written");
+
+    {
+        AccessLog log;
+        check(log.open(directory.string(), 4, 3).has_value(), "reopen");
+        log.record(recordFor(11));
+    }
+
+    // a new run starts a new file after the old ones
+    expected.push_back(csvFor(11));
+    check(files(directory) == 4, "reopen starts a new file");
+    check(decode(directory) == expected, "reopened log appends");
+}
+
+void retention(const fs::path &directory) {
+    {
+        AccessLog log;
+        check(log.open(directory.string(), 4, 3).has_value(), "open");
+        for (uint64_t timestamp = 1; timestamp <= 20; ++timestamp) {
+            log.record(recordFor(timestamp));
+        }
+    }
+
+    // only the three newest files are kept
+    vector<string> expected;
+    for (uint64_t timestamp = 9; timestamp <= 20; ++timestamp) {
+        expected.push_back(csvFor(timestamp));
+    }
+    check(files(directory) == 3, "old files removed");
+    check(decode(directory) == expected, "newest records kept");
+}
+
+void concurrent(const fs::path &directory) {
+    constexpr int threads = 8;
+    constexpr uint64_t per_thread = 50000;
+    constexpr size_t per_file = 64;
+    constexpr int max_files = 4;
+
+    {
+        AccessLog log;
+        check(log.open(directory.string(), per_file, max_files).has_value(), "open");
+
+        // small files rotate thousands of times while every thread writes
+        vector<std::thread> writers;
+        for (int t = 0; t < threads; ++t) {
+            writers.emplace_back([&log, t] {
+                for (uint64_t i = 1; i <= per_thread; ++i) {
+                    log.record(recordFor(t * per_thread + i));
+                }
+            });
+        }
+
+        for (std::thread &writer : writers) {
+            writer.join();
+        }
+    }
+
+    vector<string> rows = decode(directory);
+    check(files(directory) == max_files, "concurrent rotation keeps max files");
+    check(rows.size() <= per_file * max_files, "no more records than the files hold");
+    check(rows.size() >= per_file, "newest file is written");
+
+    for (const string &row : rows) {
+        uint64_t timestamp = std::strtoull(row.c_str(), nullptr, 10);
+        if (row != csvFor(timestamp)) {
+            check(false, std::format("torn record {}", row));
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::println(stderr, "usage: {} <access_log_decoder>", argv[0]);
+        return 1;
+    }
+    decoder = argv[1];
+
+    fs::path root = fs::temp_directory_path() / "http-access-log-test";
+    fs::remove_all(root);
+
+    roundTrip(root / "round-trip");
+    retention(root / "retention");
+    concurrent(root / "concurrent");
+
+    fs::remove_all(root);
+    return test::finish("access_log");
+}
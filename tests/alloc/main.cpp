@@ -0,0 +1,395 @@
+#include <string_view>
+#include <filesystem>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <string>
+#include <thread>
+#include <optional>
+#include <new>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "http_server.hpp"
+#include "../check.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::uint64_t;
+using std::string;
+using test::check;
+
+// Every global operator new in the process is counted; the client below
+// works out of fixed buffers so whatever moves between two snapshots was
+// allocated by the server.
+std::atomic<uint64_t> allocations;
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *data = std::malloc(size ? size : 1)) {
+        return data;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *data) noexcept {
+    std::free(data);
+}
+
+void operator delete(void *data, std::size_t) noexcept {
+    std::free(data);
+}
+
+int connectTo(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Reads one response into buffer and returns its status, or 0 on failure.
+int request(int fd, string_view text, char *buffer, std::size_t capacity) {
+    if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+        return 0;
+    }
+
+    std::size_t have = 0;
+    while (true) {
+        string_view seen(buffer, have);
+        std::size_t end = seen.find("\r\n\r\n");
+        if (end != string_view::npos) {
+            std::size_t length = 0;
+            std::size_t field = seen.find("Content-Length: ");
+            if (field != string_view::npos && field < end) {
+                length = std::strtoul(buffer + field + 16, nullptr, 10);
+            }
+
+            if (have >= end + 4 + length) {
+                return std::atoi(buffer + 9);
+            }
+        }
+
+        if (have == capacity) {
+            return 0;
+        }
+
+        ssize_t bytes = read(fd, buffer + have, capacity - have);
+        if (bytes <= 0) {
+            return 0;
+        }
+        have += bytes;
+    }
+}
+
+// Fails when a warmed-up keep-alive connection averages more than budget
+// allocations per request for path.
+void expectAllocations(string_view name, string_view path, int status, uint64_t budget, int port) {
+    constexpr int warmup = 1000;
+    constexpr int requests = 5000;
+
+    char text[256];
+    auto written = std::format_to_n(text, sizeof(text), "GET {} HTTP/1.1\r\nHost: test\r\n\r\n", path);
+    string_view line(text, written.out);
+
+    static char buffer[1 << 16];
+    int fd = connectTo(port);
+    bool ok = fd >= 0;
+
+    for (int i = 0; ok && i < warmup; ++i) {
+        ok = request(fd, line, buffer, sizeof(buffer)) == status;
+    }
+
+    uint64_t before = allocations.load();
+    for (int i = 0; ok && i < requests; ++i) {
+        ok = request(fd, line, buffer, sizeof(buffer)) == status;
+    }
+    uint64_t after = allocations.load();
+    close(fd);
+
+    check(ok, std::format("{} on port {} answers {}", name, port, status));
+    check(
+        after - before <= budget * requests,
+        std::format(
+            "{} on port {}: {:.2f} allocations per request, budget {}",
+            name,
+            port,
+            (after - before) / double(requests),
+            budget
+        )
+    );
+}
+
+// Sends method for path and then GET /string in one write, and checks
+// that the first response has no body, so the second follows its head
+// directly on the same connection. A HEAD answer keeps the length a GET
+// would have; zero means no Content-Length at all.
+void expectNoBody(
+    string_view method,
+    string_view path,
+    int status,
+    std::size_t length,
+    int port
+) {
+    char text[512];
+    auto written = std::format_to_n(
+        text,
+        sizeof(text),
+        "{} {} HTTP/1.1\r\nHost: test\r\n\r\nGET /string HTTP/1.1\r\nHost: test\r\n\r\n",
+        method,
+        path
+    );
+
+    string name = std::format("{} {} on port {}", method, path, port);
+    int fd = connectTo(port);
+    if (fd < 0 || write(fd, text, written.out - text) != written.out - text) {
+        check(false, name + " sent");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    // read until the GET response is complete or the server goes quiet
+    static char buffer[1 << 16];
+    std::size_t have = 0;
+    string_view seen;
+    std::size_t first_end = string_view::npos;
+    std::size_t second_end = string_view::npos;
+    std::size_t first_length = 0;
+    std::size_t second_length = 0;
+    while (have < sizeof(buffer)) {
+        pollfd ready { fd, POLLIN, 0 };
+        if (poll(&ready, 1, 1000) <= 0) {
+            break;
+        }
+
+        ssize_t bytes = read(fd, buffer + have, sizeof(buffer) - have);
+        if (bytes <= 0) {
+            break;
+        }
+        have += bytes;
+
+        seen = string_view(buffer, have);
+        first_end = seen.find("\r\n\r\n");
+        if (first_end == string_view::npos) {
+            continue;
+        }
+
+        std::size_t field = seen.find("Content-Length: ");
+        first_length = field < first_end ? std::strtoul(buffer + field + 16, nullptr, 10) : 0;
+
+        second_end = seen.find("\r\n\r\n", first_end + 4);
+        if (second_end == string_view::npos) {
+            continue;
+        }
+
+        field = seen.find("Content-Length: ", first_end);
+        second_length = field < second_end ? std::strtoul(buffer + field + 16, nullptr, 10) : 0;
+        if (have >= second_end + 4 + second_length) {
+            break;
+        }
+    }
+    close(fd);
+
+    check(seen.starts_with(std::format("HTTP/1.1 {}", status)), name + " status");
+    check(first_length == length, name + " Content-Length");
+    check(
+        first_end != string_view::npos && seen.substr(first_end + 4).starts_with("HTTP/1.1 200"),
+        name + " is followed directly by the next response"
+    );
+    check(
+        second_end != string_view::npos && second_length > 0 && have == second_end + 4 + second_length,
+        name + " next response carries its body"
+    );
+}
+
+// Sends GET path and then GET /string in one write, and checks that the
+// handler's exception came back as a 500 that closed the connection, so
+// the second request was never answered.
+void expectServerError(string_view path, int port) {
+    char text[512];
+    auto written = std::format_to_n(
+        text,
+        sizeof(text),
+        "GET {} HTTP/1.1\r\nHost: test\r\n\r\nGET /string HTTP/1.1\r\nHost: test\r\n\r\n",
+        path
+    );
+
+    string name = std::format("GET {} on port {}", path, port);
+    int fd = connectTo(port);
+    if (fd < 0 || write(fd, text, written.out - text) != written.out - text) {
+        check(false, name + " sent");
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+
+    static char buffer[1 << 16];
+    std::size_t have = 0;
+    bool closed = false;
+    while (have < sizeof(buffer)) {
+        pollfd ready { fd, POLLIN, 0 };
+        if (poll(&ready, 1, 1000) <= 0) {
+            break;
+        }
+
+        ssize_t bytes = read(fd, buffer + have, sizeof(buffer) - have);
+        if (bytes <= 0) {
+            closed = bytes == 0;
+            break;
+        }
+        have += bytes;
+    }
+    close(fd);
+
+    string_view seen(buffer, have);
+    check(seen.starts_with("HTTP/1.1 500"), name + " status");
+    check(seen.contains("Connection: close\r\n"), name + " says it closes");
+    check(closed && seen.find("HTTP/1.1", 1) == string_view::npos, name + " closes");
+}
+
+http::Task<string> failing() {
+    throw std::runtime_error("awaited task failed");
+    co_return string();
+}
+
+void startServer(HttpServer *server, int port, http::Backend backend, const fs::path &root) {
+    server->setBackend(backend);
+    server->setKeepAlive(30, 1 << 30);
+    for (Method method : { Method::Get, Method::Head }) {
+        server->route("/string", method, [](string) {
+            return string("a body past the small string size");
+        }, ContentType::Plain);
+    }
+    for (Method method : { Method::Get, Method::Head }) {
+        server->route("/arena/:name", method, [](http::RequestView &request) {
+            return request.format("{{\"name\": \"{}\"}}", request.param("name"));
+        }, ContentType::Json);
+    }
+    for (Method method : { Method::Get, Method::Head }) {
+        server->route("/pool", method, [](string) {
+            return string("answered on the thread pool");
+        }, ContentType::Plain, Execution::Pool);
+    }
+    for (Method method : { Method::Get, Method::Head }) {
+        server->route("/coroutine", method, [](http::Context &) -> http::Task<http::Response> {
+            co_return http::Response { 200, "text/plain", "answered by a coroutine" };
+        });
+        server->route("/stream", method, [](http::Context &context) -> http::Task<http::Response> {
+            context.stream(200, "text/plain", 8);
+            co_await context.write("streamed");
+            co_return http::Response {};
+        });
+        server->route("/chunked", method, [](http::Context &context) -> http::Task<http::Response> {
+            context.stream(200, "text/plain");
+            co_await context.write("chunked");
+            co_return http::Response {};
+        });
+    }
+    server->route("/no-content", Method::Get, [](http::Context &context) -> http::Task<http::Response> {
+        context.stream(204, "text/plain");
+        co_await context.write("dropped");
+        co_return http::Response {};
+    });
+    server->route("/not-modified", Method::Get, [](http::Context &) -> http::Task<http::Response> {
+        co_return http::Response { 304, "text/plain", "dropped" };
+    });
+    server->route("/throw", Method::Get, [](string) -> string {
+        throw std::runtime_error("inline handler failed");
+    }, ContentType::Plain);
+    server->route("/throw/arena", Method::Get, [](http::RequestView &) -> string_view {
+        throw std::runtime_error("arena handler failed");
+    }, ContentType::Plain);
+    server->route("/throw/pool", Method::Get, [](string) -> string {
+        throw std::runtime_error("pool handler failed");
+    }, ContentType::Plain, Execution::Pool);
+    server->route("/throw/coroutine", Method::Get, [](http::Context &) -> http::Task<http::Response> {
+        co_return http::Response { 200, "text/plain", co_await failing() };
+    });
+    server->serveDir(root.string());
+
+    std::thread([server] {
+        server->acceptClientWithLoop();
+    }).detach();
+
+    // wait for the listening socket
+    while (true) {
+        int fd = connectTo(port);
+        if (fd >= 0) {
+            close(fd);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+int main() {
+    fs::path root = fs::temp_directory_path() / "http-alloc-test";
+    fs::create_directories(root);
+    std::ofstream(root / "index.html") << "<!doctype html><p>cached</p>\n";
+
+    struct {
+        int port;
+        http::Backend backend;
+    } configs[] = {
+        { 3321, http::Backend::Epoll },
+        { 3322, http::Backend::IoUring },
+    };
+
+    // the server threads never return, so neither does main
+    std::optional<HttpServer> servers[std::size(configs)];
+    for (std::size_t i = 0; i < std::size(configs); ++i) {
+        auto [port, backend] = configs[i];
+        startServer(&servers[i].emplace("127.0.0.1", port, 128, false, false), port, backend, root);
+
+        // a handler returning std::string pays for that string, nothing more
+        expectAllocations("string handler", "/string", 200, 1, port);
+        expectAllocations("arena handler", "/arena/someone-with-a-long-name", 200, 0, port);
+        expectAllocations("static file", "/index.html", 200, 0, port);
+        expectAllocations("not found", "/missing", 404, 0, port);
+
+        expectNoBody("HEAD", "/string", 200, 33, port);
+        expectNoBody("HEAD", "/pool", 200, 27, port);
+        expectNoBody("HEAD", "/arena/someone", 200, 19, port);
+        expectNoBody("HEAD", "/coroutine", 200, 23, port);
+        expectNoBody("HEAD", "/stream", 200, 8, port);
+        expectNoBody("HEAD", "/chunked", 200, 0, port);
+        expectNoBody("HEAD", "/index.html", 200, 29, port);
+        expectNoBody("HEAD", "/missing", 404, 13, port);
+        expectNoBody("GET", "/no-content", 204, 0, port);
+        expectNoBody("GET", "/not-modified", 304, 7, port);
+
+        expectServerError("/throw", port);
+        expectServerError("/throw/arena", port);
+        expectServerError("/throw/pool", port);
+        expectServerError("/throw/coroutine", port);
+    }
+
+    fs::remove_all(root);
+    int result = test::finish("alloc");
+    std::fflush(stdout);
+    _exit(result);
+}
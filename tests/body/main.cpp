@@ -0,0 +1,139 @@
+#include <string_view>
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "http_parser.hpp"
+#include "../check.hpp"
+
+using http::RequestHead;
+using http::ParseStatus;
+using http::BodyReader;
+using std::string_view;
+using std::size_t;
+using std::string;
+using test::check;
+
+struct Body {
+    ParseStatus status;
+    string data;
+    size_t consumed = 0;
+};
+
+// Feeds input to a BodyReader step bytes at a time, keeping back whatever
+// it did not consume, the way the event loop does.
+Body readBody(const RequestHead &head, size_t max, string_view input, size_t step) {
+    BodyReader reader;
+    Body body { reader.start(head, max), {} };
+
+    size_t end = std::min(step, input.size());
+    while (body.status == ParseStatus::Incomplete) {
+        size_t consumed = 0;
+        string_view data;
+        body.status = reader.read(input.substr(body.consumed, end - body.consumed), consumed, data);
+        body.data.append(data);
+        body.consumed += consumed;
+
+        if (body.consumed == end) {
+            if (end == input.size()) {
+                break;
+            }
+            end = std::min(end + step, input.size());
+        }
+    }
+
+    return body;
+}
+
+RequestHead chunkedHead() {
+    RequestHead head;
+    head.chunked = true;
+    return head;
+}
+
+void contentLength() {
+    RequestHead head;
+    head.content_length = 5;
+
+    for (size_t step : { 1, 2, 100 }) {
+        Body body = readBody(head, 64, "helloGET", step);
+        check(body.status == ParseStatus::Complete, "length body completes");
+        check(body.data == "hello", "length body data");
+        check(body.consumed == 5, "length body leaves the next request");
+    }
+
+    check(readBody(head, 64, "hel", 100).status == ParseStatus::Incomplete, "short length body");
+    check(readBody(head, 4, "hello", 100).status == ParseStatus::TooLarge, "length over the limit");
+
+    head.content_length = 0;
+    check(readBody(head, 64, "", 1).status == ParseStatus::Complete, "empty length body");
+}
+
+void chunked() {
+    RequestHead head = chunkedHead();
+    string_view bodies[][2] = {
+        { "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n", "hello world" },
+        { "5;name=value\r\nhello\r\n0\r\n\r\n", "hello" },
+        { "3\r\nabc\r\n0\r\nExpires: never\r\nX: y\r\n\r\n", "abc" },
+        { "A\r\n0123456789\r\na\r\n0123456789\r\n0\r\n\r\n", "01234567890123456789" },
+        { "003\r\nabc\r\n000\r\n\r\n", "abc" },
+        { "0\r\n\r\n", "" },
+    };
+
+    for (auto &[text, expected] : bodies) {
+        for (size_t step : { 1, 2, 7, 1000 }) {
+            string input = string(text) + "GET";
+            Body body = readBody(head, 64, input, step);
+            check(body.status == ParseStatus::Complete, string(text));
+            check(body.data == expected, string(text));
+            check(body.consumed == text.size(), string(text));
+        }
+    }
+
+    Body partial = readBody(head, 64, "5\r\nhel", 1000);
+    check(partial.status == ParseStatus::Incomplete, "partial chunk");
+    check(partial.data == "hel", "partial chunk data");
+}
+
+void chunkedMalformed() {
+    RequestHead head = chunkedHead();
+    string_view bodies[] = {
+        " 3\r\nabc\r\n0\r\n\r\n",
+        "3 \r\nabc\r\n0\r\n\r\n",
+        "\t3\r\nabc\r\n0\r\n\r\n",
+        "0x3\r\nabc\r\n0\r\n\r\n",
+        "+3\r\nabc\r\n0\r\n\r\n",
+        "-1\r\n",
+        "\r\n",
+        ";ext\r\n",
+        "g\r\n",
+        "3\nabc\r\n0\r\n\r\n",
+        "3\r\rabc\r\n0\r\n\r\n",
+        "3;ext\nabc\r\n0\r\n\r\n",
+        "3\r\nabcX\r\n0\r\n\r\n",
+        "3\r\nabc\rX0\r\n\r\n",
+        "0\r\n\rX",
+    };
+
+    for (string_view text : bodies) {
+        check(readBody(head, 64, text, 1000).status == ParseStatus::Error, string(text));
+        check(readBody(head, 64, text, 1).status == ParseStatus::Error, string(text));
+    }
+}
+
+void chunkedTooLarge() {
+    RequestHead head = chunkedHead();
+    check(readBody(head, 10, "b\r\nhello world\r\n0\r\n\r\n", 1000).status == ParseStatus::TooLarge, "chunk over the limit");
+    check(readBody(head, 10, "6\r\nhello \r\n5\r\n", 1000).status == ParseStatus::TooLarge, "chunks add up over the limit");
+    check(readBody(head, 10, "a\r\n0123456789\r\n0\r\n\r\n", 1000).status == ParseStatus::Complete, "chunks exactly at the limit");
+    check(readBody(head, ~size_t(0), "fffffffffffffffffff\r\n", 1000).status == ParseStatus::TooLarge, "size that would overflow");
+}
+
+int main() {
+    contentLength();
+    chunked();
+    chunkedMalformed();
+    chunkedTooLarge();
+
+    return test::finish("body");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <source_location>
+#include <string_view>
+#include <cstdio>
+#include <print>
+
+// Each test binary counts its failed checks and exits non-zero if there
+// were any, which stops `make test`.
+namespace test {
+    inline int failures = 0;
+
+    inline void check(
+        bool ok,
+        std::string_view what,
+        std::source_location where = std::source_location::current()
+    ) {
+        if (!ok) {
+            std::println(stderr, "{}:{}: {}", where.file_name(), where.line(), what);
+            failures++;
+        }
+    }
+
+    inline int finish(std::string_view name) {
+        if (failures > 0) {
+            std::println(stderr, "{}: {} failed", name, failures);
+            return 1;
+        }
+
+        std::println("{}: ok", name);
+        return 0;
+    }
+}
@@ -0,0 +1,116 @@
+#include <string_view>
+#include <cstddef>
+#include <string>
+
+#include <zlib.h>
+
+#include "compression.hpp"
+#include "../check.hpp"
+
+using http::negotiateEncoding;
+using http::Encoding;
+using std::string_view;
+using std::size_t;
+using std::string;
+using test::check;
+
+Encoding both(string_view accept_encoding) {
+    return negotiateEncoding(accept_encoding, true, true);
+}
+
+void negotiate() {
+    check(both("") == Encoding::Identity, "no header");
+    check(both("identity") == Encoding::Identity, "identity only");
+    check(both("gzip") == Encoding::Gzip, "gzip");
+    check(both("x-gzip") == Encoding::Gzip, "x-gzip");
+    check(both("GZIP") == Encoding::Gzip, "coding names ignore case");
+    check(both("br") == Encoding::Brotli, "brotli");
+    check(both("gzip, deflate, br") == Encoding::Brotli, "brotli preferred");
+    check(both(" gzip ,br ") == Encoding::Brotli, "whitespace around codings");
+    check(both("br;q=0.5, gzip") == Encoding::Gzip, "higher q wins");
+    check(both("br;q=0.8, gzip;q=0.8") == Encoding::Brotli, "brotli wins a tie");
+    check(both("gzip;q=0, br;q=0") == Encoding::Identity, "q=0 refuses");
+    check(both("br;q=0, gzip") == Encoding::Gzip, "q=0 refuses only that coding");
+    check(both("gzip; Q = 0.0 ") == Encoding::Gzip, "malformed q parameter is ignored");
+    check(both("gzip;Q=0") == Encoding::Identity, "q is case insensitive");
+    check(both("gzip;q=abc") == Encoding::Identity, "bad q refuses");
+    check(both("gzip;level=1;q=0.3, br;q=0.2") == Encoding::Gzip, "q after another parameter");
+    check(both("*") == Encoding::Brotli, "wildcard");
+    check(both("*;q=0") == Encoding::Identity, "wildcard refusing everything");
+    check(both("*;q=0, gzip") == Encoding::Gzip, "named coding overrides the wildcard");
+    check(both("br;q=0, *") == Encoding::Gzip, "wildcard covers the unnamed coding");
+    check(both("deflate, compress") == Encoding::Identity, "unsupported codings only");
+
+    check(negotiateEncoding("br, gzip", true, false) == Encoding::Gzip, "brotli not available");
+    check(negotiateEncoding("br", true, false) == Encoding::Identity, "only an unavailable coding");
+    check(negotiateEncoding("gzip, br", false, false) == Encoding::Identity, "nothing available");
+}
+
+void names() {
+    check(http::encodingName(Encoding::Gzip) == "gzip", "gzip name");
+    check(http::encodingName(Encoding::Brotli) == "br", "brotli name");
+    check(http::encodingName(Encoding::Identity) == "identity", "identity name");
+
+    check(http::isCompressible("text/html; charset=utf-8"), "text");
+    check(http::isCompressible("application/json"), "json");
+    check(http::isCompressible("application/ld+json"), "json suffix");
+    check(http::isCompressible("application/javascript"), "javascript");
+    check(http::isCompressible("image/svg+xml"), "xml suffix");
+    check(!http::isCompressible("image/png"), "image");
+    check(!http::isCompressible("application/octet-stream"), "binary");
+    check(!http::isCompressible("application/json-seq-not"), "json only as a suffix");
+}
+
+string gunzip(string_view input) {
+    z_stream stream {};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+        return {};
+    }
+
+    string output(64 * 1024, '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef *>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+
+    int status = inflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+
+    return status == Z_STREAM_END ? output : string();
+}
+
+void compressBody() {
+    string body;
+    for (int i = 0; i < 200; ++i) {
+        body += "<li>a line of markup that repeats</li>\n";
+    }
+
+    http::CompressionConfig config;
+    string encoded;
+    check(http::compressBody(config, "gzip", body, encoded) == Encoding::Gzip, "gzip body");
+    check(encoded.size() < body.size(), "gzip body shrinks");
+    check(gunzip(encoded) == body, "gzip body round trips");
+
+    check(http::compressBody(config, "gzip, br", body, encoded) == Encoding::Brotli, "brotli body");
+    check(encoded.size() < body.size(), "brotli body shrinks");
+
+    check(http::compressBody(config, "identity", body, encoded) == Encoding::Identity, "identity body");
+    check(http::compressBody(config, "gzip", body.substr(0, 1000), encoded) == Encoding::Identity, "body under the minimum");
+
+    config.enabled = false;
+    check(http::compressBody(config, "gzip", body, encoded) == Encoding::Identity, "compression off");
+
+    // a body that does not shrink is sent as it is
+    config = {};
+    config.min_size = 0;
+    check(http::compressBody(config, "gzip", "x", encoded) == Encoding::Identity, "body that grows");
+}
+
+int main() {
+    negotiate();
+    names();
+    compressBody();
+
+    return test::finish("compression");
+}
@@ -0,0 +1,185 @@
+#include <string_view>
+#include <cstddef>
+#include <string>
+
+#include "http_parser.hpp"
+#include "../check.hpp"
+
+using http::RequestParser;
+using http::RequestHead;
+using http::ParseStatus;
+using std::string_view;
+using std::size_t;
+using std::string;
+using test::check;
+
+ParseStatus parse(string_view text, RequestHead &head, size_t max = 16384) {
+    RequestParser parser(max);
+    return parser.parse(text, head);
+}
+
+void requestLine() {
+    RequestHead head;
+    string_view text =
+        "POST /upload?name=a HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "content-length:  5 \r\n"
+        "X-Empty:\r\n"
+        "\r\n"
+        "hello";
+
+    check(parse(text, head) == ParseStatus::Complete, "full head parses");
+    check(head.method == "POST", "method");
+    check(head.target == "/upload?name=a", "target");
+    check(head.version == "HTTP/1.1", "version");
+    check(head.header_count == 3, "header count");
+    check(head.header("HOST") == "example.com", "header lookup ignores case");
+    check(head.header("Content-Length") == "5", "header value is trimmed");
+    check(head.header("X-Empty").empty(), "empty header value");
+    check(head.header("Missing").empty(), "missing header");
+    check(head.content_length == 5, "content length");
+    check(!head.body_ready, "body still to come");
+    check(head.length == text.size() - 5, "length covers the head only");
+}
+
+void splitInput() {
+    string_view text =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Accept: */*\r\n"
+        "\r\n";
+
+    // the parser resumes its scan where the last call left off
+    RequestParser parser;
+    RequestHead head;
+    for (size_t size = 1; size < text.size(); ++size) {
+        if (parser.parse(text.substr(0, size), head) != ParseStatus::Incomplete) {
+            check(false, "partial head is incomplete");
+            return;
+        }
+    }
+
+    check(parser.parse(text, head) == ParseStatus::Complete, "head completes on its last byte");
+    check(head.target == "/index.html", "split target");
+    check(head.header("Accept") == "*/*", "split header");
+    check(head.body_ready, "no body");
+}
+
+void pipelined() {
+    string_view text =
+        "GET /a HTTP/1.1\r\nHost: x\r\n\r\n"
+        "GET /b HTTP/1.1\r\nHost: x\r\n\r\n";
+
+    RequestParser parser;
+    RequestHead head;
+    check(parser.parse(text, head) == ParseStatus::Complete, "first request");
+    check(head.target == "/a", "first target");
+
+    check(parser.parse(text.substr(head.length), head) == ParseStatus::Complete, "second request");
+    check(head.target == "/b", "second target");
+}
+
+void malformed() {
+    RequestHead head;
+    string_view requests[] = {
+        "GET /\r\n\r\n",
+        "GET  / HTTP/1.1\r\n\r\n",
+        " / HTTP/1.1\r\n\r\n",
+        "GET / FTP/1.0\r\n\r\n",
+        "G(T / HTTP/1.1\r\n\r\n",
+        "GET /\x01 HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nNo colon\r\n\r\n",
+        "GET / HTTP/1.1\r\n: value\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: x\r\n\r\n",
+        "GET / HTTP/1.1\r\nName: a\x01z\r\n\r\n",
+        "GET / HTTP/1.1\r\nName: a\rz\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: -1\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+        "GET / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "GET / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nTransfer-Encoding: chunked\r\n\r\n",
+        "GET / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n",
+    };
+
+    for (string_view text : requests) {
+        check(parse(text, head) == ParseStatus::Error, string(text));
+    }
+}
+
+void versions() {
+    RequestHead head;
+    check(parse("GET / HTTP/1.0\r\n\r\n", head) == ParseStatus::Complete, "HTTP/1.0");
+    check(head.version == "HTTP/1.0", "HTTP/1.0 version");
+    check(parse("GET / HTTP/1.1\r\n\r\n", head) == ParseStatus::Complete, "HTTP/1.1");
+
+    string_view malformed[] = {
+        "GET / HTTP/1.1\nX-Injected: y\r\n\r\n",
+        "GET / HTTP/1.1 junk\r\n\r\n",
+        "GET / HTTP/1.1\x01\r\n\r\n",
+        "GET / HTTP/1.10\r\n\r\n",
+        "GET / HTTP/1\r\n\r\n",
+        "GET / HTTP/\r\n\r\n",
+        "GET / HTTP/a.b\r\n\r\n",
+        "GET / HTTP/1,1\r\n\r\n",
+        "GET / http/1.1\r\n\r\n",
+    };
+    for (string_view text : malformed) {
+        check(parse(text, head) == ParseStatus::Error, string(text));
+    }
+
+    string_view unsupported[] = {
+        "GET / HTTP/9.9\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET / HTTP/0.9\r\n\r\n",
+        "GET / HTTP/1.2\r\n\r\n",
+    };
+    for (string_view text : unsupported) {
+        check(parse(text, head) == ParseStatus::UnsupportedVersion, string(text));
+    }
+}
+
+void framing() {
+    RequestHead head;
+    check(
+        parse("GET / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\n", head)
+            == ParseStatus::Complete,
+        "repeated equal Content-Length"
+    );
+    check(head.content_length == 3, "repeated Content-Length value");
+
+    check(
+        parse("POST / HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n", head)
+            == ParseStatus::Complete,
+        "chunked head"
+    );
+    check(head.chunked, "chunked flag");
+    check(!head.body_ready, "chunked body still to come");
+}
+
+void tooLarge() {
+    RequestHead head;
+    string text = "GET / HTTP/1.1\r\nX-Long: " + string(100, 'a') + "\r\n\r\n";
+    check(parse(text, head, 64) == ParseStatus::TooLarge, "complete head over the limit");
+    check(parse(string_view(text).substr(0, 80), head, 64) == ParseStatus::TooLarge, "partial head over the limit");
+    check(parse(string_view(text).substr(0, 40), head, 64) == ParseStatus::Incomplete, "partial head under the limit");
+    check(parse(text, head, text.size()) == ParseStatus::Complete, "head exactly at the limit");
+
+    string many = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= RequestHead::max_headers; ++i) {
+        many += "X: y\r\n";
+    }
+    many += "\r\n";
+    check(parse(many, head) == ParseStatus::Error, "too many headers");
+}
+
+int main() {
+    requestLine();
+    splitInput();
+    pipelined();
+    malformed();
+    versions();
+    framing();
+    tooLarge();
+
+    return test::finish("parser");
+}
@@ -0,0 +1,110 @@
+#include <string_view>
+#include <cstddef>
+#include <string>
+
+#include "router.hpp"
+#include "../check.hpp"
+
+using http::RouteParams;
+using http::Router;
+using std::string_view;
+using std::size_t;
+using std::string;
+using test::check;
+
+constexpr size_t get = 0;
+constexpr size_t post = 1;
+
+void add(Router &router, size_t method, string_view pattern, size_t id) {
+    check(router.add(method, pattern, id).has_value(), string(pattern));
+}
+
+void staticRoutes() {
+    Router router;
+    add(router, get, "/", 1);
+    add(router, get, "/users", 2);
+    add(router, get, "/users/all", 3);
+    add(router, get, "/user", 4);
+    add(router, get, "/about", 5);
+    add(router, post, "/users", 6);
+
+    RouteParams params;
+    check(router.match(get, "/", params) == 1, "root");
+    check(router.match(get, "/users", params) == 2, "static route");
+    check(router.match(get, "/users/all", params) == 3, "longer static route");
+    check(router.match(get, "/user", params) == 4, "shared prefix split");
+    check(router.match(get, "/about", params) == 5, "sibling route");
+    check(router.match(post, "/users", params) == 6, "route per method");
+    check(params.count == 0, "static routes have no parameters");
+
+    check(router.match(get, "/users/", params) == Router::npos, "trailing slash");
+    check(router.match(get, "/use", params) == Router::npos, "prefix of a route");
+    check(router.match(get, "/usersx", params) == Router::npos, "route plus suffix");
+    check(router.match(post, "/about", params) == Router::npos, "method without a route");
+    check(router.match(Router::max_methods, "/", params) == Router::npos, "method out of range");
+}
+
+void parameters() {
+    Router router;
+    add(router, get, "/users/:id", 1);
+    add(router, get, "/users/:id/posts/:post", 2);
+    add(router, get, "/users/me", 3);
+
+    RouteParams params;
+    check(router.match(get, "/users/42", params) == 1, "parameter");
+    check(params.count == 1 && params.get("id") == "42", "parameter value");
+
+    check(router.match(get, "/users/42/posts/7", params) == 2, "two parameters");
+    check(params.get("id") == "42" && params.get("post") == "7", "two parameter values");
+    check(params.get("missing").empty(), "missing parameter");
+
+    check(router.match(get, "/users/me", params) == 3, "static beats parameter");
+    check(params.count == 0, "no parameters on the static route");
+
+    check(router.match(get, "/users/mee", params) == 1, "falls back to the parameter");
+    check(params.get("id") == "mee", "fallback parameter value");
+
+    check(router.match(get, "/users/", params) == Router::npos, "empty parameter");
+    check(router.match(get, "/users/42/posts", params) == Router::npos, "missing last parameter");
+    check(params.count == 0, "failed match leaves no parameters");
+}
+
+void wildcards() {
+    Router router;
+    add(router, get, "/files/*path", 1);
+    add(router, get, "/files/index", 2);
+
+    RouteParams params;
+    check(router.match(get, "/files/a/b/c.txt", params) == 1, "wildcard");
+    check(params.get("path") == "a/b/c.txt", "wildcard takes the rest");
+    check(router.match(get, "/files/index", params) == 2, "static beats wildcard");
+    check(router.match(get, "/files/indexes", params) == 1, "falls back to the wildcard");
+    check(params.get("path") == "indexes", "fallback wildcard value");
+    check(router.match(post, "/files/a", params) == Router::npos, "wildcard per method");
+}
+
+void rejected() {
+    Router router;
+    add(router, get, "/users/:id", 1);
+    add(router, get, "/files/*path", 2);
+
+    check(!router.add(get, "/users/:id", 3), "duplicate route");
+    check(!router.add(get, "/users/:name", 3), "conflicting parameter name");
+    check(!router.add(get, "/files/*rest", 3), "conflicting wildcard name");
+    check(!router.add(get, "/files/*path/more", 3), "wildcard before the end");
+    check(!router.add(get, "/users/x:id", 3), "parameter inside a segment");
+    check(!router.add(get, "/users/:", 3), "unnamed parameter");
+    check(!router.add(get, "users", 3), "route without a leading slash");
+    check(!router.add(Router::max_methods, "/", 3), "method out of range");
+    check(!router.add(get, "/:a/:b/:c/:d/:e/:f/:g/:h/:i", 3), "too many parameters");
+    check(router.add(post, "/users/:id", 3).has_value(), "same route for another method");
+}
+
+int main() {
+    staticRoutes();
+    parameters();
+    wildcards();
+    rejected();
+
+    return test::finish("router");
+}
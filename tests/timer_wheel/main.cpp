@@ -0,0 +1,155 @@
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <format>
+#include <vector>
+
+#include "timer_wheel.hpp"
+#include "../check.hpp"
+
+using http::TimerWheel;
+using http::Timer;
+using std::uint64_t;
+using std::size_t;
+using std::vector;
+using test::check;
+
+// Drains every timer due by now and returns their fds.
+vector<int> expire(TimerWheel &wheel, uint64_t now) {
+    vector<int> fired;
+    while (Timer *timer = wheel.expire(now)) {
+        check(!timer->armed(), "expired timer is disarmed");
+        fired.push_back(timer->fd());
+    }
+    return fired;
+}
+
+void single() {
+    TimerWheel wheel;
+    Timer timer;
+    check(!timer.armed(), "new timer is disarmed");
+    check(wheel.next() == std::numeric_limits<uint64_t>::max(), "empty wheel has nothing next");
+
+    wheel.arm(timer, 5, 7);
+    check(timer.armed(), "armed timer");
+    check(timer.fd() == 7, "timer fd");
+    check(wheel.next() == 5, "next is the armed timer");
+    check(expire(wheel, 4).empty(), "not due before its tick");
+    check(expire(wheel, 5) == vector<int> { 7 }, "due on its tick");
+    check(expire(wheel, 100).empty(), "fires once");
+}
+
+void everyLevel() {
+    // one timer per level boundary and either side of it
+    uint64_t delays[] = {
+        1, 2, 62, 63, 64, 65, 100, 4095, 4096, 4097, 5000,
+        262143, 262144, 262145, 300000, 1000000,
+    };
+    constexpr size_t count = std::size(delays);
+
+    TimerWheel wheel;
+    Timer timers[count];
+    for (size_t i = 0; i < count; ++i) {
+        wheel.arm(timers[i], delays[i], static_cast<int>(i));
+    }
+
+    // stepping a tick at a time, each timer fires exactly on its own tick
+    vector<uint64_t> fired_at(count, 0);
+    for (uint64_t now = 1; now <= 1000000; ++now) {
+        for (int fd : expire(wheel, now)) {
+            fired_at[fd] = now;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        check(fired_at[i] == delays[i], std::format("timer at {} fired at {}", delays[i], fired_at[i]));
+    }
+}
+
+void jump() {
+    TimerWheel wheel;
+    Timer timers[4];
+    wheel.arm(timers[0], 10, 0);
+    wheel.arm(timers[1], 1000, 1);
+    wheel.arm(timers[2], 100000, 2);
+    wheel.arm(timers[3], 200000, 3);
+
+    // a loop that slept a long time sees everything due at once, in order
+    check(expire(wheel, 150000) == vector<int> { 0, 1, 2 }, "everything due after a jump");
+    check(timers[3].armed(), "later timer still armed");
+    check(wheel.next() <= 200000, "next is no later than the timer");
+    check(expire(wheel, 199999).empty(), "later timer not due yet");
+    check(expire(wheel, 200000) == vector<int> { 3 }, "later timer on its tick");
+}
+
+void cancelAndRearm() {
+    TimerWheel wheel;
+    Timer first;
+    Timer second;
+    Timer third;
+    wheel.arm(first, 10, 1);
+    wheel.arm(second, 10, 2);
+    wheel.arm(third, 5000, 3);
+
+    first.cancel();
+    check(!first.armed(), "cancelled timer is disarmed");
+    first.cancel();
+
+    // arming again moves the timer rather than adding it twice
+    wheel.arm(third, 20, 3);
+    wheel.arm(third, 30, 3);
+
+    {
+        Timer gone;
+        wheel.arm(gone, 10, 4);
+    }
+
+    check(expire(wheel, 10) == vector<int> { 2 }, "cancelled and destroyed timers do not fire");
+    check(expire(wheel, 29).empty(), "re-armed timer left its old slot");
+    check(expire(wheel, 30) == vector<int> { 3 }, "re-armed timer fires at its new tick");
+    check(expire(wheel, 10000).empty(), "nothing left");
+}
+
+void lateAndFar() {
+    TimerWheel wheel;
+    Timer late;
+    Timer far;
+    check(expire(wheel, 100).empty(), "empty wheel advances");
+
+    // already overdue goes into the next tick, never the current one
+    wheel.arm(late, 50, 1);
+    check(expire(wheel, 100).empty(), "overdue timer waits for the next tick");
+    check(expire(wheel, 101) == vector<int> { 1 }, "overdue timer fires next tick");
+
+    // past the top level is clamped to the longest delay the wheel holds
+    uint64_t span = uint64_t(1) << 24;
+    wheel.arm(far, 101 + span * 4, 2);
+    check(expire(wheel, 101 + span - 2).empty(), "clamped timer not due early");
+    check(expire(wheel, 101 + span - 1) == vector<int> { 2 }, "clamped timer fires at the top of the wheel");
+}
+
+void copies() {
+    TimerWheel wheel;
+    Timer timer;
+    wheel.arm(timer, 10, 1);
+
+    Timer copy(timer);
+    check(!copy.armed(), "copy starts disarmed");
+
+    Timer assigned;
+    wheel.arm(assigned, 10, 2);
+    assigned = copy;
+    check(!assigned.armed(), "assignment disarms");
+    check(expire(wheel, 10) == vector<int> { 1 }, "only the original fires");
+}
+
+int main() {
+    single();
+    everyLevel();
+    jump();
+    cancelAndRearm();
+    lateAndFar();
+    copies();
+
+    return test::finish("timer_wheel");
+}
@@ -0,0 +1,251 @@
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "websocket.hpp"
+#include "output.hpp"
+#include "../check.hpp"
+
+using http::ParseStatus;
+using http::CloseCode;
+using http::Opcode;
+using http::Frame;
+using std::string_view;
+using std::uint64_t;
+using std::size_t;
+using std::string;
+using std::vector;
+using test::check;
+
+constexpr unsigned char key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+// A frame as a client sends it: masked, with the length in the shortest
+// form unless wide asks for the 64-bit one.
+string clientFrame(unsigned char first, string_view payload, bool wide = false) {
+    string frame(1, static_cast<char>(first));
+    if (payload.size() < 126 && !wide) {
+        frame += static_cast<char>(0x80 | payload.size());
+    } else if (payload.size() <= 0xFFFF && !wide) {
+        frame += static_cast<char>(0x80 | 126);
+        frame += static_cast<char>(payload.size() >> 8);
+        frame += static_cast<char>(payload.size());
+    } else {
+        frame += static_cast<char>(0x80 | 127);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            frame += static_cast<char>(uint64_t(payload.size()) >> shift);
+        }
+    }
+
+    frame.append(reinterpret_cast<const char *>(key), 4);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        frame += static_cast<char>(payload[i] ^ key[i & 3]);
+    }
+    return frame;
+}
+
+ParseStatus parse(string frame, Frame &parsed, size_t max = 1 << 20) {
+    static string buffer;
+    buffer = std::move(frame);
+    return http::parseFrame(buffer.data(), buffer.size(), max, parsed);
+}
+
+void handshake() {
+    // the example from RFC 6455 section 1.3
+    check(http::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", "RFC 6455 accept key");
+}
+
+void frames() {
+    Frame frame;
+
+    // the masked "Hello" from RFC 6455 section 5.7
+    string hello = "\x81\x85\x37\xfa\x21\x3d\x7f\x9f\x4d\x51\x58";
+    check(parse(hello, frame) == ParseStatus::Complete, "RFC 6455 masked frame");
+    check(frame.fin && frame.opcode == Opcode::Text, "RFC 6455 frame header");
+    check(frame.payload == "Hello" && frame.length == hello.size(), "RFC 6455 frame payload");
+
+    for (size_t size = 0; size < hello.size(); ++size) {
+        if (parse(hello.substr(0, size), frame) != ParseStatus::Incomplete) {
+            check(false, "partial frame is incomplete");
+        }
+    }
+
+    string medium(300, 'm');
+    check(parse(clientFrame(0x82, medium), frame) == ParseStatus::Complete, "16-bit length");
+    check(frame.payload == medium && frame.opcode == Opcode::Binary, "16-bit length payload");
+
+    string large(70000, 'l');
+    check(parse(clientFrame(0x82, large), frame) == ParseStatus::Complete, "64-bit length");
+    check(frame.payload == large && frame.length == large.size() + 14, "64-bit length payload");
+    check(parse(clientFrame(0x82, "x", true), frame) == ParseStatus::Complete, "64-bit length for a short payload");
+    check(parse(clientFrame(0x82, large).substr(0, 9), frame) == ParseStatus::Incomplete, "partial 64-bit length");
+
+    check(parse(clientFrame(0x01, "frag"), frame) == ParseStatus::Complete, "first fragment");
+    check(!frame.fin && frame.opcode == Opcode::Text, "fragment without fin");
+    check(parse(clientFrame(0x80, "ment"), frame) == ParseStatus::Complete, "last fragment");
+    check(frame.fin && frame.opcode == Opcode::Continuation, "continuation with fin");
+}
+
+void badFrames() {
+    Frame frame;
+
+    string unmasked = "\x81\x05Hello";
+    check(parse(unmasked, frame) == ParseStatus::Error, "unmasked client frame");
+
+    for (unsigned char rsv : { 0x40, 0x20, 0x10 }) {
+        check(parse(clientFrame(0x81 | rsv, "x"), frame) == ParseStatus::Error, "reserved bit");
+    }
+
+    for (unsigned char opcode : { 0x3, 0x7, 0xB, 0xF }) {
+        check(parse(clientFrame(0x80 | opcode, "x"), frame) == ParseStatus::Error, "reserved opcode");
+    }
+
+    check(parse(clientFrame(0x09, "ping"), frame) == ParseStatus::Error, "fragmented control frame");
+    check(parse(clientFrame(0x89, string(125, 'p')), frame) == ParseStatus::Complete, "125 byte control frame");
+    check(parse(clientFrame(0x89, string(126, 'p')), frame) == ParseStatus::Error, "126 byte control frame");
+
+    string huge = clientFrame(0x82, "");
+    huge[1] = static_cast<char>(0x80 | 127);
+    huge.insert(2, "\x80\0\0\0\0\0\0\0", 8);
+    check(parse(huge, frame) == ParseStatus::Error, "length with the top bit set");
+
+    check(parse(clientFrame(0x82, string(101, 'x')), frame, 100) == ParseStatus::Error, "payload over the limit");
+    check(frame.error == CloseCode::TooBig, "over the limit closes with 1009");
+}
+
+void masking() {
+    // every length and alignment around the eight byte words
+    const unsigned char mask[4] = { 0x01, 0x80, 0xFF, 0x5A };
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t size = 0; size <= 40; ++size) {
+            string original;
+            for (size_t i = 0; i < offset + size; ++i) {
+                original += static_cast<char>(i * 7 + 3);
+            }
+
+            string data = original;
+            http::unmask(data.data() + offset, size, mask);
+            bool ok = data.substr(0, offset) == original.substr(0, offset);
+            for (size_t i = 0; i < size; ++i) {
+                ok = ok && data[offset + i] == static_cast<char>(original[offset + i] ^ mask[i & 3]);
+            }
+            check(ok, "unmask matches the byte-wise XOR");
+
+            http::unmask(data.data() + offset, size, mask);
+            check(data == original, "unmask twice restores the data");
+        }
+    }
+}
+
+void utf8() {
+    check(http::validUtf8(""), "empty");
+    check(http::validUtf8("plain ascii that is longer than one word"), "ascii");
+    check(http::validUtf8("\xCE\xBA\xE1\xBD\xB9\xCF\x83\xCE\xBC\xCE\xB5"), "two and three byte sequences");
+    check(http::validUtf8("\xF0\x9F\x98\x80 and \xF4\x8F\xBF\xBF"), "four byte sequences");
+    check(http::validUtf8("eight by\xC3\xA9"), "sequence after a full word");
+
+    string_view invalid[] = {
+        "\x80",
+        "\xBF",
+        "abc\xC3",
+        "\xE2\x82",
+        "\xC3\x28",
+        "\xC0\xAF",
+        "\xC1\xBF",
+        "\xE0\x80\xAF",
+        "\xF0\x80\x80\xAF",
+        "\xED\xA0\x80",
+        "\xED\xBF\xBF",
+        "\xF4\x90\x80\x80",
+        "\xF8\x88\x80\x80\x80",
+        "\xFE",
+        "\xFF",
+        "a long ascii run\xE2\x82",
+    };
+    for (string_view text : invalid) {
+        check(!http::validUtf8(text), "invalid utf-8");
+    }
+}
+
+struct Session {
+    http::WebSocketHandler handler;
+    http::OutputQueue out;
+    http::WebSocket socket;
+    vector<string> messages;
+    CloseCode closed = CloseCode::Abnormal;
+
+    Session() : socket(handler, out, 1 << 20, 1024) {
+        handler.on_message = [this](http::WebSocket &, string_view message, bool) {
+            messages.emplace_back(message);
+        };
+        handler.on_close = [this](http::WebSocket &, CloseCode code) {
+            closed = code;
+        };
+    }
+
+    size_t receive(string data) {
+        return socket.receive(data.data(), data.size());
+    }
+};
+
+void session() {
+    {
+        Session session;
+        string input = clientFrame(0x01, "hel") + clientFrame(0x89, "ping") + clientFrame(0x80, "lo");
+        check(session.receive(input) == input.size(), "whole input consumed");
+        check(session.messages == vector<string> { "hello" }, "fragments joined around a ping");
+        check(session.out.pending() == 6, "ping answered with a pong");
+        check(!session.socket.closing(), "still open");
+
+        string close = clientFrame(0x88, string("\x03\xE8", 2) + "bye");
+        session.receive(close);
+        session.socket.finish();
+        check(session.socket.closing(), "close frame closes");
+        check(session.closed == CloseCode::Normal, "close code reported");
+    }
+
+    {
+        Session session;
+        string partial = clientFrame(0x81, "hello");
+        check(session.receive(partial.substr(0, 4)) == 0, "partial frame waits");
+        check(session.receive(partial) == partial.size(), "complete frame consumed");
+    }
+
+    {
+        Session session;
+        session.receive(clientFrame(0x81, "\xC0\xAF"));
+        session.socket.finish();
+        check(session.messages.empty() && session.socket.closing(), "invalid text closes");
+    }
+
+    {
+        Session session;
+        session.receive(clientFrame(0x80, "stray"));
+        check(session.socket.closing(), "continuation without a message closes");
+    }
+
+    {
+        Session session;
+        session.receive(clientFrame(0x01, string(600, 'a')) + clientFrame(0x80, string(600, 'b')));
+        check(session.messages.empty() && session.socket.closing(), "message over the limit closes");
+    }
+
+    {
+        Session session;
+        session.receive(clientFrame(0x88, string("\x03\xED", 2)));
+        session.socket.finish();
+        check(session.closed == CloseCode::ProtocolError, "reserved close code");
+    }
+}
+
+int main() {
+    handshake();
+    frames();
+    badFrames();
+    masking();
+    utf8();
+    session();
+
+    return test::finish("websocket");
+}
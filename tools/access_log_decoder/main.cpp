@@ -0,0 +1,182 @@
+#include <string_view>
+#include <filesystem>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <format>
+#include <string>
+#include <vector>
+#include <print>
+#include <ctime>
+
+#include "access_log.hpp"
+
+namespace fs = std::filesystem;
+
+using std::string_view;
+using std::uint64_t;
+using std::println;
+using std::string;
+using std::vector;
+using std::print;
+
+enum class Format {
+    Text,
+    Csv,
+    Json,
+};
+
+string formatTimestamp(uint64_t timestamp_ns) {
+    std::time_t seconds = timestamp_ns / 1000000000;
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    return std::format("{}.{:09}Z", buffer, timestamp_ns % 1000000000);
+}
+
+string formatRoute(std::uint32_t route_id) {
+    return route_id == http::no_route ? "-" : std::to_string(route_id);
+}
+
+void printRecord(const http::AccessRecord &record, Format format, bool &first) {
+    string_view method = http::accessMethodName(record.method);
+
+    if (format == Format::Text) {
+        println(
+            "{} fd={} {} route={} status={} bytes={} latency={}us",
+            formatTimestamp(record.timestamp_ns),
+            record.fd,
+            method,
+            formatRoute(record.route_id),
+            record.status,
+            record.bytes,
+            record.latency_ns / 1000.0
+        );
+    } else if (format == Format::Csv) {
+        println(
+            "{},{},{},{},{},{},{}",
+            record.timestamp_ns,
+            record.fd,
+            method,
+            record.route_id == http::no_route ? "" : std::to_string(record.route_id),
+            record.status,
+            record.bytes,
+            record.latency_ns
+        );
+    } else {
+        print(
+            "{}  {{\"timestamp_ns\": {}, \"fd\": {}, \"method\": \"{}\", "
+            "\"route_id\": {}, \"status\": {}, \"bytes\": {}, \"latency_ns\": {}}}",
+            first ? "" : ",\n",
+            record.timestamp_ns,
+            record.fd,
+            method,
+            record.route_id == http::no_route ? "null" : std::to_string(record.route_id),
+            record.status,
+            record.bytes,
+            record.latency_ns
+        );
+    }
+
+    first = false;
+}
+
+bool decodeFile(const fs::path &path, Format format, bool &first) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        println(stderr, "Could not open {}", path.string());
+        return false;
+    }
+
+    http::AccessLogHeader header;
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))
+        || string_view(header.magic, sizeof(header.magic)) != http::access_log_magic
+    ) {
+        println(stderr, "{} is not an access log", path.string());
+        return false;
+    }
+
+    if (header.version != 1 || header.record_size != sizeof(http::AccessRecord)) {
+        println(
+            stderr,
+            "{} has unsupported version {} (record size {})",
+            path.string(),
+            header.version,
+            header.record_size
+        );
+        return false;
+    }
+
+    http::AccessRecord record;
+    for (uint64_t i = 0; i < header.capacity; i++) {
+        if (!in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+            break;
+        }
+
+        // unwritten slots, either past the end of a live file or left by a
+        // writer that never finished its store
+        if (record.timestamp_ns == 0) {
+            continue;
+        }
+
+        printRecord(record, format, first);
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Format format = Format::Text;
+    vector<fs::path> files;
+
+    for (int i = 1; i < argc; i++) {
+        string_view arg = argv[i];
+        if (arg == "--text") {
+            format = Format::Text;
+        } else if (arg == "--csv") {
+            format = Format::Csv;
+        } else if (arg == "--json") {
+            format = Format::Json;
+        } else if (fs::is_directory(arg)) {
+            vector<fs::path> entries;
+            for (const auto &entry : fs::directory_iterator(arg)) {
+                string name = entry.path().filename().string();
+                if (name.starts_with("access-") && name.ends_with(".bin")) {
+                    entries.push_back(entry.path());
+                }
+            }
+
+            std::sort(entries.begin(), entries.end());
+            files.insert(files.end(), entries.begin(), entries.end());
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        println(stderr, "usage: {} [--text | --csv | --json] <file or directory>...", argv[0]);
+        return 1;
+    }
+
+    if (format == Format::Csv) {
+        println("timestamp_ns,fd,method,route_id,status,bytes,latency_ns");
+    } else if (format == Format::Json) {
+        println("[");
+    }
+
+    bool first = true;
+    bool ok = true;
+    for (const fs::path &file : files) {
+        ok = decodeFile(file, format, first) && ok;
+    }
+
+    if (format == Format::Json) {
+        println("{}]", first ? "" : "\n");
+    }
+
+    return ok ? 0 : 1;
+}